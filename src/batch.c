@@ -0,0 +1,274 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Batch rendering. Every file is one task for the thread pool and
+	gets its own reverb state, so files are rendered completely
+	independently of each other.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Header files */
+#include "batch.h"
+#include "pool.h"
+#include "render.h"
+
+/* One file to render */
+typedef struct
+{
+	char *in_path;
+	char *out_path;
+	long long size;		// Size of the input, used to start the longest files first
+	dev_t device;			// Device and inode of the input, to tell whether an output is an input
+	ino_t inode;
+	RenderOptions options;
+	int status;				// Result of render_file, -1 if the job was rejected before it ran
+} BatchJob;
+
+/* Growable list of jobs */
+typedef struct
+{
+	BatchJob *jobs;
+	size_t count;
+	size_t capacity;
+} BatchList;
+
+/*
+		Joins a directory and a file name with a slash.
+*/
+static char *join_path(const char *dir, const char *name)
+{
+	size_t length = strlen(dir) + strlen(name) + 2;
+	char *path = malloc(length);
+
+	snprintf(path, length, "%s/%s", dir, name);
+	return path;
+}
+
+/*
+		Returns 1 if name ends in .wav, ignoring case.
+*/
+static int is_wav(const char *name)
+{
+	size_t length = strlen(name);
+
+	return length > 4 && strcasecmp(name + length - 4, ".wav") == 0;
+}
+
+/*
+		Adds the file at in_path to the list, writing its output into out_dir.
+*/
+static void add_job(BatchList *list, char *in_path, const char *out_dir, const struct stat *info, const RenderOptions *options)
+{
+	if (list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? 2 * list->capacity : 64;
+		list->jobs = realloc(list->jobs, list->capacity * sizeof(BatchJob));
+	}
+
+	const char *name = strrchr(in_path, '/');
+	name = name ? name + 1 : in_path;
+
+	BatchJob *job = &list->jobs[list->count++];
+	job->in_path = in_path;
+	job->out_path = join_path(out_dir, name);
+	job->size = info->st_size;
+	job->device = info->st_dev;
+	job->inode = info->st_ino;
+	job->options = *options;
+	job->status = 0;
+
+	// The pool already keeps every core busy, so each file stays on one thread
+	job->options.threads = 1;
+	job->options.chunks = 1;
+	job->options.pipelined = 0;
+}
+
+/*
+		Adds every .wav file inside the directory at path.
+*/
+static void add_directory(BatchList *list, const char *path, const char *out_dir, const RenderOptions *options)
+{
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+
+	if (dir == NULL)
+	{
+		perror(path);
+		return;
+	}
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		struct stat info;
+		char *file = join_path(path, entry->d_name);
+
+		if (is_wav(entry->d_name) && stat(file, &info) == 0 && S_ISREG(info.st_mode))
+		{
+			add_job(list, file, out_dir, &info, options);
+		}
+		else
+		{
+			free(file);
+		}
+	}
+
+	closedir(dir);
+}
+
+/* Sorts jobs from the largest input to the smallest */
+static int compare_jobs(const void *a, const void *b)
+{
+	long long size_a = ((const BatchJob *) a)->size;
+	long long size_b = ((const BatchJob *) b)->size;
+
+	return (size_a < size_b) - (size_a > size_b);
+}
+
+/* Sorts jobs by output path */
+static int compare_outputs(const void *a, const void *b)
+{
+	return strcmp(((const BatchJob *) a)->out_path, ((const BatchJob *) b)->out_path);
+}
+
+/* Sorts jobs by the device and inode of their input */
+static int compare_inputs(const void *a, const void *b)
+{
+	const BatchJob *job_a = a, *job_b = b;
+
+	if (job_a->device != job_b->device)
+	{
+		return job_a->device < job_b->device ? -1 : 1;
+	}
+	return (job_a->inode > job_b->inode) - (job_a->inode < job_b->inode);
+}
+
+/*
+		Rejects every job whose output is also the output of another job,
+		or is the input of any job, since the render would truncate it
+		while it is being read. The jobs end up sorted by input.
+*/
+static void reject_collisions(BatchList *list)
+{
+	qsort(list->jobs, list->count, sizeof(BatchJob), compare_outputs);
+	for (size_t i = 0; i < list->count; i++)
+	{
+		int before = i > 0 && strcmp(list->jobs[i].out_path, list->jobs[i - 1].out_path) == 0;
+		int after = i + 1 < list->count && strcmp(list->jobs[i].out_path, list->jobs[i + 1].out_path) == 0;
+
+		if (before || after)
+		{
+			fprintf(stderr, "%s: more than one input is written to %s, skipped\n", list->jobs[i].in_path, list->jobs[i].out_path);
+			list->jobs[i].status = -1;
+		}
+	}
+
+	qsort(list->jobs, list->count, sizeof(BatchJob), compare_inputs);
+	for (size_t i = 0; i < list->count; i++)
+	{
+		struct stat info;
+
+		// An output that does not exist yet can not be an input
+		if (list->jobs[i].status == 0 && stat(list->jobs[i].out_path, &info) == 0)
+		{
+			BatchJob output = { .device = info.st_dev, .inode = info.st_ino };
+
+			if (bsearch(&output, list->jobs, list->count, sizeof(BatchJob), compare_inputs) != NULL)
+			{
+				fprintf(stderr, "%s: output %s is an input, skipped\n", list->jobs[i].in_path, list->jobs[i].out_path);
+				list->jobs[i].status = -1;
+			}
+		}
+	}
+}
+
+/* Pool task which renders one file */
+static void run_job(void *arg)
+{
+	BatchJob *job = arg;
+
+	job->status = render_file(job->in_path, job->out_path, &job->options);
+}
+
+/*
+		Renders many .wav files at once on a pool of worker threads. Each file
+		is written to out_dir under its own file name. Files whose output name
+		is shared with another file, or whose output is one of the inputs,
+		are skipped and count as failed.
+
+		inputs: Paths of .wav files or of directories whose .wav files should be
+		        rendered (directories are not searched recursively).
+		num_inputs: Amount of entries in inputs.
+		out_dir: Directory the rendered files are written to. Created if missing.
+		threads: Amount of worker threads.
+		options: Settings every file is rendered with. Each file is rendered on
+		         a single thread, whatever options->threads says.
+
+		returns: Amount of files that failed to render, or -1 if out_dir
+		         could not be created.
+*/
+int render_batch (char **inputs, int num_inputs, const char *out_dir, int threads, const RenderOptions *options)
+{
+	BatchList list = { NULL, 0, 0 };
+	int failed = 0;
+
+	if (mkdir(out_dir, 0777) != 0 && errno != EEXIST)
+	{
+		perror(out_dir);
+		return -1;
+	}
+
+	for (int i = 0; i < num_inputs; i++)
+	{
+		struct stat info;
+
+		if (stat(inputs[i], &info) != 0)
+		{
+			perror(inputs[i]);
+			failed++;
+		}
+		else if (S_ISDIR(info.st_mode))
+		{
+			add_directory(&list, inputs[i], out_dir, options);
+		}
+		else
+		{
+			add_job(&list, strdup(inputs[i]), out_dir, &info, options);
+		}
+	}
+
+	reject_collisions(&list);
+
+	// Starting the longest files first keeps one late long file from finishing alone
+	qsort(list.jobs, list.count, sizeof(BatchJob), compare_jobs);
+
+	ThreadPool *pool = pool_create(threads);
+	for (size_t i = 0; i < list.count; i++)
+	{
+		if (list.jobs[i].status == 0)
+		{
+			pool_submit(pool, run_job, &list.jobs[i]);
+		}
+	}
+	pool_free(pool);
+
+	for (size_t i = 0; i < list.count; i++)
+	{
+		if (list.jobs[i].status != 0)
+		{
+			failed++;
+		}
+		free(list.jobs[i].in_path);
+		free(list.jobs[i].out_path);
+	}
+	free(list.jobs);
+
+	return failed;
+}
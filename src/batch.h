@@ -0,0 +1,24 @@
+#ifndef BATCH
+#define BATCH
+/* Header files */
+#include "render.h"
+
+/*
+		Renders many .wav files at once on a pool of worker threads. Each file
+		is written to out_dir under its own file name. Files whose output name
+		is shared with another file, or whose output is one of the inputs,
+		are skipped and count as failed.
+
+		inputs: Paths of .wav files or of directories whose .wav files should be
+		        rendered (directories are not searched recursively).
+		num_inputs: Amount of entries in inputs.
+		out_dir: Directory the rendered files are written to. Created if missing.
+		threads: Amount of worker threads.
+		options: Settings every file is rendered with. Each file is rendered on
+		         a single thread, whatever options->threads and options->chunks say.
+
+		returns: Amount of files that failed to render, or -1 if out_dir
+		         could not be created.
+*/
+int render_batch (char **inputs, int num_inputs, const char *out_dir, int threads, const RenderOptions *options);
+#endif
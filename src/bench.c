@@ -0,0 +1,619 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Benchmark suite. Generates synthetic test signals at a range of
+	sample rates, times every stage of the reference implementation,
+	the block engines and the .wav I/O on them, and prints the results
+	as JSON so runs can be compared across releases.
+
+	usage: cverb-bench [-l seconds] [-r rate,...] [-s signal,...] [-I isa] [-o results.json]
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Header files */
+#include "reference.h"
+#include "wavio.h"
+#include "engine.h"
+#include "streams.h"
+#include "live.h"
+#include "reverb.h"
+#include "render.h"
+#include "kernels.h"
+#include "convert.h"
+#include "testsignal.h"
+#include "constants.h"
+
+#define MAX_RATES 16
+#define PARSE_REPEATS 1000 // parse_wav is too fast to time once
+
+#define SIGNAL_AMPLITUDE 16384 // Half scale
+
+static const unsigned int default_rates[] = { 8000, 22050, 44100, 48000, 96000, 192000 };
+#define NUM_DEFAULT_RATES 6
+
+/* Timing of one stage */
+typedef struct
+{
+	const char *name;
+	double seconds;
+	size_t count;						// Samples (or calls) the time was spent on
+	int per_call;						// 1 if count is calls rather than samples
+} StageTime;
+
+#define MAX_STAGES 24
+#define BENCH_STREAMS 16 // Streams of the many stream stages
+#define BENCH_STREAM_FRAMES 64 // Frames per block of the many stream stages, a few ms of voice
+#define BENCH_LIVE_FRAMES 256 // Frames per block of the live retuning stage
+
+/*
+		Returns a monotonic timestamp in seconds.
+*/
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static StageTime *add_stage(StageTime *stages, int *count, const char *name)
+{
+	StageTime *stage = &stages[(*count)++];
+	stage->name = name;
+	stage->seconds = 0;
+	stage->count = 0;
+	stage->per_call = 0;
+
+	return stage;
+}
+
+/*
+		Times the comb filter and each all pass filter of the reference
+		implementation. Each stage runs over a whole block before the next
+		stage starts, so the clock is read once per stage and block. This
+		gives the same output as process_data(), because every stage only
+		depends on the history of its own input and output.
+*/
+static void time_reference_stages(TestSignal *gen, WaveHeader *header, StageTime *stages, int *num_stages)
+{
+	static const char *all_pass_names[NUM_ALL_PASS_FILTERS] = { "all_pass_1", "all_pass_2", "all_pass_3", "all_pass_4" };
+	int16_t *block = malloc(BLOCK_FRAMES * sizeof(int16_t));
+	float *stage_in = malloc(BLOCK_FRAMES * sizeof(float));
+	float *stage_out = malloc(BLOCK_FRAMES * sizeof(float));
+	ProcessingBuffer *lines_in[NUM_ALL_PASS_FILTERS + 1];
+	ProcessingBuffer *lines_out[NUM_ALL_PASS_FILTERS + 1];
+	StageTime *timed[NUM_ALL_PASS_FILTERS + 1];
+	size_t count;
+
+	timed[0] = add_stage(stages, num_stages, "comb");
+	for (int s = 0; s <= NUM_ALL_PASS_FILTERS; s++)
+	{
+		if (s > 0)
+		{
+			timed[s] = add_stage(stages, num_stages, all_pass_names[s - 1]);
+		}
+		lines_in[s] = construct_processing_buffer(header);
+		lines_out[s] = construct_processing_buffer(header);
+	}
+
+	while ((count = test_signal_next(gen, block, BLOCK_FRAMES)) > 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			stage_in[i] = (float) block[i];
+		}
+
+		for (int s = 0; s <= NUM_ALL_PASS_FILTERS; s++)
+		{
+			double start = now();
+
+			for (size_t i = 0; i < count; i++)
+			{
+				pbuff_put(lines_in[s], stage_in[i]);
+				if (s == 0)
+				{
+					apply_comb_filter(&stage_out[i], lines_in[s], lines_out[s], header->sample_rate);
+				}
+				else
+				{
+					apply_all_pass_filter(&stage_out[i], lines_in[s], lines_out[s], header->sample_rate);
+				}
+				pbuff_put(lines_out[s], stage_out[i]);
+				pbuff_update_head(lines_in[s]);
+				pbuff_update_head(lines_out[s]);
+			}
+
+			timed[s]->seconds += now() - start;
+			timed[s]->count += count;
+
+			// The all pass filters are in series
+			float *swap = stage_in;
+			stage_in = stage_out;
+			stage_out = swap;
+		}
+	}
+
+	for (int s = 0; s <= NUM_ALL_PASS_FILTERS; s++)
+	{
+		pbuff_free(lines_in[s]);
+		pbuff_free(lines_out[s]);
+	}
+	free(block);
+	free(stage_in);
+	free(stage_out);
+}
+
+/*
+		Times a block engine on its own, without any I/O.
+*/
+static void time_engine(TestSignal *gen, const ReverbSpec *spec, StageTime *stage)
+{
+	int16_t *block = malloc(BLOCK_FRAMES * sizeof(int16_t));
+	float *block_in = malloc(BLOCK_FRAMES * sizeof(float));
+	float *block_out = malloc(BLOCK_FRAMES * sizeof(float));
+	Reverb *reverb = reverb_create(spec, gen->sample_rate, 0);
+	size_t count;
+
+	while ((count = test_signal_next(gen, block, BLOCK_FRAMES)) > 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			block_in[i] = (float) block[i];
+		}
+
+		double start = now();
+		reverb_process(reverb, block_in, block_out, count);
+		stage->seconds += now() - start;
+		stage->count += count;
+	}
+
+	reverb_free(reverb);
+	free(block);
+	free(block_in);
+	free(block_out);
+}
+
+/*
+		Times BENCH_STREAMS mono streams in blocks of BENCH_STREAM_FRAMES, as a
+		voice chat server would run them: once with one block engine per
+		stream and once interleaved in one CVerbStreams. Both are counted in
+		samples of every stream.
+*/
+static void time_streams(TestSignal *gen, const CVerbConfig *config, StageTime *engines, StageTime *interleaved)
+{
+	int16_t *block = malloc(BENCH_STREAM_FRAMES * sizeof(int16_t));
+	float *planar_in[BENCH_STREAMS], *planar_out[BENCH_STREAMS];
+	CVerbState *states[BENCH_STREAMS];
+	CVerbStreams *streams = cverb_streams_create(config, gen->sample_rate, BENCH_STREAMS);
+	size_t count;
+
+	for (int s = 0; s < BENCH_STREAMS; s++)
+	{
+		planar_in[s] = malloc(BENCH_STREAM_FRAMES * sizeof(float));
+		planar_out[s] = malloc(BENCH_STREAM_FRAMES * sizeof(float));
+		states[s] = cverb_state_create(config, gen->sample_rate);
+	}
+
+	while ((count = test_signal_next(gen, block, BENCH_STREAM_FRAMES)) > 0)
+	{
+		// Every stream hears the signal at its own level
+		for (int s = 0; s < BENCH_STREAMS; s++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				planar_in[s][i] = (float) block[i] / (s + 1);
+			}
+		}
+
+		double start = now();
+		for (int s = 0; s < BENCH_STREAMS; s++)
+		{
+			cverb_process_block(states[s], planar_in[s], planar_out[s], count);
+		}
+		engines->seconds += now() - start;
+		engines->count += count * BENCH_STREAMS;
+
+		start = now();
+		cverb_streams_process(streams, (const float *const *) planar_in, planar_out, count);
+		interleaved->seconds += now() - start;
+		interleaved->count += count * BENCH_STREAMS;
+	}
+
+	for (int s = 0; s < BENCH_STREAMS; s++)
+	{
+		cverb_state_free(states[s]);
+		free(planar_in[s]);
+		free(planar_out[s]);
+	}
+	cverb_streams_free(streams);
+	free(block);
+}
+
+/*
+		Times a live engine that is handed a new delay and new gains every
+		BENCH_LIVE_FRAMES frames, so it never stops ramping and crossfading:
+		the worst case of live retuning.
+*/
+static void time_live(TestSignal *gen, const CVerbConfig *config, StageTime *stage)
+{
+	int16_t *block = malloc(BENCH_LIVE_FRAMES * sizeof(int16_t));
+	float *block_in = malloc(BENCH_LIVE_FRAMES * sizeof(float));
+	float *block_out = malloc(BENCH_LIVE_FRAMES * sizeof(float));
+	CVerbConfig configs[2] = { *config, *config };
+	size_t count;
+
+	configs[0].max_delay_ms = 1.5 * config->delay_ms;
+	configs[1].delay_ms = 1.5 * config->delay_ms;
+	configs[1].comb_fb = config->comb_fb / 2;
+	CVerbLive *live = cverb_live_create(&configs[0], gen->sample_rate);
+
+	for (int turn = 1; (count = test_signal_next(gen, block, BENCH_LIVE_FRAMES)) > 0; turn = !turn)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			block_in[i] = (float) block[i];
+		}
+
+		double start = now();
+		cverb_live_publish(live, &configs[turn]);
+		cverb_live_process(live, block_in, block_out, count);
+		stage->seconds += now() - start;
+		stage->count += count;
+	}
+
+	cverb_live_free(live);
+	free(block);
+	free(block_in);
+	free(block_out);
+}
+
+/*
+		Times the conversion of 24-bit samples, the packed format the kernels
+		have the most work with, to floats and back.
+*/
+static void time_convert(TestSignal *gen, StageTime *stages, int *num_stages)
+{
+	StageTime *to_float = add_stage(stages, num_stages, "to_float_s24");
+	StageTime *from_float = add_stage(stages, num_stages, "from_float_s24");
+	int16_t *block = malloc(BLOCK_FRAMES * sizeof(int16_t));
+	float *samples = malloc(BLOCK_FRAMES * sizeof(float));
+	unsigned char *packed = malloc(BLOCK_FRAMES * sample_format_bytes(SAMPLE_S24));
+	size_t count;
+
+	while ((count = test_signal_next(gen, block, BLOCK_FRAMES)) > 0)
+	{
+		convert_to_float(samples, block, SAMPLE_S16, count);
+
+		double start = now();
+		convert_from_float(packed, samples, SAMPLE_S24, count);
+		from_float->seconds += now() - start;
+		from_float->count += count;
+
+		start = now();
+		convert_to_float(samples, packed, SAMPLE_S24, count);
+		to_float->seconds += now() - start;
+		to_float->count += count;
+	}
+
+	free(block);
+	free(samples);
+	free(packed);
+}
+
+/*
+		Times parse_wav, reading and writing the sample data of the file at path.
+*/
+static void time_io(const char *path, size_t samples, StageTime *stages, int *num_stages)
+{
+	FILE *file = fopen(path, "rb");
+	WaveHeader header;
+
+	StageTime *parse = add_stage(stages, num_stages, "parse_wav");
+	parse->per_call = 1;
+	double start = now();
+	for (int i = 0; i < PARSE_REPEATS; i++)
+	{
+		rewind(file);
+		parse_wav(file, NULL, &header);
+	}
+	parse->seconds = now() - start;
+	parse->count = PARSE_REPEATS;
+
+	// Read and write the data in the block sizes process_blocks uses
+	StageTime *read = add_stage(stages, num_stages, "read");
+	const void *block;
+	size_t count;
+	int64_t checksum = 0;
+	start = now();
+	WavReader *reader = wav_reader_open(file, &header);
+	while ((count = wav_reader_read(reader, &block, BLOCK_FRAMES)) > 0)
+	{
+		const int16_t *samples = block;
+
+		// Touch every sample, a mapped file is only read when it is used
+		for (size_t i = 0; i < count; i++)
+		{
+			checksum += samples[i];
+		}
+		read->count += count;
+	}
+	wav_reader_close(reader);
+	read->seconds = now() - start;
+	fclose(file);
+
+	StageTime *write = add_stage(stages, num_stages, "write");
+	int16_t *data = calloc(BLOCK_FRAMES, sizeof(int16_t));
+	data[0] = (int16_t) checksum;
+	FILE *out = tmpfile();
+	start = now();
+	WavWriter *writer = wav_writer_open(out, &header, (uint64_t) samples * sizeof(int16_t));
+	for (size_t done = 0; done < samples; done += BLOCK_FRAMES)
+	{
+		count = samples - done < BLOCK_FRAMES ? samples - done : BLOCK_FRAMES;
+		wav_writer_write(writer, data, count);
+		write->count += count;
+	}
+	wav_writer_close(writer);
+	write->seconds = now() - start;
+	fclose(out);
+	free(data);
+}
+
+/*
+		Times whole renders from file to file, with the reference implementation
+		and with the block engine.
+*/
+static void time_renders(const char *path, size_t samples, StageTime *stages, int *num_stages)
+{
+	char *out_path = test_temp_file();
+
+	StageTime *reference = add_stage(stages, num_stages, "process_data");
+	double start = now();
+	render_reference(path, out_path);
+	reference->seconds = now() - start;
+	reference->count = samples;
+
+	RenderOptions options;
+	render_options_init(&options);
+	StageTime *render = add_stage(stages, num_stages, "render_file");
+	start = now();
+	render_file(path, out_path, &options);
+	render->seconds = now() - start;
+	render->count = samples;
+
+	options.pipelined = 1;
+	StageTime *pipelined = add_stage(stages, num_stages, "render_pipelined");
+	start = now();
+	render_file(path, out_path, &options);
+	pipelined->seconds = now() - start;
+	pipelined->count = samples;
+
+	unlink(out_path);
+	free(out_path);
+}
+
+/*
+		Prints one stage as a JSON member.
+*/
+static void print_stage(FILE *out, const StageTime *stage, int last)
+{
+	double ns = stage->count > 0 ? stage->seconds * 1e9 / stage->count : 0;
+	double rate = stage->seconds > 0 ? stage->count / stage->seconds : 0;
+
+	if (stage->per_call)
+	{
+		fprintf(out, "        \"%s\": { \"calls\": %zu, \"ns_per_call\": %.3f }%s\n",
+		        stage->name, stage->count, ns, last ? "" : ",");
+	}
+	else
+	{
+		fprintf(out, "        \"%s\": { \"ns_per_sample\": %.3f, \"samples_per_sec\": %.0f }%s\n",
+		        stage->name, ns, rate, last ? "" : ",");
+	}
+}
+
+/*
+		Splits a comma separated list of rates. Returns the amount found.
+*/
+static int parse_rates(char *list, unsigned int *rates)
+{
+	int count = 0;
+
+	for (char *item = strtok(list, ","); item != NULL && count < MAX_RATES; item = strtok(NULL, ","))
+	{
+		rates[count] = (unsigned int) strtoul(item, NULL, 10);
+		if (rates[count] < 1000)
+		{
+			return -1;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+/*
+		Marks the signals named in a comma separated list. Returns -1 on an unknown name.
+*/
+static int parse_signals(char *list, int *enabled)
+{
+	memset(enabled, 0, NUM_TEST_SIGNALS * sizeof(int));
+
+	for (char *item = strtok(list, ","); item != NULL; item = strtok(NULL, ","))
+	{
+		int found = 0;
+
+		for (int s = 0; s < NUM_TEST_SIGNALS; s++)
+		{
+			if (strcmp(item, test_signal_names[s]) == 0)
+			{
+				enabled[s] = found = 1;
+			}
+		}
+		if (!found)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: cverb-bench [-l seconds] [-r rate,...] [-s signal,...] [-I isa] [-o results.json]\n");
+	fprintf(stderr, "Signals: silence, noise, impulses, sweep. Rates default to 8000 to 192000 Hz.\n");
+	fprintf(stderr, "-I runs the kernels of scalar, sse2, avx2 or avx512 instead of the fastest ones.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = 5;
+	unsigned int rates[MAX_RATES];
+	int num_rates = NUM_DEFAULT_RATES;
+	int enabled[NUM_TEST_SIGNALS] = { 1, 1, 1, 1 };
+	FILE *out = stdout;
+	int ch;
+
+	memcpy(rates, default_rates, sizeof(default_rates));
+
+	while ((ch = getopt(argc, argv, "l:r:s:I:o:")) != EOF)
+	{
+		switch (ch)
+		{
+			case 'l':
+				seconds = atof(optarg);
+				break;
+			case 'r':
+				num_rates = parse_rates(optarg, rates);
+				break;
+			case 's':
+				if (parse_signals(optarg, enabled) != 0)
+				{
+					usage();
+					return 1;
+				}
+				break;
+			case 'I':
+				if (kernel_use_isa(optarg) != 0)
+				{
+					fprintf(stderr, "instruction set '%s' is unknown or not supported here\n", optarg);
+					return 1;
+				}
+				break;
+			case 'o':
+				out = fopen(optarg, "w");
+				if (out == NULL)
+				{
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				usage();
+				return 1;
+		}
+	}
+
+	if (seconds <= 0 || num_rates < 1)
+	{
+		usage();
+		return 1;
+	}
+
+	// The test signals are on the 16-bit scale, bypassed like the renderers do
+	CVerbConfig config;
+	config_init(&config);
+	config.silence = SILENCE_LEVEL;
+
+	fprintf(out, "{\n  \"isa\": \"%s\",\n  \"block_frames\": %d,\n  \"seconds\": %g,\n  \"results\": [\n",
+	        kernel_isa(), BLOCK_FRAMES, seconds);
+
+	int first = 1;
+	for (int s = 0; s < NUM_TEST_SIGNALS; s++)
+	{
+		for (int r = 0; r < num_rates && enabled[s]; r++)
+		{
+			unsigned int rate = rates[r];
+			size_t samples = (size_t) (seconds * rate);
+			StageTime stages[MAX_STAGES];
+			int num_stages = 0;
+			TestSignal gen;
+			WaveHeader header;
+
+			fprintf(stderr, "%s at %u Hz\n", test_signal_names[s], rate);
+			test_signal_header(&header, rate, samples);
+
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_reference_stages(&gen, &header, stages, &num_stages);
+
+			ImpulseResponse *ir = ir_render(&config, rate);
+			ReverbSpec spec = { ENGINE_SCHROEDER, &config, ir };
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_engine(&gen, &spec, add_stage(stages, &num_stages, "engine"));
+
+			spec.engine = ENGINE_CONVOLUTION;
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_engine(&gen, &spec, add_stage(stages, &num_stages, "conv"));
+
+			// The same network with a comb bank of eight Freeverb style combs in place of the taps
+			CVerbConfig bank_config = config;
+			bank_config.bank_combs = 8;
+			ReverbSpec bank_spec = { ENGINE_SCHROEDER, &bank_config, NULL };
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_engine(&gen, &bank_spec, add_stage(stages, &num_stages, "comb_bank"));
+
+			// A feedback delay network of fdn_lines lines in place of the whole network
+			spec.engine = ENGINE_FDN;
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_engine(&gen, &spec, add_stage(stages, &num_stages, "fdn"));
+
+			spec.engine = ENGINE_FIXED;
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_engine(&gen, &spec, add_stage(stages, &num_stages, "fixed"));
+
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			StageTime *engines = add_stage(stages, &num_stages, "engines_x16");
+			time_streams(&gen, &config, engines, add_stage(stages, &num_stages, "streams_x16"));
+
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_live(&gen, &config, add_stage(stages, &num_stages, "live_retune"));
+			ir_free(ir);
+
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			time_convert(&gen, stages, &num_stages);
+
+			test_signal_init(&gen, s, rate, samples, SIGNAL_AMPLITUDE);
+			char *path = test_temp_file();
+			test_signal_write(&gen, path);
+			time_io(path, samples, stages, &num_stages);
+			time_renders(path, samples, stages, &num_stages);
+			unlink(path);
+			free(path);
+
+			fprintf(out, "%s    {\n      \"signal\": \"%s\",\n      \"sample_rate\": %u,\n      \"samples\": %zu,\n      \"stages\": {\n",
+			        first ? "" : ",\n", test_signal_names[s], rate, samples);
+			for (int i = 0; i < num_stages; i++)
+			{
+				print_stage(out, &stages[i], i == num_stages - 1);
+			}
+			fprintf(out, "      }\n    }");
+			first = 0;
+		}
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+
+	return 0;
+}
@@ -0,0 +1,387 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Splits a single long file over several cores. Chunks can not simply be
+	rendered from silence, since every chunk hears the tail of the one
+	before it, so the delay lines each chunk starts from are worked out
+	first (see process_chunked).
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Header files */
+#include "chunked.h"
+#include "engine.h"
+#include "wavio.h"
+#include "convert.h"
+#include "pool.h"
+#include "constants.h"
+#include "instrument.h"
+
+/* Everything the chunk tasks share */
+typedef struct
+{
+	const unsigned char *samples;	// Interleaved input, memory mapped
+	SampleFormat in_format;
+	SampleFormat out_format;
+	size_t frames;						// Frames of the whole file
+	size_t chunk_frames;			// Frames of every chunk but the last
+	int channels;
+	unsigned int sample_rate;
+	const CVerbConfig *config;
+	size_t state_length;			// Floats of one exported state
+	float *carry;							// Delay lines at the start of each chunk, chunk major then channel
+	int fd;										// Output file
+	off_t data_offset;				// Position of the first sample in the output
+} ChunkJob;
+
+/* Argument of one chunk task */
+typedef struct
+{
+	ChunkJob *job;
+	int index;
+	int status;								// Result of run_chunk
+} ChunkTask;
+
+/*
+		Returns the exported delay lines of a channel at the start of a chunk.
+*/
+static float *carry_of(ChunkJob *job, int chunk, int channel)
+{
+	return job->carry + ((size_t) chunk * job->channels + channel) * job->state_length;
+}
+
+/*
+		Renders one chunk. Without write the chunk starts from silent lines and
+		its final lines are stored as the carry of the next chunk. With write
+		it starts from its own carry and its output is written to the file.
+		Returns -1 if writing failed, -2 if a state or a buffer could not be
+		created.
+*/
+static int run_chunk(ChunkJob *job, int index, int write)
+{
+	int channels = job->channels;
+	size_t start = (size_t) index * job->chunk_frames;
+	size_t frames = job->frames - start < job->chunk_frames ? job->frames - start : job->chunk_frames;
+	size_t in_bytes = sample_format_bytes(job->in_format);
+	size_t out_bytes = sample_format_bytes(job->out_format);
+	float *block_in = malloc(BLOCK_FRAMES * sizeof(float));
+	float *block_out = malloc(BLOCK_FRAMES * sizeof(float));
+	float *frames_in = malloc(BLOCK_FRAMES * channels * sizeof(float));
+	float *frames_out = malloc(BLOCK_FRAMES * channels * sizeof(float));
+	unsigned char *to_load = malloc(BLOCK_FRAMES * channels * out_bytes);
+	CVerbState **states = calloc(channels, sizeof(CVerbState *));
+	int r = 0;
+
+	if (block_in == NULL || block_out == NULL || frames_in == NULL || frames_out == NULL || to_load == NULL || states == NULL)
+	{
+		r = -2;
+	}
+	for (int c = 0; c < channels && r == 0; c++)
+	{
+		states[c] = cverb_state_create(job->config, job->sample_rate);
+		if (states[c] == NULL)
+		{
+			r = -2;
+		}
+		else if (write && index > 0)
+		{
+			cverb_state_import(states[c], carry_of(job, index, c));
+		}
+	}
+
+	for (size_t done = 0; done < frames && r == 0; done += BLOCK_FRAMES)
+	{
+		size_t count = frames - done < BLOCK_FRAMES ? frames - done : BLOCK_FRAMES;
+
+		convert_to_float(frames_in, job->samples + (start + done) * channels * in_bytes, job->in_format, count * channels);
+
+		for (int c = 0; c < channels; c++)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				block_in[i] = frames_in[i * channels + c];
+			}
+
+			cverb_process_block(states[c], block_in, block_out, count);
+
+			for (size_t i = 0; write && i < count; i++)
+			{
+				frames_out[i * channels + c] = block_out[i];
+			}
+		}
+
+		if (write)
+		{
+			size_t bytes = count * channels * out_bytes;
+			off_t offset = job->data_offset + (off_t) ((start + done) * channels * out_bytes);
+
+			convert_from_float(to_load, frames_out, job->out_format, count * channels);
+
+			PROBE_START(write_timer);
+			if (pwrite(job->fd, to_load, bytes, offset) != (ssize_t) bytes)
+			{
+				r = -1;
+			}
+			PROBE_STOP(write_timer, PROBE_WRITE, count * channels);
+			INSTRUMENT_POLL();
+		}
+	}
+
+	for (int c = 0; states != NULL && c < channels && states[c] != NULL; c++)
+	{
+		if (!write && r == 0)
+		{
+			cverb_state_export(states[c], carry_of(job, index + 1, c));
+		}
+		cverb_state_free(states[c]);
+	}
+
+	free(states);
+	free(block_in);
+	free(block_out);
+	free(frames_in);
+	free(frames_out);
+	free(to_load);
+
+	return r;
+}
+
+/* Pool task which finds what a chunk leaves in silent delay lines */
+static void measure_task(void *arg)
+{
+	ChunkTask *task = arg;
+
+	task->status = run_chunk(task->job, task->index, 0);
+}
+
+/* Pool task which renders a chunk from its carry and writes it */
+static void write_task(void *arg)
+{
+	ChunkTask *task = arg;
+
+	task->status = run_chunk(task->job, task->index, 1);
+}
+
+/*
+		Adds to the carry of chunk index + 1 what the carry of chunk index
+		turns into over the length of that chunk without any input. Stops
+		early once the lines have decayed below CHUNK_SILENCE, since nothing
+		audible is left to pass on. Returns -2 if a state or a buffer could
+		not be created.
+*/
+static int propagate_carry(ChunkJob *job, int index)
+{
+	float *silence = calloc(BLOCK_FRAMES, sizeof(float));
+	float *discard = malloc(BLOCK_FRAMES * sizeof(float));
+	float *lines = malloc(job->state_length * sizeof(float));
+	int r = silence != NULL && discard != NULL && lines != NULL ? 0 : -2;
+
+	for (int c = 0; c < job->channels && r == 0; c++)
+	{
+		CVerbState *state = cverb_state_create(job->config, job->sample_rate);
+		if (state == NULL)
+		{
+			r = -2;
+			break;
+		}
+
+		const float *from = carry_of(job, index, c);
+		float *to = carry_of(job, index + 1, c);
+		size_t left = job->chunk_frames;
+		int decayed = 0;
+
+		cverb_state_import(state, from);
+		while (left > 0 && !decayed)
+		{
+			size_t count = left < BLOCK_FRAMES ? left : BLOCK_FRAMES;
+
+			cverb_process_block(state, silence, discard, count);
+			left -= count;
+
+			cverb_state_export(state, lines);
+			decayed = 1;
+			for (size_t i = 0; i < job->state_length; i++)
+			{
+				if (lines[i] > CHUNK_SILENCE || lines[i] < -CHUNK_SILENCE)
+				{
+					decayed = 0;
+					break;
+				}
+			}
+		}
+
+		if (!decayed)
+		{
+			for (size_t i = 0; i < job->state_length; i++)
+			{
+				to[i] += lines[i];
+			}
+		}
+
+		cverb_state_free(state);
+	}
+
+	free(silence);
+	free(discard);
+	free(lines);
+
+	return r;
+}
+
+/*
+		Renders one file as options->chunks pieces side by side. The output
+		matches process_blocks() up to float rounding.
+
+		The network is linear and time invariant, so the delay lines at the
+		end of a chunk are the sum of what the chunk itself left behind and
+		what the lines held when it started, run on without input. The
+		chunks are first rendered from silent lines to find the former, the
+		latter is propagated from chunk to chunk on the calling thread
+		(until it has decayed), and finally every chunk is rendered again,
+		starting from its exact lines, and written in place.
+
+		Falls back to process_blocks() if the engine is not the comb/all pass
+		network, the input can not be memory mapped, the output is not a
+		regular file or no state can be created for the config. Samples are converted like process_blocks() does.
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the engine, a state or a buffer could not be
+		         created.
+*/
+int process_chunked (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options)
+{
+	struct stat info;
+	int channels = header->channels > 0 ? header->channels : 1;
+	SampleFormat format;
+
+	if (options->chunks < 2 || options->engine != ENGINE_SCHROEDER || options->tail_db > 0 || wav_sample_format(header, &format) != 0 ||
+	    fstat(fileno(out_file), &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		return process_blocks(in_file, out_file, header, options);
+	}
+
+	WavReader *reader = wav_reader_open(in_file, header);
+	if (reader->map == NULL)
+	{
+		wav_reader_close(reader);
+		return process_blocks(in_file, out_file, header, options);
+	}
+
+	ChunkJob job;
+	const void *samples;
+	job.frames = wav_reader_read(reader, &samples, SIZE_MAX) / channels;
+	job.samples = samples;
+	job.in_format = format;
+	job.out_format = options->out_format >= 0 ? (SampleFormat) options->out_format : job.in_format;
+	job.channels = channels;
+	job.sample_rate = header->sample_rate;
+	job.config = &options->config;
+
+	// Chunks shorter than a block are not worth a task
+	job.chunk_frames = (job.frames + options->chunks - 1) / options->chunks;
+	if (job.chunk_frames < BLOCK_FRAMES)
+	{
+		job.chunk_frames = BLOCK_FRAMES;
+	}
+	int chunks = job.frames > 0 ? (int) ((job.frames + job.chunk_frames - 1) / job.chunk_frames) : 1;
+
+	// The chunks create their states directly, so the config is checked here as cverb_engine_create() would
+	if (config_check(job.config, job.sample_rate) != 0)
+	{
+		wav_reader_close(reader);
+		return -2;
+	}
+
+	// process_blocks() reports a config the engine can not be created for
+	CVerbState *probe = cverb_state_create(job.config, job.sample_rate);
+	if (probe == NULL)
+	{
+		wav_reader_close(reader);
+		return process_blocks(in_file, out_file, header, options);
+	}
+	job.state_length = cverb_state_length(probe);
+	cverb_state_free(probe);
+	job.carry = calloc((size_t) (chunks + 1) * channels * job.state_length, sizeof(float));
+	ChunkTask *tasks = malloc(chunks * sizeof(ChunkTask));
+	if (job.carry == NULL || tasks == NULL)
+	{
+		free(job.carry);
+		free(tasks);
+		wav_reader_close(reader);
+		return -2;
+	}
+
+	WaveHeader out_header = *header;
+	wav_set_sample_format(&out_header, job.out_format);
+
+	// The length is known, so the header is final from the start (RF64 past 4 GB)
+	uint64_t data_size = (uint64_t) job.frames * channels * sample_format_bytes(job.out_format);
+
+	int r = 0;
+	if (write_wav_header(out_file, &out_header, data_size) != 0 || fflush(out_file) != 0)
+	{
+		r = -1;
+	}
+	job.fd = fileno(out_file);
+	job.data_offset = ftell(out_file);
+
+	ThreadPool *pool = pool_create(options->chunks);
+
+	// What every chunk leaves behind on its own (the last one has no successor)
+	for (int i = 0; i < chunks - 1 && r == 0; i++)
+	{
+		tasks[i].job = &job;
+		tasks[i].index = i;
+		pool_submit(pool, measure_task, &tasks[i]);
+	}
+	pool_wait(pool);
+	for (int i = 0; i < chunks - 1 && r == 0; i++)
+	{
+		r = tasks[i].status;
+	}
+
+	// The carry of chunk 1 is already exact, every later one inherits the tail of its predecessor
+	for (int i = 1; i < chunks - 1 && r == 0; i++)
+	{
+		r = propagate_carry(&job, i);
+	}
+
+	for (int i = 0; i < chunks && r == 0; i++)
+	{
+		tasks[i].job = &job;
+		tasks[i].index = i;
+		pool_submit(pool, write_task, &tasks[i]);
+	}
+	pool_free(pool);
+
+	for (int i = 0; i < chunks && r == 0; i++)
+	{
+		r = tasks[i].status;
+	}
+
+	// The header counts the padding after the data, which no chunk writes
+	static const unsigned char zeros[8] = { 0 };
+	size_t padding = wav_padding(&out_header, data_size);
+	if (r == 0 && padding > 0 && pwrite(job.fd, zeros, padding, job.data_offset + data_size) != (ssize_t) padding)
+	{
+		r = -1;
+	}
+
+	free(tasks);
+	free(job.carry);
+	wav_reader_close(reader);
+
+	return r;
+}
@@ -0,0 +1,36 @@
+#ifndef CHUNKED
+#define CHUNKED
+/* Libraries */
+#include <stdio.h>
+
+/* Header files */
+#include "wav.h"
+#include "render.h"
+
+/*
+		Renders one file as options->chunks pieces side by side. The output
+		matches process_blocks() up to float rounding.
+
+		The network is linear and time invariant, so the delay lines at the
+		end of a chunk are the sum of what the chunk itself left behind and
+		what the lines held when it started, run on without input. The
+		chunks are first rendered from silent lines to find the former, the
+		latter is propagated from chunk to chunk on the calling thread
+		(until it has decayed), and finally every chunk is rendered again,
+		starting from its exact lines, and written in place.
+
+		Falls back to process_blocks() if the engine is not the comb/all pass
+		network, the input can not be memory mapped, the output is not a
+		regular file or no state can be created for the config. Samples are converted like process_blocks() does.
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the engine, a state or a buffer could not be
+		         created.
+*/
+int process_chunked (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options);
+#endif
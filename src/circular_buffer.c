@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 #include "circular_buffer.h"
@@ -22,16 +23,28 @@ struct circular_buf_t {
 
 #pragma mark - Private Functions -
 
+// Steps an index forward by count (at most max), wrapping without a division
+static size_t wrap_index(cbuf_handle_t cbuf, size_t index, size_t count)
+{
+	index += count;
+	if(index >= cbuf->max)
+	{
+		index -= cbuf->max;
+	}
+
+	return index;
+}
+
 static void advance_pointer(cbuf_handle_t cbuf)
 {
 	assert(cbuf);
 
 	if(cbuf->full)
     {
-        cbuf->tail = (cbuf->tail + 1) % cbuf->max;
+        cbuf->tail = wrap_index(cbuf, cbuf->tail, 1);
     }
 
-	cbuf->head = (cbuf->head + 1) % cbuf->max;
+	cbuf->head = wrap_index(cbuf, cbuf->head, 1);
 
 	// We mark full because we will advance tail on the next time around
 	cbuf->full = (cbuf->head == cbuf->tail);
@@ -42,7 +55,7 @@ static void retreat_pointer(cbuf_handle_t cbuf)
 	assert(cbuf);
 
 	cbuf->full = false;
-	cbuf->tail = (cbuf->tail + 1) % cbuf->max;
+	cbuf->tail = wrap_index(cbuf, cbuf->tail, 1);
 }
 
 #pragma mark - APIs -
@@ -162,3 +175,58 @@ bool circular_buf_full(cbuf_handle_t cbuf)
 
     return cbuf->full;
 }
+
+size_t circular_buf_get_range(cbuf_handle_t cbuf, int16_t * data, size_t len)
+{
+    assert(cbuf && data && cbuf->buffer);
+
+    size_t count = circular_buf_size(cbuf);
+    if(count > len)
+    {
+        count = len;
+    }
+
+    // Copy up to the end of the storage, then the rest from the start
+    size_t first = cbuf->max - cbuf->tail;
+    if(first > count)
+    {
+        first = count;
+    }
+    memcpy(data, cbuf->buffer + cbuf->tail, first * sizeof(int16_t));
+    memcpy(data + first, cbuf->buffer, (count - first) * sizeof(int16_t));
+
+    if(count > 0)
+    {
+        cbuf->tail = wrap_index(cbuf, cbuf->tail, count);
+        cbuf->full = false;
+    }
+
+    return count;
+}
+
+size_t circular_buf_put_range(cbuf_handle_t cbuf, const int16_t * data, size_t len)
+{
+    assert(cbuf && data && cbuf->buffer);
+
+    size_t count = cbuf->max - circular_buf_size(cbuf);
+    if(count > len)
+    {
+        count = len;
+    }
+
+    size_t first = cbuf->max - cbuf->head;
+    if(first > count)
+    {
+        first = count;
+    }
+    memcpy(cbuf->buffer + cbuf->head, data, first * sizeof(int16_t));
+    memcpy(cbuf->buffer, data + first, (count - first) * sizeof(int16_t));
+
+    if(count > 0)
+    {
+        cbuf->head = wrap_index(cbuf, cbuf->head, count);
+        cbuf->full = (cbuf->head == cbuf->tail);
+    }
+
+    return count;
+}
@@ -66,7 +66,16 @@ size_t circular_buf_capacity(cbuf_handle_t cbuf);
 /// Returns the current number of elements in the buffer
 size_t circular_buf_size(cbuf_handle_t cbuf);
 
-//TODO: int circular_buf_get_range(circular_buf_t cbuf, uint8_t *data, size_t len);
-//TODO: int circular_buf_put_range(circular_buf_t cbuf, uint8_t * data, size_t len);
+/// Retrieve up to len values from the buffer in one call
+/// Values are copied out in at most two contiguous pieces
+/// Requires: cbuf is valid and created by circular_buf_init, data is not NULL
+/// Returns the number of values retrieved, 0 if the buffer is empty
+size_t circular_buf_get_range(cbuf_handle_t cbuf, int16_t * data, size_t len);
+
+/// Add up to len values to the buffer in one call
+/// Like put version 2, values that do not fit are rejected rather than overwriting old data
+/// Requires: cbuf is valid and created by circular_buf_init, data is not NULL
+/// Returns the number of values added
+size_t circular_buf_put_range(cbuf_handle_t cbuf, const int16_t * data, size_t len);
 
 #endif //CIRCULAR_BUFFER_H_
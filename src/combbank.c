@@ -0,0 +1,159 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Bank of independent damped combs, an alternative to the tapped
+	comb filter of the Schroeder network which gives a denser and less
+	metallic tail. The combs are stored struct of arrays so that all of
+	them are updated together by kernel_comb_bank.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Header files */
+#include "combbank.h"
+#include "kernels.h"
+#include "constants.h"
+#include "delayline.h"
+
+/*
+		Creates a comb bank for the bank settings of config and the given
+		sample rate. All combs start out silent.
+
+		config: Parameters of the reverb, config->bank_combs must be at least 1.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CombBank.
+*/
+CombBank *comb_bank_create(const CVerbConfig *config, unsigned int sample_rate)
+{
+	CombBank *bank = malloc(sizeof(CombBank));
+	int combs = config->bank_combs;
+
+	bank->num_combs = combs;
+	bank->lanes = (combs + 7) / 8 * 8;
+	bank->position = 0;
+	bank->fb = config->bank_fb;
+	bank->damp = config->bank_damp;
+
+	// Delays are spread evenly from the shortest to bank_spread times that, each
+	// moved up to the next unused prime so that no two combs share a factor
+	double shortest = config->bank_delay_ms * sample_rate / 1000;
+	int previous = 1;
+	for (int k = 0; k < bank->lanes; k++)
+	{
+		int delay = 1;
+
+		if (k < combs)
+		{
+			double spread = combs > 1 ? (config->bank_spread - 1) * k / (combs - 1) : 0;
+			delay = (int) lround(shortest * (1 + spread));
+			if (delay <= previous)
+			{
+				delay = previous + 1;
+			}
+			while (!is_prime(delay))
+			{
+				delay++;
+			}
+			previous = delay;
+		}
+
+		// Each comb gets an equal share of the input, so the bank is about as loud as one comb
+		bank->delays[k] = delay;
+		bank->gains[k] = k < combs ? config->comb_ff / combs : 0;
+		bank->damped[k] = 0;
+	}
+
+	unsigned int rows = 16;
+	while (rows <= (unsigned int) previous)
+	{
+		rows *= 2;
+	}
+	bank->mask = rows - 1;
+
+	bank->line_bytes = (size_t) rows * bank->lanes * sizeof(float);
+	if (posix_memalign((void **) &bank->line, 64, bank->line_bytes) != 0)
+	{
+		free(bank);
+		return NULL;
+	}
+	memset(bank->line, 0, bank->line_bytes);
+
+	return bank;
+}
+
+/*
+		Runs a block of samples through every comb and sums their outputs.
+
+		bank: Comb bank created by comb_bank_create.
+		in: Input samples.
+		out: Sum of the comb outputs (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void comb_bank_process(CombBank *bank, const float *in, float *out, size_t frames)
+{
+	kernel_comb_bank(out, in, bank->line, bank->delays, bank->gains, bank->damped, bank->num_combs, bank->lanes,
+	                 bank->mask, bank->position, bank->fb, bank->damp, frames);
+	bank->position += frames;
+}
+
+/*
+		Returns the amount of floats comb_bank_export writes.
+
+		bank: Comb bank created by comb_bank_create.
+*/
+size_t comb_bank_length(const CombBank *bank)
+{
+	return (size_t) (bank->mask + 1) * bank->lanes + bank->lanes;
+}
+
+/*
+		Copies the rows of the bank, oldest first, followed by the state of
+		every damping filter into one flat array. Like the rest of the
+		network the bank is linear, so the array of the sum of two signals
+		is the sum of their arrays.
+
+		bank: Comb bank created by comb_bank_create.
+		out: Room for comb_bank_length(bank) floats.
+*/
+void comb_bank_export(const CombBank *bank, float *out)
+{
+	size_t row_floats = bank->lanes;
+	size_t rows = bank->mask + 1;
+	size_t head = bank->position & bank->mask;
+
+	// The row of the next sample holds the oldest one
+	memcpy(out, bank->line + head * row_floats, (rows - head) * row_floats * sizeof(float));
+	memcpy(out + (rows - head) * row_floats, bank->line, head * row_floats * sizeof(float));
+	memcpy(out + rows * row_floats, bank->damped, row_floats * sizeof(float));
+}
+
+/*
+		Loads an array written by comb_bank_export into a bank created with
+		the same config and sample rate, replacing its history.
+
+		bank: Comb bank created by comb_bank_create.
+		in: comb_bank_length(bank) floats.
+*/
+void comb_bank_import(CombBank *bank, const float *in)
+{
+	size_t floats = (size_t) (bank->mask + 1) * bank->lanes;
+
+	memcpy(bank->line, in, floats * sizeof(float));
+	memcpy(bank->damped, in + floats, bank->lanes * sizeof(float));
+	bank->position = 0;
+}
+
+/*
+		Frees a comb bank and its delay lines.
+
+		bank: Comb bank created by comb_bank_create.
+*/
+void comb_bank_free(CombBank *bank)
+{
+	free(bank->line);
+	free(bank);
+}
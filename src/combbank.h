@@ -0,0 +1,97 @@
+#ifndef COMBBANK
+#define COMBBANK
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "config.h"
+
+#define MAX_BANK_LANES 16 // MAX_BANK_COMBS rounded up to a whole AVX2 register
+
+/* Struct which holds a bank of independent combs with damping.
+
+	 The tapped comb of the Schroeder network reads one line at whole
+	 multiples of one delay, which makes its echoes pile up on the same
+	 samples and sound metallic. The bank instead runs every comb on its
+	 own line with its own delay, all of them distinct primes so that no
+	 two combs share a common period, and a one pole lowpass in each
+	 feedback path that makes the tail darker as it decays (Freeverb's
+	 lowpass feedback comb).
+
+	 The damping filter makes each comb depend on its previous sample, so
+	 unlike the other stages a comb can not be computed a span at a time.
+	 The lines are kept struct of arrays instead: one row per sample holds
+	 that sample of every comb, and all combs are updated together in one
+	 row (see kernel_comb_bank). The lanes past num_combs have no input
+	 and stay silent.
+*/
+typedef struct
+{
+	float *line;												// mask + 1 rows of lanes floats, 64 byte aligned
+	size_t line_bytes;
+	int delays[MAX_BANK_LANES];					// Delay of each comb [samples]
+	float gains[MAX_BANK_LANES];				// Input gain of each comb, 0 past num_combs
+	float damped[MAX_BANK_LANES];				// State of each comb's damping filter
+	int num_combs;
+	int lanes;													// Floats per row, a multiple of 8
+	unsigned int mask;									// Amount of rows - 1
+	unsigned int position;							// Time of the next sample, masked to find its row
+	float fb;
+	float damp;
+} CombBank;
+
+/*
+		Creates a comb bank for the bank settings of config and the given
+		sample rate. All combs start out silent.
+
+		config: Parameters of the reverb, config->bank_combs must be at least 1.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CombBank.
+*/
+CombBank *comb_bank_create(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Runs a block of samples through every comb and sums their outputs.
+
+		bank: Comb bank created by comb_bank_create.
+		in: Input samples.
+		out: Sum of the comb outputs (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void comb_bank_process(CombBank *bank, const float *in, float *out, size_t frames);
+
+/*
+		Returns the amount of floats comb_bank_export writes.
+
+		bank: Comb bank created by comb_bank_create.
+*/
+size_t comb_bank_length(const CombBank *bank);
+
+/*
+		Copies the rows of the bank, oldest first, followed by the state of
+		every damping filter into one flat array. Like the rest of the
+		network the bank is linear, so the array of the sum of two signals
+		is the sum of their arrays.
+
+		bank: Comb bank created by comb_bank_create.
+		out: Room for comb_bank_length(bank) floats.
+*/
+void comb_bank_export(const CombBank *bank, float *out);
+
+/*
+		Loads an array written by comb_bank_export into a bank created with
+		the same config and sample rate, replacing its history.
+
+		bank: Comb bank created by comb_bank_create.
+		in: comb_bank_length(bank) floats.
+*/
+void comb_bank_import(CombBank *bank, const float *in);
+
+/*
+		Frees a comb bank and its delay lines.
+
+		bank: Comb bank created by comb_bank_create.
+*/
+void comb_bank_free(CombBank *bank);
+#endif
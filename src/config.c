@@ -0,0 +1,299 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Runtime reverb parameters. They replace recompiling with different
+	values in constants.h and can be given on the command line or in a
+	preset file.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Header files */
+#include "config.h"
+#include "constants.h"
+
+/*
+		Fills config with the defaults from constants.h, which give the
+		same sound as the reference implementation. The silence bypass is
+		off, since its level depends on the scale of the samples.
+
+		config: Config to initialize.
+*/
+void config_init(CVerbConfig *config)
+{
+	config->delay_ms = DELAY;
+	config->max_delay_ms = MAX_DELAY;
+	config->comb_ff = FF_C;
+	config->comb_fb = FB_C;
+	config->all_pass_ff = FF_A;
+	config->all_pass_fb = FB_A;
+	config->num_combs = NUM_COMB_FILTERS;
+	config->num_all_pass = NUM_ALL_PASS_FILTERS;
+	config->silence = -1;
+	config->bank_combs = BANK_COMBS;
+	config->bank_delay_ms = BANK_DELAY;
+	config->bank_spread = BANK_SPREAD;
+	config->bank_fb = BANK_FB;
+	config->bank_damp = BANK_DAMP;
+	config->fdn_lines = FDN_LINES;
+	config->fdn_delay_ms = FDN_DELAY;
+	config->fdn_spread = FDN_SPREAD;
+	config->fdn_decay = FDN_DECAY;
+}
+
+/* Parses a whole string as a number. Returns 0 on success. */
+static int parse_number(const char *value, double *number)
+{
+	char *end;
+
+	*number = strtod(value, &end);
+	return (end == value || *end != '\0') ? -1 : 0;
+}
+
+/*
+		Sets a single parameter from its name and a textual value.
+
+		Names: delay (ms), max_delay (ms), comb_ff, comb_fb, all_pass_ff,
+		       all_pass_fb, combs, all_passes, silence, bank_combs,
+		       bank_delay (ms), bank_spread, bank_fb, bank_damp, fdn_lines,
+		       fdn_delay (ms), fdn_spread, fdn_decay (s)
+		Delays may be at most MAX_DELAY_MS.
+
+		config: Config to change.
+		key: Name of the parameter.
+		value: New value.
+
+		returns: 0 on success, -1 if the name is unknown or the value invalid.
+*/
+int config_set(CVerbConfig *config, const char *key, const char *value)
+{
+	double number;
+
+	if (parse_number(value, &number) != 0)
+	{
+		return -1;
+	}
+
+	if (strcmp(key, "delay") == 0 && number > 0 && number <= MAX_DELAY_MS)
+	{
+		config->delay_ms = number;
+	}
+	else if (strcmp(key, "max_delay") == 0 && number >= 0 && number <= MAX_DELAY_MS)
+	{
+		config->max_delay_ms = number;
+	}
+	else if (strcmp(key, "comb_ff") == 0)
+	{
+		config->comb_ff = (float) number;
+	}
+	else if (strcmp(key, "comb_fb") == 0)
+	{
+		config->comb_fb = (float) number;
+	}
+	else if (strcmp(key, "all_pass_ff") == 0)
+	{
+		config->all_pass_ff = (float) number;
+	}
+	else if (strcmp(key, "all_pass_fb") == 0)
+	{
+		config->all_pass_fb = (float) number;
+	}
+	else if (strcmp(key, "combs") == 0 && number >= 0 && number <= MAX_COMB_TAPS && number == (int) number)
+	{
+		config->num_combs = (int) number;
+	}
+	else if (strcmp(key, "all_passes") == 0 && number >= 0 && number <= MAX_ALL_PASS && number == (int) number)
+	{
+		config->num_all_pass = (int) number;
+	}
+	else if (strcmp(key, "silence") == 0)
+	{
+		config->silence = (float) number;
+	}
+	else if (strcmp(key, "bank_combs") == 0 && number >= 0 && number <= MAX_BANK_COMBS && number == (int) number)
+	{
+		config->bank_combs = (int) number;
+	}
+	else if (strcmp(key, "bank_delay") == 0 && number > 0 && number <= MAX_DELAY_MS)
+	{
+		config->bank_delay_ms = number;
+	}
+	else if (strcmp(key, "bank_spread") == 0 && number >= 1)
+	{
+		config->bank_spread = (float) number;
+	}
+	else if (strcmp(key, "bank_fb") == 0)
+	{
+		config->bank_fb = (float) number;
+	}
+	else if (strcmp(key, "bank_damp") == 0 && number >= 0 && number <= 1)
+	{
+		config->bank_damp = (float) number;
+	}
+	else if (strcmp(key, "fdn_lines") == 0 && (number == 4 || number == 8 || number == MAX_FDN_LINES))
+	{
+		config->fdn_lines = (int) number;
+	}
+	else if (strcmp(key, "fdn_delay") == 0 && number > 0 && number <= MAX_DELAY_MS)
+	{
+		config->fdn_delay_ms = number;
+	}
+	else if (strcmp(key, "fdn_spread") == 0 && number >= 1)
+	{
+		config->fdn_spread = (float) number;
+	}
+	else if (strcmp(key, "fdn_decay") == 0 && number > 0)
+	{
+		config->fdn_decay = (float) number;
+	}
+	else
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+		Checks that every delay of a config, turned into samples at the given
+		sample rate, fits the delay lines. config_set keeps delays below
+		MAX_DELAY_MS, but only this check knows the sample rate, so only it
+		catches a delay shorter than one sample.
+
+		config: Config to check.
+		sample_rate: Sample rate the config will run at [Hz].
+
+		returns: 0 if the config can run, -1 (after printing why) if a delay
+		         is shorter than one sample or longer than MAX_DELAY_MS, or
+		         the sample rate is not between 1 and MAX_SAMPLE_RATE Hz.
+*/
+int config_check(const CVerbConfig *config, unsigned int sample_rate)
+{
+	if (sample_rate == 0 || sample_rate > MAX_SAMPLE_RATE)
+	{
+		fprintf(stderr, "config: sample rates from 1 to %d Hz are supported, not %u Hz\n", MAX_SAMPLE_RATE, sample_rate);
+		return -1;
+	}
+
+	// Written so that NaN fails as well
+	if (!(config->delay_ms > 0 && config->delay_ms <= MAX_DELAY_MS) ||
+	    !(config->max_delay_ms >= 0 && config->max_delay_ms <= MAX_DELAY_MS) ||
+	    !(config->bank_delay_ms > 0 && config->bank_delay_ms <= MAX_DELAY_MS) ||
+	    !(config->fdn_delay_ms > 0 && config->fdn_delay_ms <= MAX_DELAY_MS))
+	{
+		fprintf(stderr, "config: delays up to %d ms are supported\n", MAX_DELAY_MS);
+		return -1;
+	}
+
+	// A delay of 0 samples would read the slot it is about to write
+	if (config->delay_ms * sample_rate / 1000 < 1 || config->bank_delay_ms * sample_rate / 1000 < 1 ||
+	    config->fdn_delay_ms * sample_rate / 1000 < 1)
+	{
+		fprintf(stderr, "config: delays must be at least one sample (%.3f ms at %u Hz)\n", 1000.0 / sample_rate, sample_rate);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Strips whitespace from both ends of a string in place */
+static char *trim(char *text)
+{
+	while (isspace((unsigned char) *text))
+	{
+		text++;
+	}
+
+	char *end = text + strlen(text);
+	while (end > text && isspace((unsigned char) end[-1]))
+	{
+		end--;
+	}
+	*end = '\0';
+
+	return text;
+}
+
+/* Splits "name=value" at the '=' and sets the parameter. Modifies line. */
+static int set_from_line(CVerbConfig *config, char *line)
+{
+	char *equals = strchr(line, '=');
+
+	if (equals == NULL)
+	{
+		return -1;
+	}
+	*equals = '\0';
+
+	return config_set(config, trim(line), trim(equals + 1));
+}
+
+/*
+		Sets a parameter from a "name=value" string, as given on the command line.
+
+		config: Config to change.
+		assignment: String of the form name=value.
+
+		returns: 0 on success, -1 on a malformed or invalid assignment.
+*/
+int config_parse_assignment(CVerbConfig *config, const char *assignment)
+{
+	char line[256];
+
+	if (strlen(assignment) >= sizeof(line))
+	{
+		return -1;
+	}
+	strcpy(line, assignment);
+
+	return set_from_line(config, line);
+}
+
+/*
+		Reads a preset file. Each line holds one "name = value" pair. Blank
+		lines and everything after a '#' are ignored.
+
+		config: Config to change.
+		path: Path of the preset file.
+
+		returns: 0 on success, -1 if the file can not be read or holds an
+		         invalid line (which is reported on stderr).
+*/
+int config_load_preset(CVerbConfig *config, const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[256];
+	int number = 0;
+	int r = 0;
+
+	if (file == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		number++;
+
+		char *comment = strchr(line, '#');
+		if (comment != NULL)
+		{
+			*comment = '\0';
+		}
+
+		char *content = trim(line);
+		if (*content != '\0' && set_from_line(config, content) != 0)
+		{
+			fprintf(stderr, "%s:%d: invalid setting\n", path, number);
+			r = -1;
+		}
+	}
+
+	fclose(file);
+	return r;
+}
@@ -0,0 +1,112 @@
+#ifndef CONFIG
+#define CONFIG
+
+#define MAX_COMB_TAPS 16 // Largest amount of comb feedback taps a config may ask for
+#define MAX_ALL_PASS 16 // Largest amount of series all pass filters a config may ask for
+#define MAX_BANK_COMBS 16 // Largest amount of independent combs a config may ask for
+#define MAX_FDN_LINES 16 // Largest amount of delay lines of the feedback delay network
+#define MAX_DELAY_MS 10000 // Longest delay a config may ask for [ms], MAX_COMB_TAPS of them at MAX_SAMPLE_RATE stay far below INT_MAX samples
+#define MAX_SAMPLE_RATE 384000 // Highest sample rate an engine is created for [Hz]
+
+/* Struct which holds the tunable parameters of the reverb.
+
+	 Delays are given in milliseconds so that a config does not depend on
+	 the sample rate. They are turned into sample offsets once, when a
+	 reverb state is created for a particular sample rate.
+
+	 With bank_combs > 0 the comb taps are replaced by a bank of that many
+	 independent combs with damping, as in Freeverb (see combbank.h). The
+	 bank takes comb_ff as its input gain and ignores comb_fb and num_combs.
+
+	 The fdn_ parameters only apply to the feedback delay network engine
+	 (see fdn.h), which passes the dry signal with comb_ff and ignores
+	 the rest of the network.
+
+	 max_delay_ms only sizes the delay lines, so that a live engine (see
+	 live.h) can lengthen its delays without allocating.
+*/
+typedef struct
+{
+	double delay_ms;			// Length of one delay [ms]
+	double max_delay_ms;	// Longest delay_ms live retuning may switch to [ms], 0 for delay_ms
+	float comb_ff;				// Feedforward gain comb filter
+	float comb_fb;				// Feedback gain comb filter
+	float all_pass_ff;		// Feedforward gain all pass filters
+	float all_pass_fb;		// Feedback gain all pass filters
+	int num_combs;				// Amount of parallel comb filters (feedback taps)
+	int num_all_pass;			// Amount of all pass filters in series
+	float silence;				// Level below which a stage of the block engine is bypassed, on the scale of the samples, negative never
+	int bank_combs;				// Amount of independent combs, 0 to use the comb taps
+	double bank_delay_ms;	// Delay of the shortest independent comb [ms]
+	float bank_spread;		// Ratio of the longest to the shortest independent comb delay
+	float bank_fb;				// Feedback gain of the independent combs
+	float bank_damp;			// Damping of the independent combs, 0 (bright) to 1 (dark)
+	int fdn_lines;				// Delay lines of the feedback delay network, 4, 8 or 16
+	double fdn_delay_ms;	// Delay of the shortest line of the network [ms]
+	float fdn_spread;			// Ratio of the longest to the shortest line
+	float fdn_decay;			// Time to decay by 60 dB [s]
+} CVerbConfig;
+
+/*
+		Fills config with the defaults from constants.h, which give the
+		same sound as the reference implementation. The silence bypass is
+		off, since its level depends on the scale of the samples.
+
+		config: Config to initialize.
+*/
+void config_init(CVerbConfig *config);
+
+/*
+		Sets a single parameter from its name and a textual value.
+
+		Names: delay (ms), max_delay (ms), comb_ff, comb_fb, all_pass_ff,
+		       all_pass_fb, combs, all_passes, silence, bank_combs,
+		       bank_delay (ms), bank_spread, bank_fb, bank_damp, fdn_lines,
+		       fdn_delay (ms), fdn_spread, fdn_decay (s)
+		Delays may be at most MAX_DELAY_MS.
+
+		config: Config to change.
+		key: Name of the parameter.
+		value: New value.
+
+		returns: 0 on success, -1 if the name is unknown or the value invalid.
+*/
+int config_set(CVerbConfig *config, const char *key, const char *value);
+
+/*
+		Checks that every delay of a config, turned into samples at the given
+		sample rate, fits the delay lines. config_set keeps delays below
+		MAX_DELAY_MS, but only this check knows the sample rate, so only it
+		catches a delay shorter than one sample.
+
+		config: Config to check.
+		sample_rate: Sample rate the config will run at [Hz].
+
+		returns: 0 if the config can run, -1 (after printing why) if a delay
+		         is shorter than one sample or longer than MAX_DELAY_MS, or
+		         the sample rate is not between 1 and MAX_SAMPLE_RATE Hz.
+*/
+int config_check(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Sets a parameter from a "name=value" string, as given on the command line.
+
+		config: Config to change.
+		assignment: String of the form name=value.
+
+		returns: 0 on success, -1 on a malformed or invalid assignment.
+*/
+int config_parse_assignment(CVerbConfig *config, const char *assignment);
+
+/*
+		Reads a preset file. Each line holds one "name = value" pair. Blank
+		lines and everything after a '#' are ignored.
+
+		config: Config to change.
+		path: Path of the preset file.
+
+		returns: 0 on success, -1 if the file can not be read or holds an
+		         invalid line (which is reported on stderr).
+*/
+int config_load_preset(CVerbConfig *config, const char *path);
+#endif
@@ -1,11 +1,38 @@
-/* Define system constants */
+#ifndef CONSTANTS
+#define CONSTANTS
+/* Define system constants. The reverb parameters are the defaults of
+   CVerbConfig (see config.h) and the values used by the reference path. */
 #define CIRC_BUFF_SAMPLES 6 // Circular buffer capacity
-#define CIRC_BUFF_SIZE CIRC_BUFF_SAMPLES * (header->bits_per_sample / 16) // Calculate size of circular buffer
+#define CIRC_BUFF_SIZE(bits_per_sample) (CIRC_BUFF_SAMPLES * ((bits_per_sample) / 16)) // Calculate size of circular buffer
 #define DELAY 32 // Length of delay [ms]
 #define FF_C 1.0 // Feedfoward gain comb filter
 #define FB_C 0.18 // Feedback gain comb filter
 #define FF_A 0.131 // Feedfoward gain comb filter
 #define FB_A 0.131 // Feedback gain comb filter
-#define PBUFF_LENGTH ((5 * DELAY * (header->sample_rate) / 1000) + 50) // Calculate length of proecessing buffer
-#define DELAY_SAMPLES  DELAY * header->sample_rate / 1000 // Calculate amount of samples for one delay length
+#define PBUFF_LENGTH(sample_rate) ((5 * DELAY * (sample_rate) / 1000) + 50) // Calculate length of proecessing buffer
+#define DELAY_SAMPLES(sample_rate) (DELAY * (sample_rate) / 1000) // Calculate amount of samples for one delay length
+#define COMB_TAP_SAMPLES(tap, sample_rate) ((tap) * DELAY * (sample_rate) / 1000) // Samples for tap delay lengths, rounded once
 #define NUM_COMB_FILTERS 4 // Defines number of parellel comb filters in system
+#define NUM_ALL_PASS_FILTERS 4 // Defines number of series all pass filters in system
+#define BANK_COMBS 0 // Independent combs replacing the tapped comb filter, 0 keeps the tapped comb
+#define BANK_DELAY 25.3 // Delay of the shortest independent comb [ms], Freeverb's 1116 samples at 44.1 kHz
+#define BANK_SPREAD 1.45 // Ratio of the longest to the shortest independent comb delay
+#define BANK_FB 0.84 // Feedback gain of each independent comb
+#define BANK_DAMP 0.2 // Damping in the feedback path of each independent comb, 0 (bright) to 1 (dark)
+#define FDN_LINES 8 // Delay lines of the feedback delay network engine
+#define FDN_DELAY 23.0 // Delay of the shortest line of the feedback delay network [ms]
+#define FDN_SPREAD 2.2 // Ratio of the longest to the shortest line of the feedback delay network
+#define FDN_DECAY 1.6 // Time for the feedback delay network to decay by 60 dB [s]
+#define MAX_DELAY 0 // Longest delay live retuning may switch to [ms], 0 for no longer than the delay it starts with
+#define RAMP_FRAMES 1024 // Frames a live parameter change takes to ramp its gains and crossfade its delays
+#define RAMP_STEP_FRAMES 32 // Longest span with constant gains while a ramp runs
+#define MAX_SPAN_FRAMES 256 // Longest run one kernel call processes; delay lines are this much longer than their taps
+#define BLOCK_FRAMES 16384 // Amount of frames read, processed and written at once by the block engine
+#define PIPELINE_BLOCKS 8 // Blocks in flight between the threads of a pipelined render, a power of two
+#define SILENCE_LEVEL 1e-2 // Level below which the renderers bypass a stage of the block engine, on the 16-bit scale of their floats (-130 dBFS)
+#define CHUNK_SILENCE 1e-5f // Delay line level below which a chunk's inherited tail counts as decayed
+#define CONV_BLOCK_FRAMES 512 // Partition length of the convolution engine, also its latency
+#define IR_MAX_SECONDS 30 // Longest impulse response rendered from the comb/all pass network, and longest flushed tail
+#define TAIL_QUIET_SECONDS 0.5 // How long a flushed tail has to stay below its threshold before the render ends
+#define IR_SILENCE 1e-6f // Level (-120 dB) below which a rendered impulse response counts as decayed
+#endif
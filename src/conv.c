@@ -0,0 +1,171 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Convolution reverb. Instead of simulating a room with delay lines,
+	the input is convolved with a recorded (or rendered) impulse response.
+	Convolving in the frequency domain costs the same per sample however
+	dense the tail is, which stacking more filter stages cannot offer.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* Header files */
+#include "conv.h"
+#include "kernels.h"
+#include "instrument.h"
+
+/*
+		Creates a convolution reverb for an impulse response.
+		The reverb starts out silent.
+
+		ir: Samples of the impulse response.
+		ir_length: Amount of samples in ir.
+		block: Partition length, a power of two of at least 2.
+
+		returns: Pointer to the new ConvState, or NULL if block is not supported.
+*/
+ConvState *conv_state_create(const float *ir, size_t ir_length, int block)
+{
+	FftPlan *fft = fft_plan_create(2 * block);
+	if (fft == NULL)
+	{
+		return NULL;
+	}
+
+	ConvState *state = malloc(sizeof(ConvState));
+	state->fft = fft;
+	state->block = block;
+	state->bins = block + 1;
+	state->stride = (state->bins + 15) & ~15;
+	state->num_partitions = ir_length > 0 ? (int) ((ir_length + block - 1) / block) : 1;
+	state->latency = block;
+	state->fdl_head = 0;
+	state->position = 0;
+
+	size_t spectra = (size_t) state->num_partitions * state->stride;
+	size_t floats = 4 * spectra + 2 * (size_t) state->stride + 5 * (size_t) block;
+	if (posix_memalign((void **) &state->arena, 64, floats * sizeof(float)) != 0)
+	{
+		fft_plan_free(fft);
+		free(state);
+		return NULL;
+	}
+	memset(state->arena, 0, floats * sizeof(float));
+
+	state->ir_re = state->arena;
+	state->ir_im = state->ir_re + spectra;
+	state->fdl_re = state->ir_im + spectra;
+	state->fdl_im = state->fdl_re + spectra;
+	state->acc_re = state->fdl_im + spectra;
+	state->acc_im = state->acc_re + state->stride;
+	state->time = state->acc_im + state->stride;
+	state->overlap = state->time + 2 * block;
+	state->in_block = state->overlap + block;
+	state->out_block = state->in_block + block;
+
+	// The inverse transform is not normalized, so scale the partitions instead
+	float scale = 1.0f / (2 * block);
+	for (int p = 0; p < state->num_partitions; p++)
+	{
+		size_t start = (size_t) p * block;
+		size_t length = start < ir_length ? ir_length - start : 0;
+		if (length > (size_t) block)
+		{
+			length = block;
+		}
+
+		for (int i = 0; i < 2 * block; i++)
+		{
+			state->time[i] = (size_t) i < length ? scale * ir[start + i] : 0;
+		}
+		fft_real_forward(fft, state->time, state->ir_re + p * state->stride, state->ir_im + p * state->stride);
+	}
+
+	return state;
+}
+
+/*
+		Convolves the block in in_block with the impulse response and moves
+		the result into out_block.
+*/
+static void convolve_block(ConvState *state)
+{
+	int block = state->block;
+	int stride = state->stride;
+
+	// Transform the zero padded input into the oldest slot of the delay line
+	state->fdl_head = (state->fdl_head + state->num_partitions - 1) % state->num_partitions;
+	memcpy(state->time, state->in_block, block * sizeof(float));
+	memset(state->time + block, 0, block * sizeof(float));
+	fft_real_forward(state->fft, state->time, state->fdl_re + state->fdl_head * stride, state->fdl_im + state->fdl_head * stride);
+
+	// Partition p of the impulse response meets the input from p blocks ago
+	memset(state->acc_re, 0, 2 * stride * sizeof(float));
+	for (int p = 0; p < state->num_partitions; p++)
+	{
+		int slot = (state->fdl_head + p) % state->num_partitions;
+
+		kernel_complex_mac(state->acc_re, state->acc_im,
+		                   state->fdl_re + slot * stride, state->fdl_im + slot * stride,
+		                   state->ir_re + p * stride, state->ir_im + p * stride, state->bins);
+	}
+
+	fft_real_inverse(state->fft, state->acc_re, state->acc_im, state->time);
+
+	// The first half completes the current block, the second half is carried into the next one
+	for (int i = 0; i < block; i++)
+	{
+		state->out_block[i] = state->time[i] + state->overlap[i];
+	}
+	memcpy(state->overlap, state->time + block, block * sizeof(float));
+}
+
+/*
+		Convolves a block of samples with the impulse response.
+
+		state: Reverb state created by conv_state_create.
+		in: Input samples.
+		out: Output samples, delayed by state->latency samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void conv_process_block(ConvState *state, const float *in, float *out, size_t frames)
+{
+	unsigned int mode = kernel_flush_denormals();
+	size_t done = 0;
+
+	while (done < frames)
+	{
+		size_t room = state->block - state->position;
+		size_t span = frames - done < room ? frames - done : room;
+
+		// Each input sample takes the place of the output sample one block older
+		memcpy(state->in_block + state->position, in + done, span * sizeof(float));
+		memcpy(out + done, state->out_block + state->position, span * sizeof(float));
+		state->position += span;
+		done += span;
+
+		if (state->position == state->block)
+		{
+			PROBE_START(conv_timer);
+			convolve_block(state);
+			PROBE_STOP(conv_timer, PROBE_CONV, state->block);
+			state->position = 0;
+		}
+	}
+
+	kernel_restore_denormals(mode);
+}
+
+/*
+		Frees a convolution reverb.
+
+		state: Reverb state created by conv_state_create.
+*/
+void conv_state_free(ConvState *state)
+{
+	fft_plan_free(state->fft);
+	free(state->arena);
+	free(state);
+}
@@ -0,0 +1,70 @@
+#ifndef CONV
+#define CONV
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "fft.h"
+
+/* Struct which holds one uniformly partitioned convolution reverb.
+
+	 The impulse response is cut into partitions of block samples and
+	 each partition is transformed once, up front. Every block of input
+	 is transformed once as well and kept in a frequency domain delay
+	 line, so one block of output is the inverse transform of the sum of
+	 every stored input spectrum times the matching partition spectrum.
+	 Consecutive blocks are joined with overlap-add.
+
+	 Input is collected until a whole block is available, so the output
+	 lags the input by block samples (see latency).
+*/
+typedef struct
+{
+	int block;									// Partition length [samples]
+	int bins;										// Bins of one spectrum, block + 1
+	int stride;									// Distance between consecutive spectra [floats]
+	int num_partitions;
+	int latency;								// Delay of the output [samples]
+	FftPlan *fft;								// Plan of size 2 * block
+
+	float *arena;								// Single allocation holding every array below
+	float *ir_re, *ir_im;				// Spectrum of each impulse response partition
+	float *fdl_re, *fdl_im;			// Spectra of the last num_partitions input blocks
+	int fdl_head;								// Slot of the newest input spectrum
+	float *acc_re, *acc_im;			// Sum of the products for the current block
+	float *time;								// 2 * block samples of time domain scratch
+	float *overlap;							// Second half of the previous block's result
+	float *in_block;						// Input being collected
+	float *out_block;						// Output being handed out
+	int position;								// Samples collected into in_block
+} ConvState;
+
+/*
+		Creates a convolution reverb for an impulse response.
+		The reverb starts out silent.
+
+		ir: Samples of the impulse response.
+		ir_length: Amount of samples in ir.
+		block: Partition length, a power of two of at least 2.
+
+		returns: Pointer to the new ConvState, or NULL if block is not supported.
+*/
+ConvState *conv_state_create(const float *ir, size_t ir_length, int block);
+
+/*
+		Convolves a block of samples with the impulse response.
+
+		state: Reverb state created by conv_state_create.
+		in: Input samples.
+		out: Output samples, delayed by state->latency samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void conv_process_block(ConvState *state, const float *in, float *out, size_t frames);
+
+/*
+		Frees a convolution reverb.
+
+		state: Reverb state created by conv_state_create.
+*/
+void conv_state_free(ConvState *state);
+#endif
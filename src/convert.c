@@ -0,0 +1,125 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Vectorized conversion between the samples of a data chunk and the
+	floats the engines work with. Files are little endian like the
+	machines C-Verb runs on, so only 24-bit samples, which have no
+	native type, need to be taken apart byte by byte.
+*/
+
+/* Libraries */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/* Header files */
+#include "convert.h"
+#include "kernels.h"
+
+/* Scalar kernels */
+
+void convert_to_float_scalar(float *out, const void *in, SampleFormat format, size_t count)
+{
+	const unsigned char *bytes = in;
+
+	for (size_t j = 0; j < count; j++)
+	{
+		int16_t s16;
+		int32_t s32;
+		float f32;
+
+		switch (format)
+		{
+			case SAMPLE_U8:
+				out[j] = (float) ((bytes[j] - 128) * 256);
+				break;
+			case SAMPLE_S16:
+				memcpy(&s16, bytes + 2 * j, sizeof(s16));
+				out[j] = (float) s16;
+				break;
+			case SAMPLE_S24:
+				// Placed in the top three bytes, so the sign comes along
+				s32 = (int32_t) ((uint32_t) bytes[3 * j] << 8 | (uint32_t) bytes[3 * j + 1] << 16 | (uint32_t) bytes[3 * j + 2] << 24);
+				out[j] = (float) s32 * (1.0f / 65536);
+				break;
+			case SAMPLE_S32:
+				memcpy(&s32, bytes + 4 * j, sizeof(s32));
+				out[j] = (float) s32 * (1.0f / 65536);
+				break;
+			case SAMPLE_F32:
+				memcpy(&f32, bytes + 4 * j, sizeof(f32));
+				out[j] = f32 * 32768.0f;
+				break;
+			default:
+				out[j] = 0;
+				break;
+		}
+	}
+}
+
+/*
+		Limits sample to [low, high].
+*/
+static float clamp(float sample, float low, float high)
+{
+	if (sample > high)
+	{
+		sample = high;
+	}
+	if (sample < low)
+	{
+		sample = low;
+	}
+	return sample;
+}
+
+void convert_from_float_scalar(void *out, const float *in, SampleFormat format, size_t count)
+{
+	unsigned char *bytes = out;
+
+	for (size_t j = 0; j < count; j++)
+	{
+		int16_t s16;
+		int32_t s32;
+		float f32;
+
+		switch (format)
+		{
+			case SAMPLE_U8:
+				bytes[j] = (unsigned char) (lrintf(clamp(in[j] * (1.0f / 256), -128.0f, 127.0f)) + 128);
+				break;
+			case SAMPLE_S16:
+				s16 = (int16_t) clamp(in[j], INT16_MIN, INT16_MAX);
+				memcpy(bytes + 2 * j, &s16, sizeof(s16));
+				break;
+			case SAMPLE_S24:
+				s32 = (int32_t) lrintf(clamp(in[j] * 256.0f, -8388608.0f, 8388607.0f));
+				bytes[3 * j] = s32 & 0xff;
+				bytes[3 * j + 1] = (s32 >> 8) & 0xff;
+				bytes[3 * j + 2] = (s32 >> 16) & 0xff;
+				break;
+			case SAMPLE_S32:
+				s32 = (int32_t) lrintf(clamp(in[j] * 65536.0f, -2147483648.0f, S32_CLAMP));
+				memcpy(bytes + 4 * j, &s32, sizeof(s32));
+				break;
+			case SAMPLE_F32:
+				f32 = in[j] * (1.0f / 32768);
+				memcpy(bytes + 4 * j, &f32, sizeof(f32));
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/* The fastest variant the processor supports, from kernels_<isa>.c */
+
+void convert_to_float(float *out, const void *in, SampleFormat format, size_t count)
+{
+	kernel_table()->to_float(out, in, format, count);
+}
+
+void convert_from_float(void *out, const float *in, SampleFormat format, size_t count)
+{
+	kernel_table()->from_float(out, in, format, count);
+}
@@ -0,0 +1,54 @@
+#ifndef CONVERT
+#define CONVERT
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "wav.h"
+
+#define S32_CLAMP 2147483520.0f // Largest float below 2^31, larger values do not fit in an int32_t
+
+/*
+		Kernels which convert the samples of a data chunk to and from the
+		floats the engines work with. Floats are kept on the scale of 16-bit
+		samples whatever the file holds, so a 16-bit sample converts to the
+		same value as before and the engines need not know about formats:
+
+		u8:  (x - 128) * 256
+		s16: x
+		s24: x / 256
+		s32: x / 65536
+		f32: x * 32768
+
+		Converting back clamps to the range of the format. 16-bit output is
+		truncated like process_data() does, every other format is rounded to
+		the nearest value.
+
+		The kernels without a suffix call the fastest variant the processor
+		supports, picked like the DSP kernels of kernels.h. The _scalar
+		variants are always available and produce bit for bit the same
+		output.
+*/
+
+/*
+		Converts samples of a data chunk to floats.
+
+		out: Converted samples.
+		in: Samples as stored in the file (any alignment).
+		format: Encoding of in.
+		count: Amount of samples.
+*/
+void convert_to_float(float *out, const void *in, SampleFormat format, size_t count);
+void convert_to_float_scalar(float *out, const void *in, SampleFormat format, size_t count);
+
+/*
+		Converts floats to samples of a data chunk.
+
+		out: Samples as they are stored in the file (any alignment).
+		in: Samples to convert.
+		format: Encoding of out.
+		count: Amount of samples.
+*/
+void convert_from_float(void *out, const float *in, SampleFormat format, size_t count);
+void convert_from_float_scalar(void *out, const float *in, SampleFormat format, size_t count);
+#endif
@@ -1,9 +1,12 @@
 /*
 	Authors: Mark Goldwater, Nathaniel Tan
 
-	This code processes a monochannel .wav file in order
-	to add the effect of Schroeder Reverb to the sound. It
-	outputs a file called 'C-Verb.wav'.
+	This code processes a .wav file (8, 16, 24 or 32-bit PCM or
+	32-bit float) in order to add the effect of Schroeder Reverb
+	to the sound. Every channel is processed on its own. It outputs
+	a file called 'C-Verb.wav' unless told otherwise, and can also
+	run as a filter from stdin to stdout. The per-sample reference
+	path (-r) only handles monochannel 16-bit files.
 
 */
 
@@ -15,225 +18,203 @@
 #include <stdint.h>
 
 /* Header files */
-#include "circular_buffer.h"
-#include "wav.h"
-#include "pbuff.h"
+#include "reference.h"
+#include "render.h"
+#include "batch.h"
 #include "constants.h"
-
-// Input circular buffer
-cbuf_handle_t inputBuff;
-
-/*
-		Retrieves a sample from the global circular buffer.
-
-		retreived: Pointer to variable which will
-							 store the retrieved sample.
-*/
-void retrieve_sample (int16_t *retrieved)
-{
-		circular_buf_get(inputBuff, retrieved);
-}
-
-/*
-		Reads sample from the .wav file and stores it
-		in the circular buffer.
-
-		in_file: File object for the input .wav file.
-*/
-void buffer_sample(FILE *in_file)
-{
-		int16_t toBuffer;
-
-		fread(&toBuffer, sizeof(toBuffer), 1, in_file);
-
-		circular_buf_put(inputBuff, toBuffer);
-}
-
-
-/*
-		Filter which calculates the output of NUM_COMB_FILTERS comb filters
-		for the sample that is marked by the head of the input buffer (pBuff_in).
-
-		sample_out: Variable to hold output of parellel comb filters.
-		pBuff_in: Processing buffer which stores input of comb filters.
-		pBuff_out Processing buffer which stores output of comb filters.
-		header: Struct that stores metadata of the sound file. Used in the #defined constants
-		        (see in constants.h).
-*/
-void apply_comb_filter (float *sample_out, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, WaveHeader *header)
-{
-		int index;
-		*sample_out = FF_C * pbuff_get(pBuff_in, NULL);
-
-		// Each iteration of the for loop is applying a separate comb filter
-		for (int i = 0; i < NUM_COMB_FILTERS; i++)
-		{
-			// Index takes into account the delay from the pBuff head
-			index = pbuff_get_head(pBuff_out) - (int) ((i+1) * DELAY_SAMPLES);
-
-			// If the index goes beyond the lower bound of the array, wrap to the end
-			if(index < 0)
-			{
-				index = pbuff_get_length(pBuff_out) + index;
-			}
-
-			// Applies feedback
-			*sample_out += FB_C * pbuff_get(pBuff_out, &index);
-		}
-}
+#include "kernels.h"
+#include "instrument.h"
 
 /*
-		Applies a singular all pass filter at the sample pointed to by the head of the
-		input buffer.
-
-		sample_out: Variable to hold output of parellel comb filters.
-		pBuff_in: Processing buffer which stores input of comb filters.
-		pBuff_out Processing buffer which stores output of comb filters.
-		header: Struct that stores metadata of the sound file. Used in the #defined constants
-						(see in constants.h).
+		Prints how to use the program.
 */
-void apply_all_pass_filter(float *output, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, WaveHeader *header)
+void usage (void)
 {
-	int index;
-	*output = 0;
-
-	// Index takes into account the delay from the pBuff head
-	index = pbuff_get_head(pBuff_out) - (int) (DELAY_SAMPLES);
-
-	// If the index goes beyond the lower bound of the array, wrap to the end
-	if(index < 0)
-	{
-		index = pbuff_get_length(pBuff_out) + index;
-	}
-
-	// Applies feedback
-	*output += (-1)*FF_A*pbuff_get(pBuff_in, NULL);
-	*output += pbuff_get(pBuff_in, &index);
-	*output += FB_A*pbuff_get(pBuff_out, &index);
-}
-
-
-/*
-  	Proccess_data takes the in and out files, the in and out processing buffers and the wav Header
-		It buffers a sample, retrieves that sample and then applies the comb filter to that sample.
-		The resulting proccessed sample is then stored in the out_file.
-
-		in_file: Input .wav sound file.
-		out_file: Output .wav sound file with processed data.
-		pBuff_in: Circular processing buffer for the input data from in_file
-		pBuff_comb_out: Circular processing buffer to store the output of the parellel comb filters.
-		pBuff_all_pass_1: Circular processing buffer for the output of the first all pass filter.
-		pBuff_all_pass_2: Circular processing buffer for the output of the second all pass filter.
-		pBuff_all_pass_3: Circular processing buffer for the output of the third all pass filter.
-		pBuff_all_pass_4: Circular processing buffer for the output of the fourth all pass filter.
-		pBuff_out: Circular processing buffer for the output of the DSP system.
-		header: Struct that stores metadata of the sound file. Used in the #defined constants
-						(see in constants.h).
-*/
-void process_data (FILE *in_file, FILE *out_file, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_comb_out, ProcessingBuffer *pBuff_all_pass_1, ProcessingBuffer *pBuff_all_pass_2, ProcessingBuffer *pBuff_all_pass_3, ProcessingBuffer *pBuff_all_pass_4, ProcessingBuffer *pBuff_out, WaveHeader *header)
-{
-		int16_t retrieved;
-		float sample_out;
-		int16_t to_load;
-		float comb_output;
-		float all_pass_output_1, all_pass_output_2, all_pass_output_3, all_pass_output_4;
-
-		// Buffering a sample and then immediately retrieving it seems unnecessary, but it is to simulate
-		// getting samples from a live input (a guitar) instead of a wav file.
-		buffer_sample(in_file);
-		retrieve_sample(&retrieved);
-
-		pbuff_put(pBuff_in, (float) retrieved);
-
-		apply_comb_filter(&comb_output, pBuff_in, pBuff_comb_out, header);
-		pbuff_put(pBuff_comb_out, comb_output);
-
-		apply_all_pass_filter(&all_pass_output_1, pBuff_comb_out, pBuff_all_pass_1, header);
-		pbuff_put(pBuff_all_pass_1, all_pass_output_1);
-
-		apply_all_pass_filter(&all_pass_output_2, pBuff_all_pass_1, pBuff_all_pass_2, header);
-		pbuff_put(pBuff_all_pass_2, all_pass_output_2);
-
-		apply_all_pass_filter(&all_pass_output_3, pBuff_all_pass_2, pBuff_all_pass_3, header);
-		pbuff_put(pBuff_all_pass_3, all_pass_output_3);
-
-		apply_all_pass_filter(&all_pass_output_4, pBuff_all_pass_3, pBuff_all_pass_4, header);
-		pbuff_put(pBuff_all_pass_4, all_pass_output_4);
-
-		sample_out = comb_output + all_pass_output_1 + all_pass_output_2 + all_pass_output_3 + all_pass_output_4;
-
-		pbuff_put(pBuff_out, sample_out);
-
-		// Updates pointer to head in circular processing buffer (input)
-		pbuff_update_head(pBuff_in);
-
-		// Update pointer to head in all pass filter functions
-		pbuff_update_head(pBuff_comb_out);
-		pbuff_update_head(pBuff_all_pass_1);
-		pbuff_update_head(pBuff_all_pass_2);
-		pbuff_update_head(pBuff_all_pass_3);
-		pbuff_update_head(pBuff_all_pass_4);
-
-		// Updates pointer to head in circular processing buffer (output)
-		pbuff_update_head(pBuff_out);
-
-		to_load = (int16_t) sample_out;
-
-		fwrite(&to_load, sizeof(to_load), 1, out_file);
+		fprintf(stderr, "usage: cverb [-r] [-t threads] [-o output.wav] [-f format] [-R rate[:channels]] [-e engine] [-i ir.wav] [-p preset] [-s name=value] [-T db] [-I isa] [-P] input.wav\n");
+		fprintf(stderr, "       cverb -b out_dir [-j threads] [-f format] [-e engine] [-i ir.wav] [-p preset] [-s name=value] [-T db] [-I isa] input.wav|directory ...\n");
+		fprintf(stderr, "Use - as input or output to read from stdin or write to stdout.\n");
+		fprintf(stderr, "Input may be RIFF, RF64 or Wave64. Output past 4 GB is written as RF64.\n");
+		fprintf(stderr, "-R reads headerless 16-bit little endian PCM.\n");
+		fprintf(stderr, "-f sets the sample format of the output: u8, s16, s24, s32 or f32.\n");
+		fprintf(stderr, "The default is the format of the input.\n");
+		fprintf(stderr, "-t splits one long file into chunks rendered on that many threads.\n");
+		fprintf(stderr, "-P reads, processes and writes on three threads instead, to hide slow storage,\n");
+		fprintf(stderr, "and prints how long each of them waited for the others.\n");
+		fprintf(stderr, "-p and -s set reverb parameters: delay (ms), comb_ff, comb_fb,\n");
+		fprintf(stderr, "all_pass_ff, all_pass_fb, combs, all_passes. -r ignores them.\n");
+		fprintf(stderr, "Stages quieter than silence (default 0.01 of a 16-bit step) are skipped, silence=-1\n");
+		fprintf(stderr, "never skips.\n");
+		fprintf(stderr, "-T keeps rendering the tail after the input ends, until it is db below the\n");
+		fprintf(stderr, "loudest output.\n");
+		fprintf(stderr, "bank_combs=N swaps the comb taps for N independent damped combs (Freeverb\n");
+		fprintf(stderr, "style), tuned with bank_delay (ms), bank_spread, bank_fb and bank_damp.\n");
+		fprintf(stderr, "-e picks the engine: schroeder (default), conv, fixed or fdn. conv convolves with\n");
+		fprintf(stderr, "the 16-bit impulse response given with -i, or with the network's own response.\n");
+		fprintf(stderr, "fixed runs the network in 16-bit fixed point (the default of FIXED=1 builds).\n");
+		fprintf(stderr, "fdn runs a feedback delay network instead, tuned with fdn_lines (4, 8 or 16),\n");
+		fprintf(stderr, "fdn_delay (ms), fdn_spread and fdn_decay (s).\n");
+		fprintf(stderr, "-I forces the kernels of one instruction set: scalar, sse2, avx2 or avx512.\n");
+		fprintf(stderr, "The default is the fastest one the processor supports.\n");
 }
 
 int main (int argc, char *argv[])
 {
+		int use_reference = 0;
+		const char *batch_dir = NULL;
+		const char *out_path = "C-Verb.wav";
+		const char *ir_path = NULL;
+		int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+		RenderOptions options;
+		render_options_init(&options);
+		INSTRUMENT_INIT();
 
 		/* Handle command line arguments */
-		char ch;
-    while ((ch = getopt(argc, argv, ":") != EOF)) {
+		int ch;
+    while ((ch = getopt(argc, argv, "rb:j:t:o:f:R:p:s:e:i:T:I:P")) != EOF) {
         switch(ch) {
-            default:
-                fprintf(stderr, "invalid option '%s' \n", optarg);
+            case 'r':
+                // Use the per-sample reference implementation
+                use_reference = 1;
+                break;
+            case 'b':
+                // Render every input into this directory
+                batch_dir = optarg;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 't':
+                // Render a single file in chunks, one per thread
+                options.chunks = atoi(optarg);
+                if (options.chunks < 1)
+                {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'P':
+                // Read, process and write a single file on three threads
+                options.pipelined = 1;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'f':
+            {
+                SampleFormat format;
+                if (sample_format_from_name(optarg, &format) != 0)
+                {
+                    fprintf(stderr, "unknown sample format '%s'\n", optarg);
+                    return 1;
+                }
+                options.out_format = format;
+                break;
+            }
+            case 'p':
+                if (config_load_preset(&options.config, optarg) != 0)
+                {
+                    return 1;
+                }
+                break;
+            case 's':
+                if (config_parse_assignment(&options.config, optarg) != 0)
+                {
+                    fprintf(stderr, "invalid setting '%s'\n", optarg);
+                    return 1;
+                }
                 break;
+            case 'e':
+                if (reverb_engine_from_name(optarg, &options.engine) != 0)
+                {
+                    fprintf(stderr, "unknown engine '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                // An impulse response only makes sense for the convolution engine
+                ir_path = optarg;
+                options.engine = ENGINE_CONVOLUTION;
+                break;
+            case 'T':
+                // Render the tail past the end of the input
+                options.tail_db = atof(optarg);
+                if (options.tail_db <= 0)
+                {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'I':
+                // Pick the kernels by hand instead of by CPUID, to test each of them
+                if (kernel_use_isa(optarg) != 0)
+                {
+                    fprintf(stderr, "instruction set '%s' is unknown or not supported here\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'R':
+                // Headerless input given as rate or rate:channels
+                if (sscanf(optarg, "%u:%u", &options.raw_rate, &options.raw_channels) < 1 ||
+                    options.raw_rate == 0 || options.raw_channels == 0)
+                {
+                    usage();
+                    return 1;
+                }
+                break;
+            default:
+                usage();
+                return 1;
         }
     }
 
     argc -= optind;
     argv += optind;
 
-		/* Open input file and create a new output file for the procesed signal */
-		FILE *in_file = fopen(argv[0], "rb");
-		FILE *out_file = fopen("C-Verb.wav", "w");
-
-		/* Instantiate struct to hold header data of .wav file */
-		WaveHeader *header = malloc(sizeof(WaveHeader));
-
-		/* Parse header data from the .wav file */
-		parse_wav(in_file, out_file, header);
+		if (argc < 1 || threads < 1)
+		{
+			usage();
+			return 1;
+		}
 
-		/* Create instance of circular buffer */
-		int16_t buffOnStack[CIRC_BUFF_SIZE];
-		inputBuff = circular_buf_init(buffOnStack, CIRC_BUFF_SIZE);
+		if (!use_reference || batch_dir != NULL)
+		{
+			ImpulseResponse *ir = NULL;
+			int r;
 
-		/* Instantiate in and out sample buffers*/
-		ProcessingBuffer *pBuff_in = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_out = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_comb_out = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_all_pass_1 = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_all_pass_2 = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_all_pass_3 = construct_processing_buffer(header);
-		ProcessingBuffer *pBuff_all_pass_4 = construct_processing_buffer(header);
+			// Read a measured impulse response once, every render shares it
+			if (ir_path != NULL && (ir = ir_load(ir_path)) == NULL)
+			{
+				return 1;
+			}
+			options.ir = ir;
 
+			if (batch_dir != NULL)
+			{
+				r = render_batch(argv, argc, batch_dir, threads, &options);
+			}
+			else
+			{
+				PipelineStats stats = { 0 };
+				options.threads = threads;
+				options.stats = &stats;
+				r = render_file(argv[0], out_path, &options);
+
+				// The thread that waited least held the others up
+				if (options.pipelined)
+				{
+					fprintf(stderr, "pipeline: %zu blocks, reader waited %zu times (%.3f s) for free blocks, "
+					        "dsp %zu times (%.3f s) for input, writer %zu times (%.3f s) for output\n",
+					        stats.blocks, stats.read_waits, stats.read_wait_seconds, stats.dsp_waits,
+					        stats.dsp_wait_seconds, stats.write_waits, stats.write_wait_seconds);
+				}
+			}
 
-		while (!feof(in_file))
-		{
-			process_data(in_file, out_file, pBuff_in, pBuff_comb_out, pBuff_all_pass_1, pBuff_all_pass_2, pBuff_all_pass_3, pBuff_all_pass_4, pBuff_out, header);
+			if (ir != NULL)
+			{
+				ir_free(ir);
+			}
+			return r == 0 ? 0 : 1;
 		}
 
-		// Close files
-		fclose(in_file);
-		fclose(out_file);
-				
-		/* Not completly necessary to free here since the program
-		   is about to end, but let's do it for practice */
-		free(header);
-		pbuff_free(pBuff_in);
-		pbuff_free(pBuff_out);
+		return render_reference(argv[0], out_path) == 0 ? 0 : 1;
 }
@@ -0,0 +1,61 @@
+#ifndef DELAYLINE
+#define DELAYLINE
+/*
+		Helpers the engines share to size delay lines and to walk them in
+		spans. They are static inline, so they stay internal to each engine
+		and libcverb exports nothing new.
+*/
+
+#define LINE_ALIGN_BYTES 64 // Delay lines start on a cache line, and so on an AVX-512 register
+
+/*
+		Returns the smallest power of two which is at least length and at
+		least minimum. Engines pass the amount of samples in LINE_ALIGN_BYTES
+		as the minimum, so lines laid out one after another stay aligned.
+
+		length: Amount of samples the line has to hold.
+		minimum: Shortest length, a power of two.
+*/
+static inline int next_power_of_two(int length, int minimum)
+{
+	int power = minimum;
+
+	while (power < length)
+	{
+		power *= 2;
+	}
+
+	return power;
+}
+
+/*
+		Shortens a span so that reading it starting at index does
+		not run past the end of a circular buffer of the given length.
+*/
+static inline int clamp_span(int span, int index, int length)
+{
+	if (span > length - index)
+	{
+		span = length - index;
+	}
+
+	return span;
+}
+
+/* Returns whether number is prime */
+static inline int is_prime(int number)
+{
+	if (number < 2)
+	{
+		return 0;
+	}
+	for (int divisor = 2; divisor * divisor <= number; divisor++)
+	{
+		if (number % divisor == 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+#endif
@@ -0,0 +1,594 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Block based implementation of the Schroeder reverb in cverb.c.
+	Instead of pushing every sample through all stages of the network
+	one at a time, each stage is run over a span of samples before the
+	next stage starts.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* Header files */
+#include "engine.h"
+#include "kernels.h"
+#include "constants.h"
+#include "delayline.h"
+#include "instrument.h"
+
+/*
+		Turns a delay into comb taps and an all pass delay for the given
+		sample rate. Returns how far back the comb line is read.
+*/
+static int resolve_delays(double delay_ms, int num_combs, unsigned int sample_rate, int *comb_taps, int *all_pass_delay)
+{
+	// Each tap is rounded from its full length, like COMB_TAP_SAMPLES in the reference path.
+	// Multiplying before dividing keeps the result exact for whole millisecond delays.
+	for (int i = 0; i < num_combs; i++)
+	{
+		comb_taps[i] = (int) ((i+1) * delay_ms * sample_rate / 1000);
+	}
+	*all_pass_delay = (int) (delay_ms * sample_rate / 1000);
+
+	if (num_combs > 0 && comb_taps[num_combs - 1] > *all_pass_delay)
+	{
+		return comb_taps[num_combs - 1];
+	}
+	return *all_pass_delay;
+}
+
+/*
+		Returns the longest span for the given delays which has no intra-span
+		feedback and does not overwrite anything the lines still read.
+*/
+static int span_limit(const CVerbState *state, int all_pass_delay, int comb_reach)
+{
+	int span = all_pass_delay < MAX_SPAN_FRAMES ? all_pass_delay : MAX_SPAN_FRAMES;
+
+	span = clamp_span(span, comb_reach, state->comb_out.length);
+	if (state->num_all_pass > 0)
+	{
+		span = clamp_span(span, all_pass_delay, state->all_pass[0].length);
+	}
+
+	return span < 1 ? 1 : span;
+}
+
+/*
+		Creates a reverb state for the given parameters and sample rate.
+		All delay lines start out silent.
+
+		config: Parameters of the reverb, which pass config_check.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CVerbState.
+*/
+CVerbState *cverb_state_create(const CVerbConfig *config, unsigned int sample_rate)
+{
+	CVerbState *state = malloc(sizeof(CVerbState));
+
+	// The comb bank has lines of its own and leaves comb_out without taps
+	state->bank = NULL;
+	state->num_combs = config->num_combs;
+	if (config->bank_combs > 0)
+	{
+		state->bank = comb_bank_create(config, sample_rate);
+		state->num_combs = 0;
+		if (state->bank == NULL)
+		{
+			free(state);
+			return NULL;
+		}
+	}
+	state->num_all_pass = config->num_all_pass;
+	state->comb_ff = config->comb_ff;
+	state->comb_fb = config->comb_fb;
+	state->all_pass_ff = config->all_pass_ff;
+	state->all_pass_fb = config->all_pass_fb;
+	state->sample_rate = sample_rate;
+	state->ramp_length = 0;
+	state->fading = 0;
+	state->silence = config->silence;
+	state->bypassed = 0;
+	memset(state->quiet, 0, sizeof(state->quiet));
+	resolve_delays(config->delay_ms, state->num_combs, sample_rate, state->comb_taps, &state->all_pass_delay);
+
+	// A span may not reach further than the shortest feedback delay
+	state->max_span = state->all_pass_delay < MAX_SPAN_FRAMES ? state->all_pass_delay : MAX_SPAN_FRAMES;
+
+	// The lines are sized for the longest delay live retuning may switch to. The comb
+	// line reaches back to its last tap, but the all pass lines (which are also read
+	// by the next stage) only one all pass delay.
+	double longest_ms = config->max_delay_ms > config->delay_ms ? config->max_delay_ms : config->delay_ms;
+	int longest_taps[MAX_COMB_TAPS];
+	int longest_delay;
+	int comb_reach = resolve_delays(longest_ms, state->num_combs, sample_rate, longest_taps, &longest_delay);
+	int longest_span = longest_delay < MAX_SPAN_FRAMES ? longest_delay : MAX_SPAN_FRAMES;
+	int comb_length = next_power_of_two(comb_reach + longest_span, LINE_ALIGN_BYTES / sizeof(float));
+	int all_pass_length = next_power_of_two(longest_delay + longest_span, LINE_ALIGN_BYTES / sizeof(float));
+
+	// Power of two lengths of at least 16 floats keep every line 64 byte aligned.
+	// The two spans of a crossfade follow the lines.
+	size_t floats = comb_length + (size_t) state->num_all_pass * all_pass_length + 2 * RAMP_STEP_FRAMES;
+	state->arena_bytes = floats * sizeof(float);
+	if (posix_memalign((void **) &state->arena, 64, state->arena_bytes) != 0)
+	{
+		if (state->bank != NULL)
+		{
+			comb_bank_free(state->bank);
+		}
+		free(state);
+		return NULL;
+	}
+
+	pbuff_init_storage(&state->comb_out, state->arena, comb_length);
+	state->all_pass = malloc(state->num_all_pass * sizeof(ProcessingBuffer));
+	for (int i = 0; i < state->num_all_pass; i++)
+	{
+		pbuff_init_storage(&state->all_pass[i], state->arena + comb_length + (size_t) i * all_pass_length, all_pass_length);
+	}
+	state->fade_from = state->arena + comb_length + (size_t) state->num_all_pass * all_pass_length;
+	state->fade_to = state->fade_from + RAMP_STEP_FRAMES;
+
+	return state;
+}
+
+/*
+		Returns the longest span of a running ramp: at most one step, no
+		further than the end of the ramp and short enough for the delays on
+		both sides of it.
+*/
+static int ramp_span(const CVerbState *state)
+{
+	int span = state->ramp_length - state->ramp_done;
+
+	if (span > RAMP_STEP_FRAMES)
+	{
+		span = RAMP_STEP_FRAMES;
+	}
+	if (span > state->max_span)
+	{
+		span = state->max_span;
+	}
+	if (span > state->ramp_max_span)
+	{
+		span = state->ramp_max_span;
+	}
+
+	return span;
+}
+
+/*
+		Sets the gains to where the ramp is halfway through the next span.
+*/
+static void ramp_gains(CVerbState *state, int span)
+{
+	const CVerbGains *from = &state->ramp_from;
+	const CVerbGains *to = &state->ramp_to;
+	float weight = (state->ramp_done + 0.5f * span) / state->ramp_length;
+
+	state->comb_ff = from->comb_ff + weight * (to->comb_ff - from->comb_ff);
+	state->comb_fb = from->comb_fb + weight * (to->comb_fb - from->comb_fb);
+	state->all_pass_ff = from->all_pass_ff + weight * (to->all_pass_ff - from->all_pass_ff);
+	state->all_pass_fb = from->all_pass_fb + weight * (to->all_pass_fb - from->all_pass_fb);
+}
+
+/*
+		Blends the span of a stage run through the old delays (fade_from)
+		into the one run through the new delays (fade_to), sample by sample.
+*/
+static void crossfade(const CVerbState *state, float *out, int span)
+{
+	float step = 1.0f / state->ramp_length;
+	float weight = (state->ramp_done + 0.5f) * step;
+
+	for (int i = 0; i < span; i++)
+	{
+		out[i] = state->fade_from[i] + (weight + i * step) * (state->fade_to[i] - state->fade_from[i]);
+	}
+}
+
+/*
+		Moves the ramp on by a processed span, and settles the state on the
+		new gains and delays once it is over.
+*/
+static void ramp_advance(CVerbState *state, int span)
+{
+	state->ramp_done += span;
+	if (state->ramp_done < state->ramp_length)
+	{
+		return;
+	}
+
+	state->comb_ff = state->ramp_to.comb_ff;
+	state->comb_fb = state->ramp_to.comb_fb;
+	state->all_pass_ff = state->ramp_to.all_pass_ff;
+	state->all_pass_fb = state->ramp_to.all_pass_fb;
+	if (state->fading)
+	{
+		memcpy(state->comb_taps, state->fade_taps, sizeof(state->comb_taps));
+		state->all_pass_delay = state->fade_all_pass_delay;
+		state->fading = 0;
+	}
+	state->max_span = state->ramp_max_span;
+	state->ramp_length = 0;
+}
+
+/*
+		Adds a span known to be silent to the silent samples at the end of a line.
+*/
+static void add_quiet(CVerbState *state, int index, const ProcessingBuffer *line, int span)
+{
+	state->quiet[index] = state->quiet[index] + span < line->length ? state->quiet[index] + span : line->length;
+}
+
+/*
+		Counts the silent samples at the end of a line once a span has been
+		written to it. A span whose input was not silent is taken to be loud
+		without looking, which only ever delays a bypass.
+*/
+static void track_quiet(CVerbState *state, int index, const ProcessingBuffer *line, const float *written, int span, int maybe_silent)
+{
+	if (maybe_silent && kernel_peak(written, span) <= state->silence)
+	{
+		add_quiet(state, index, line, span);
+	}
+	else
+	{
+		state->quiet[index] = 0;
+	}
+}
+
+/*
+		Runs a block of samples through the comb bank and the all pass chain.
+
+		state: Reverb state created by cverb_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void cverb_process_block(CVerbState *state, const float *in, float *out, size_t frames)
+{
+	unsigned int mode = kernel_flush_denormals();
+	int tracking = state->silence >= 0;
+	size_t done = 0;
+
+	while (done < frames)
+	{
+		ProcessingBuffer *comb_out = &state->comb_out;
+		int max_span = state->ramp_length > 0 ? ramp_span(state) : state->max_span;
+		int span = (frames - done < (size_t) max_span) ? (int) (frames - done) : max_span;
+
+		// Find where each read and write starts and shorten the span so none of them wrap
+		span = clamp_span(span, comb_out->head, comb_out->length);
+		const float *taps[MAX_COMB_TAPS];
+		for (int i = 0; i < state->num_combs; i++)
+		{
+			int index = pbuff_delayed_index(comb_out, state->comb_taps[i]);
+			span = clamp_span(span, index, comb_out->length);
+			taps[i] = comb_out->buffer + index;
+		}
+
+		// Lines of the all pass chain are read at their head and one all pass delay back
+		int delayed[MAX_ALL_PASS + 1];
+		delayed[0] = pbuff_delayed_index(comb_out, state->all_pass_delay);
+		span = clamp_span(span, delayed[0], comb_out->length);
+		for (int i = 0; i < state->num_all_pass; i++)
+		{
+			ProcessingBuffer *line = &state->all_pass[i];
+			delayed[i + 1] = pbuff_delayed_index(line, state->all_pass_delay);
+			span = clamp_span(span, line->head, line->length);
+			span = clamp_span(span, delayed[i + 1], line->length);
+		}
+
+		// While the delays crossfade, the lines are read at the new delays as well
+		const float *new_taps[MAX_COMB_TAPS];
+		int new_delayed[MAX_ALL_PASS + 1];
+		if (state->fading)
+		{
+			for (int i = 0; i < state->num_combs; i++)
+			{
+				int index = pbuff_delayed_index(comb_out, state->fade_taps[i]);
+				span = clamp_span(span, index, comb_out->length);
+				new_taps[i] = comb_out->buffer + index;
+			}
+			new_delayed[0] = pbuff_delayed_index(comb_out, state->fade_all_pass_delay);
+			span = clamp_span(span, new_delayed[0], comb_out->length);
+			for (int i = 0; i < state->num_all_pass; i++)
+			{
+				ProcessingBuffer *line = &state->all_pass[i];
+				new_delayed[i + 1] = pbuff_delayed_index(line, state->fade_all_pass_delay);
+				span = clamp_span(span, new_delayed[i + 1], line->length);
+			}
+		}
+		if (state->ramp_length > 0)
+		{
+			ramp_gains(state, span);
+		}
+
+		// A stage may be skipped once its input and everything it reads are silent. The
+		// comb reads its line up to the last tap back, an all pass filter its input line
+		// one delay back and up to this span, and its own line one delay back.
+		int silent_in = tracking && kernel_peak(in + done, span) <= state->silence;
+		int comb_reach = state->num_combs > 0 ? state->comb_taps[state->num_combs - 1] : 0;
+		int skipped = 0;
+
+		float *comb = comb_out->buffer + comb_out->head;
+		PROBE_START(comb_timer);
+		if (state->bank != NULL)
+		{
+			comb_bank_process(state->bank, in + done, comb, span);
+		}
+		else if (silent_in && !state->fading && state->quiet[0] >= comb_reach)
+		{
+			memset(comb, 0, span * sizeof(float));
+			add_quiet(state, 0, comb_out, span);
+			skipped++;
+		}
+		else if (state->fading)
+		{
+			kernel_comb(state->fade_from, in + done, taps, state->num_combs, state->comb_ff, state->comb_fb, span);
+			kernel_comb(state->fade_to, in + done, new_taps, state->num_combs, state->comb_ff, state->comb_fb, span);
+			crossfade(state, comb, span);
+		}
+		else
+		{
+			kernel_comb(comb, in + done, taps, state->num_combs, state->comb_ff, state->comb_fb, span);
+		}
+		if (tracking && skipped == 0)
+		{
+			track_quiet(state, 0, comb_out, comb, span, silent_in);
+		}
+		PROBE_STOP(comb_timer, PROBE_COMB, span);
+
+		// The all pass filters are in series, each one reads the previous stage's output
+		ProcessingBuffer *stage_in = comb_out;
+		for (int i = 0; i < state->num_all_pass; i++)
+		{
+			ProcessingBuffer *stage_out = &state->all_pass[i];
+			float *written = stage_out->buffer + stage_out->head;
+			int silent_stage_in = tracking && state->quiet[i] >= span;
+			int zeroed = 0;
+			PROBE_START(all_pass_timer);
+			if (silent_stage_in && !state->fading && state->quiet[i] >= state->all_pass_delay + span &&
+			    state->quiet[i + 1] >= state->all_pass_delay)
+			{
+				memset(written, 0, span * sizeof(float));
+				add_quiet(state, i + 1, stage_out, span);
+				zeroed = 1;
+				skipped++;
+			}
+			else if (state->fading)
+			{
+				kernel_all_pass(state->fade_from, stage_in->buffer + stage_in->head,
+				                stage_in->buffer + delayed[i], stage_out->buffer + delayed[i + 1],
+				                state->all_pass_ff, state->all_pass_fb, span);
+				kernel_all_pass(state->fade_to, stage_in->buffer + stage_in->head,
+				                stage_in->buffer + new_delayed[i], stage_out->buffer + new_delayed[i + 1],
+				                state->all_pass_ff, state->all_pass_fb, span);
+				crossfade(state, stage_out->buffer + stage_out->head, span);
+			}
+			else
+			{
+				kernel_all_pass(stage_out->buffer + stage_out->head, stage_in->buffer + stage_in->head,
+				                stage_in->buffer + delayed[i], stage_out->buffer + delayed[i + 1],
+				                state->all_pass_ff, state->all_pass_fb, span);
+			}
+			if (tracking && !zeroed)
+			{
+				track_quiet(state, i + 1, stage_out, written, span, silent_stage_in);
+			}
+			PROBE_STOP(all_pass_timer, PROBE_ALL_PASS + i, span);
+			stage_in = stage_out;
+		}
+
+		// The output taps the comb bank and the space after every all pass filter
+		PROBE_START(mix_timer);
+		if (skipped == 1 + state->num_all_pass)
+		{
+			memset(out + done, 0, span * sizeof(float));
+		}
+		else
+		{
+			memcpy(out + done, comb, span * sizeof(float));
+			for (int i = 0; i < state->num_all_pass; i++)
+			{
+				kernel_accumulate(out + done, state->all_pass[i].buffer + state->all_pass[i].head, span);
+			}
+		}
+		PROBE_STOP(mix_timer, PROBE_MIX, span);
+		state->bypassed += skipped;
+
+		pbuff_advance_head(comb_out, span);
+		for (int i = 0; i < state->num_all_pass; i++)
+		{
+			pbuff_advance_head(&state->all_pass[i], span);
+		}
+		if (state->ramp_length > 0)
+		{
+			ramp_advance(state, span);
+		}
+		done += span;
+	}
+
+	kernel_restore_denormals(mode);
+}
+
+/*
+		Checks whether cverb_state_retune would accept a config. Only reads
+		what is fixed when the state is created, so any thread may ask while
+		another one processes.
+
+		state: Reverb state created by cverb_state_create.
+		config: Parameters to retune to.
+
+		returns: 1 if the config only changes gains and delays, and its
+		         delays fit into the lines, 0 otherwise.
+*/
+int cverb_state_can_retune(const CVerbState *state, const CVerbConfig *config)
+{
+	// The comb bank keeps delays of its own, and the amount of lines is fixed
+	if (state->bank != NULL || config->bank_combs > 0 || config->num_combs != state->num_combs ||
+	    config->num_all_pass != state->num_all_pass)
+	{
+		return 0;
+	}
+
+	// Every line needs room for at least one sample past the furthest one it reads
+	int taps[MAX_COMB_TAPS];
+	int all_pass_delay;
+	int comb_reach = resolve_delays(config->delay_ms, state->num_combs, state->sample_rate, taps, &all_pass_delay);
+
+	return all_pass_delay >= 1 && comb_reach < state->comb_out.length &&
+	       (state->num_all_pass == 0 || all_pass_delay < state->all_pass[0].length);
+}
+
+/*
+		Starts moving the state to the gains and delay of config, which
+		takes the next RAMP_FRAMES processed frames. Never allocates.
+
+		state: Reverb state created by cverb_state_create.
+		config: Parameters to retune to.
+
+		returns: 0 once the ramp has started, 1 if the previous ramp still
+		         runs (nothing changes, try again after the next block), -1
+		         if cverb_state_can_retune rejects the config.
+*/
+int cverb_state_retune(CVerbState *state, const CVerbConfig *config)
+{
+	if (state->ramp_length > 0)
+	{
+		return 1;
+	}
+	if (!cverb_state_can_retune(state, config))
+	{
+		return -1;
+	}
+
+	int comb_reach = resolve_delays(config->delay_ms, state->num_combs, state->sample_rate,
+	                                state->fade_taps, &state->fade_all_pass_delay);
+	state->fading = state->fade_all_pass_delay != state->all_pass_delay ||
+	                memcmp(state->fade_taps, state->comb_taps, state->num_combs * sizeof(int)) != 0;
+	state->ramp_max_span = span_limit(state, state->fade_all_pass_delay, comb_reach);
+
+	state->ramp_from.comb_ff = state->comb_ff;
+	state->ramp_from.comb_fb = state->comb_fb;
+	state->ramp_from.all_pass_ff = state->all_pass_ff;
+	state->ramp_from.all_pass_fb = state->all_pass_fb;
+	state->ramp_to.comb_ff = config->comb_ff;
+	state->ramp_to.comb_fb = config->comb_fb;
+	state->ramp_to.all_pass_ff = config->all_pass_ff;
+	state->ramp_to.all_pass_fb = config->all_pass_fb;
+	state->ramp_done = 0;
+	state->ramp_length = RAMP_FRAMES;
+
+	return 0;
+}
+
+/*
+		Copies one delay line, oldest sample first. Returns the amount of samples copied.
+*/
+static int export_line(const ProcessingBuffer *line, float *out)
+{
+	int split = line->length - line->head;
+
+	// The head is where the next sample goes, so it holds the oldest one
+	memcpy(out, line->buffer + line->head, split * sizeof(float));
+	memcpy(out + split, line->buffer, line->head * sizeof(float));
+
+	return line->length;
+}
+
+/*
+		Loads one delay line, oldest sample first. Returns the amount of samples loaded.
+*/
+static int import_line(ProcessingBuffer *line, const float *in)
+{
+	memcpy(line->buffer, in, line->length * sizeof(float));
+	line->head = 0;
+
+	return line->length;
+}
+
+/*
+		Returns the amount of floats cverb_state_export writes, which is the
+		combined length of every delay line.
+
+		state: Reverb state created by cverb_state_create.
+*/
+size_t cverb_state_length(const CVerbState *state)
+{
+	size_t length = state->comb_out.length;
+
+	for (int i = 0; i < state->num_all_pass; i++)
+	{
+		length += state->all_pass[i].length;
+	}
+	if (state->bank != NULL)
+	{
+		length += comb_bank_length(state->bank);
+	}
+
+	return length;
+}
+
+/*
+		Copies the contents of every delay line, oldest sample first, into one
+		flat array. The network is linear, so the array of the sum of two
+		signals is the sum of their arrays.
+
+		state: Reverb state created by cverb_state_create.
+		out: Room for cverb_state_length(state) floats.
+*/
+void cverb_state_export(const CVerbState *state, float *out)
+{
+	out += export_line(&state->comb_out, out);
+	for (int i = 0; i < state->num_all_pass; i++)
+	{
+		out += export_line(&state->all_pass[i], out);
+	}
+	if (state->bank != NULL)
+	{
+		comb_bank_export(state->bank, out);
+	}
+}
+
+/*
+		Loads delay line contents written by cverb_state_export into a state
+		created with the same config and sample rate, replacing its history.
+
+		state: Reverb state created by cverb_state_create.
+		in: cverb_state_length(state) floats.
+*/
+void cverb_state_import(CVerbState *state, const float *in)
+{
+	// The history is new, so none of it is known to be silent
+	memset(state->quiet, 0, sizeof(state->quiet));
+	in += import_line(&state->comb_out, in);
+	for (int i = 0; i < state->num_all_pass; i++)
+	{
+		in += import_line(&state->all_pass[i], in);
+	}
+	if (state->bank != NULL)
+	{
+		comb_bank_import(state->bank, in);
+	}
+}
+
+/*
+		Frees a reverb state and all of its delay lines.
+
+		state: Reverb state created by cverb_state_create.
+*/
+void cverb_state_free(CVerbState *state)
+{
+	if (state->bank != NULL)
+	{
+		comb_bank_free(state->bank);
+	}
+	free(state->arena);
+	free(state->all_pass);
+	free(state);
+}
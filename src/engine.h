@@ -0,0 +1,157 @@
+#ifndef ENGINE
+#define ENGINE
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "pbuff.h"
+#include "config.h"
+#include "combbank.h"
+
+/* The gains of the network, which live retuning ramps */
+typedef struct
+{
+	float comb_ff, comb_fb;
+	float all_pass_ff, all_pass_fb;
+} CVerbGains;
+
+/* Struct which holds the delay lines of one Schroeder reverb instance.
+
+	 The block engine runs the same network as process_data() in cverb.c
+	 but processes a whole block of samples through one stage before
+	 moving on to the next one. This is possible because every feedback
+	 path in the network is at least one delay long, so as long as a
+	 block is not longer than that no sample in the block depends on
+	 another sample of the same block.
+
+	 All delays and gains are resolved from a CVerbConfig when the state
+	 is created, so processing only loads, multiplies and adds. Each delay
+	 line is only as long as its furthest tap plus one span, rounded up to
+	 a power of two, and all of them live in one cache aligned arena.
+
+	 If the config asks for a comb bank, the bank's summed output is
+	 written to comb_out in place of the tapped comb's.
+
+	 cverb_state_retune moves a running state to the gains and delay of
+	 another config. Over the next RAMP_FRAMES frames the gains ramp in
+	 steps of RAMP_STEP_FRAMES, and if the delays change every stage is
+	 run through both the old and the new delays and crossfaded, since
+	 the lines already hold the history both of them read. The lines
+	 are sized for max_delay_ms when the state is created, so nothing is
+	 allocated after that.
+
+	 Each line also counts how many of its newest samples are below the
+	 silence level of the config. A stage whose input and every sample
+	 it reads from its lines are that quiet is skipped and writes exact
+	 silence, so pauses in the input cost next to nothing once the tail
+	 has died away. Processing flushes subnormals to zero.
+*/
+typedef struct
+{
+	float *arena;												// Single allocation holding every delay line
+	size_t arena_bytes;
+	ProcessingBuffer comb_out;					// Output of the parallel comb filters
+	ProcessingBuffer *all_pass;					// Output of each all pass filter
+	CombBank *bank;											// Independent combs, NULL for the comb taps
+	int num_combs;
+	int num_all_pass;
+	int comb_taps[MAX_COMB_TAPS];				// Delay of each comb feedback tap [samples]
+	int all_pass_delay;									// Delay of the all pass filters [samples]
+	int max_span;												// Longest span without intra-span feedback [samples]
+	float comb_ff, comb_fb;
+	float all_pass_ff, all_pass_fb;
+	unsigned int sample_rate;
+	int ramp_length;										// Frames of the running ramp, 0 if none runs
+	int ramp_done;											// Frames of the ramp processed so far
+	CVerbGains ramp_from, ramp_to;
+	int fading;													// Whether the delays change during the ramp
+	int fade_taps[MAX_COMB_TAPS];				// Comb taps the ramp fades to [samples]
+	int fade_all_pass_delay;						// All pass delay the ramp fades to [samples]
+	int ramp_max_span;									// max_span once the ramp is over [samples]
+	float *fade_from, *fade_to;					// One span of a stage through the old and the new delays
+	float silence;											// Level below which a stage is bypassed, negative never
+	int quiet[MAX_ALL_PASS + 1];				// Newest samples of comb_out, then of each all pass line, below silence
+	size_t bypassed;										// Spans of a stage skipped because they were silent
+} CVerbState;
+
+/*
+		Creates a reverb state for the given parameters and sample rate.
+		All delay lines start out silent.
+
+		config: Parameters of the reverb, which pass config_check.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CVerbState.
+*/
+CVerbState *cverb_state_create(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Runs a block of samples through the comb bank and the all pass chain.
+
+		state: Reverb state created by cverb_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void cverb_process_block(CVerbState *state, const float *in, float *out, size_t frames);
+
+/*
+		Checks whether cverb_state_retune would accept a config. Only reads
+		what is fixed when the state is created, so any thread may ask while
+		another one processes.
+
+		state: Reverb state created by cverb_state_create.
+		config: Parameters to retune to.
+
+		returns: 1 if the config only changes gains and delays, and its
+		         delays fit into the lines, 0 otherwise.
+*/
+int cverb_state_can_retune(const CVerbState *state, const CVerbConfig *config);
+
+/*
+		Starts moving the state to the gains and delay of config, which
+		takes the next RAMP_FRAMES processed frames. Never allocates.
+
+		state: Reverb state created by cverb_state_create.
+		config: Parameters to retune to.
+
+		returns: 0 once the ramp has started, 1 if the previous ramp still
+		         runs (nothing changes, try again after the next block), -1
+		         if cverb_state_can_retune rejects the config.
+*/
+int cverb_state_retune(CVerbState *state, const CVerbConfig *config);
+
+/*
+		Returns the amount of floats cverb_state_export writes, which is the
+		combined length of every delay line.
+
+		state: Reverb state created by cverb_state_create.
+*/
+size_t cverb_state_length(const CVerbState *state);
+
+/*
+		Copies the contents of every delay line, oldest sample first, into one
+		flat array. The network is linear, so the array of the sum of two
+		signals is the sum of their arrays.
+
+		state: Reverb state created by cverb_state_create.
+		out: Room for cverb_state_length(state) floats.
+*/
+void cverb_state_export(const CVerbState *state, float *out);
+
+/*
+		Loads delay line contents written by cverb_state_export into a state
+		created with the same config and sample rate, replacing its history.
+
+		state: Reverb state created by cverb_state_create.
+		in: cverb_state_length(state) floats.
+*/
+void cverb_state_import(CVerbState *state, const float *in);
+
+/*
+		Frees a reverb state and all of its delay lines.
+
+		state: Reverb state created by cverb_state_create.
+*/
+void cverb_state_free(CVerbState *state);
+#endif
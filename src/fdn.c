@@ -0,0 +1,157 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Feedback delay network, an alternative to the comb/all pass network
+	which reaches a dense tail with a handful of delay lines. The lines
+	are run a span at a time, like the stages of engine.c.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <math.h>
+
+/* Header files */
+#include "fdn.h"
+#include "kernels.h"
+#include "constants.h"
+#include "delayline.h"
+#include "instrument.h"
+
+/*
+		Creates a feedback delay network for the fdn_ settings of config and
+		the given sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new FdnState, or NULL if it could not be allocated.
+*/
+FdnState *fdn_state_create(const CVerbConfig *config, unsigned int sample_rate)
+{
+	FdnState *state = malloc(sizeof(FdnState));
+	int lines = config->fdn_lines;
+	float norm = 1.0f / sqrtf((float) lines);
+
+	state->num_lines = lines;
+	state->in_gain = norm;
+	state->dry = config->comb_ff;
+
+	// A span may not reach further than the shortest line
+	state->max_span = MAX_SPAN_FRAMES;
+
+	// Delays grow geometrically from the shortest to fdn_spread times that, each
+	// moved up to the next unused prime so that the lines never line up again
+	double shortest = config->fdn_delay_ms * sample_rate / 1000;
+	int previous = 1;
+	for (int i = 0; i < lines; i++)
+	{
+		int delay = (int) lround(shortest * pow(config->fdn_spread, (double) i / (lines - 1)));
+		if (delay <= previous)
+		{
+			delay = previous + 1;
+		}
+		while (!is_prime(delay))
+		{
+			delay++;
+		}
+		previous = delay;
+		if (delay < state->max_span)
+		{
+			state->max_span = delay;
+		}
+
+		// A line loses 60 dB every fdn_decay seconds, whatever its length
+		state->delays[i] = delay;
+		state->gains[i] = (float) pow(10, -3.0 * delay / (config->fdn_decay * sample_rate)) * norm;
+	}
+
+	// The mix rows follow the lines. Power of two lengths keep every line 64 byte aligned.
+	size_t floats = (size_t) lines * MAX_SPAN_FRAMES;
+	for (int i = 0; i < lines; i++)
+	{
+		floats += next_power_of_two(state->delays[i] + state->max_span, LINE_ALIGN_BYTES / sizeof(float));
+	}
+	state->arena_bytes = floats * sizeof(float);
+	if (posix_memalign((void **) &state->arena, 64, state->arena_bytes) != 0)
+	{
+		free(state);
+		return NULL;
+	}
+
+	float *storage = state->arena;
+	for (int i = 0; i < lines; i++)
+	{
+		int length = next_power_of_two(state->delays[i] + state->max_span, LINE_ALIGN_BYTES / sizeof(float));
+		pbuff_init_storage(&state->lines[i], storage, length);
+		storage += length;
+	}
+	for (int i = 0; i < lines; i++)
+	{
+		state->mixed[i] = storage;
+		storage += MAX_SPAN_FRAMES;
+	}
+
+	return state;
+}
+
+/*
+		Runs a block of samples through the network.
+
+		state: Network created by fdn_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fdn_process_block(FdnState *state, const float *in, float *out, size_t frames)
+{
+	unsigned int mode = kernel_flush_denormals();
+	int lines = state->num_lines;
+	size_t done = 0;
+
+	while (done < frames)
+	{
+		int span = (frames - done < (size_t) state->max_span) ? (int) (frames - done) : state->max_span;
+
+		// Every line is read one delay back and written at its head, neither may wrap
+		const float *delayed[MAX_FDN_LINES];
+		for (int i = 0; i < lines; i++)
+		{
+			ProcessingBuffer *line = &state->lines[i];
+			int index = pbuff_delayed_index(line, state->delays[i]);
+			span = clamp_span(span, index, line->length);
+			span = clamp_span(span, line->head, line->length);
+			delayed[i] = line->buffer + index;
+		}
+
+		PROBE_START(fdn_timer);
+		kernel_hadamard(state->mixed, delayed, state->gains, lines, span);
+
+		// The first row of the matrix is all ones, so its row of the mix is the sum of every line
+		const float *sum = state->mixed[0];
+		kernel_comb(out + done, in + done, &sum, 1, state->dry, 1.0f, span);
+
+		for (int i = 0; i < lines; i++)
+		{
+			ProcessingBuffer *line = &state->lines[i];
+			const float *feedback = state->mixed[i];
+			kernel_comb(line->buffer + line->head, in + done, &feedback, 1, state->in_gain, 1.0f, span);
+			pbuff_advance_head(line, span);
+		}
+		PROBE_STOP(fdn_timer, PROBE_FDN, span);
+
+		done += span;
+	}
+
+	kernel_restore_denormals(mode);
+}
+
+/*
+		Frees a feedback delay network and all of its delay lines.
+
+		state: Network created by fdn_state_create.
+*/
+void fdn_state_free(FdnState *state)
+{
+	free(state->arena);
+	free(state);
+}
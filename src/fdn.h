@@ -0,0 +1,64 @@
+#ifndef FDN
+#define FDN
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "pbuff.h"
+#include "config.h"
+
+/* Struct which holds the delay lines of one feedback delay network.
+
+	 Every line feeds all lines, including itself, through a Hadamard
+	 matrix scaled by 1/sqrt(lines). That matrix is orthogonal, so the
+	 mix neither adds nor removes energy and the decay is set by the
+	 gain of each line alone. Since every echo is spread over all lines
+	 at once, the echo density grows with every trip around the network
+	 instead of one echo per line, without any all pass filters.
+
+	 Like the block engine, no line is shorter than a span, so a whole
+	 span is read from all lines, mixed with kernel_hadamard and written
+	 back before the next span starts.
+*/
+typedef struct
+{
+	float *arena;												// Single allocation holding every line and the mix
+	size_t arena_bytes;
+	ProcessingBuffer lines[MAX_FDN_LINES];
+	float *mixed[MAX_FDN_LINES];				// One span of each line's row of the mix
+	int num_lines;
+	int delays[MAX_FDN_LINES];					// Delay of each line [samples]
+	float gains[MAX_FDN_LINES];					// Decay of each line, times the normalization of the matrix
+	int max_span;												// Longest span without intra-span feedback [samples]
+	float in_gain;											// Gain of the input into every line
+	float dry;													// Gain of the input into the output
+} FdnState;
+
+/*
+		Creates a feedback delay network for the fdn_ settings of config and
+		the given sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new FdnState, or NULL if it could not be allocated.
+*/
+FdnState *fdn_state_create(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Runs a block of samples through the network.
+
+		state: Network created by fdn_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fdn_process_block(FdnState *state, const float *in, float *out, size_t frames);
+
+/*
+		Frees a feedback delay network and all of its delay lines.
+
+		state: Network created by fdn_state_create.
+*/
+void fdn_state_free(FdnState *state);
+#endif
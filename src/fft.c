@@ -0,0 +1,205 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Radix-2 FFT of real signals for the convolution engine. The signal
+	is packed into a complex array of half its length (even samples as
+	real parts, odd samples as imaginary parts), transformed with an
+	iterative in-place FFT and then split into the spectrum of the real
+	signal. This does half the work of transforming it as complex data.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <math.h>
+
+/* Header files */
+#include "fft.h"
+
+/*
+		Creates the tables for transforms of the given size.
+
+		size: Amount of real samples, a power of two of at least 4.
+
+		returns: Pointer to the new FftPlan, or NULL if size is not supported.
+*/
+FftPlan *fft_plan_create(int size)
+{
+	if (size < 4 || (size & (size - 1)) != 0)
+	{
+		return NULL;
+	}
+
+	FftPlan *plan = malloc(sizeof(FftPlan));
+	plan->size = size;
+	plan->half = size / 2;
+	plan->reverse = malloc(plan->half * sizeof(int));
+	plan->twiddle_re = malloc(plan->half / 2 * sizeof(float));
+	plan->twiddle_im = malloc(plan->half / 2 * sizeof(float));
+	plan->post_re = malloc((plan->half + 1) * sizeof(float));
+	plan->post_im = malloc((plan->half + 1) * sizeof(float));
+	plan->work = malloc(2 * plan->half * sizeof(float));
+
+	int bits = 0;
+	while ((1 << bits) < plan->half)
+	{
+		bits++;
+	}
+	for (int i = 0; i < plan->half; i++)
+	{
+		int reversed = 0;
+		for (int b = 0; b < bits; b++)
+		{
+			reversed |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		plan->reverse[i] = reversed;
+	}
+
+	// Twiddles are computed in double precision so they are exact to the last float bit
+	for (int k = 0; k < plan->half / 2; k++)
+	{
+		double angle = -2 * M_PI * k / plan->half;
+		plan->twiddle_re[k] = (float) cos(angle);
+		plan->twiddle_im[k] = (float) sin(angle);
+	}
+	for (int k = 0; k <= plan->half; k++)
+	{
+		double angle = -2 * M_PI * k / size;
+		plan->post_re[k] = (float) cos(angle);
+		plan->post_im[k] = (float) sin(angle);
+	}
+
+	return plan;
+}
+
+/*
+		In-place complex FFT of the plan's work array, which must already be
+		in bit reversed order. inverse selects the conjugate twiddles.
+*/
+static void transform(FftPlan *plan, int inverse)
+{
+	float *work = plan->work;
+	float sign = inverse ? -1.0f : 1.0f;
+
+	for (int length = 2; length <= plan->half; length *= 2)
+	{
+		int step = plan->half / length;
+		int middle = length / 2;
+
+		for (int start = 0; start < plan->half; start += length)
+		{
+			for (int j = 0; j < middle; j++)
+			{
+				float w_re = plan->twiddle_re[j * step];
+				float w_im = sign * plan->twiddle_im[j * step];
+				float *a = work + 2 * (start + j);
+				float *b = work + 2 * (start + j + middle);
+
+				float v_re = b[0] * w_re - b[1] * w_im;
+				float v_im = b[0] * w_im + b[1] * w_re;
+				b[0] = a[0] - v_re;
+				b[1] = a[1] - v_im;
+				a[0] += v_re;
+				a[1] += v_im;
+			}
+		}
+	}
+}
+
+/*
+		Transforms size real samples into size / 2 + 1 frequency bins.
+
+		plan: Plan created by fft_plan_create.
+		in: size real samples.
+		re: Real parts of the bins.
+		im: Imaginary parts of the bins.
+*/
+void fft_real_forward(FftPlan *plan, const float *in, float *re, float *im)
+{
+	int half = plan->half;
+	float *work = plan->work;
+
+	for (int i = 0; i < half; i++)
+	{
+		int j = plan->reverse[i];
+		work[2 * j] = in[2 * i];
+		work[2 * j + 1] = in[2 * i + 1];
+	}
+
+	transform(plan, 0);
+
+	// Split the spectrum of the packed signal into the spectra of the even
+	// and odd samples (e and o), then combine them: X[k] = E[k] + W^k O[k]
+	for (int k = 0; k <= half; k++)
+	{
+		int a = k % half;
+		int b = (half - k) % half;
+		float z_re = work[2 * a], z_im = work[2 * a + 1];
+		float c_re = work[2 * b], c_im = -work[2 * b + 1];
+
+		float e_re = 0.5f * (z_re + c_re);
+		float e_im = 0.5f * (z_im + c_im);
+		float o_re = 0.5f * (z_im - c_im);
+		float o_im = -0.5f * (z_re - c_re);
+
+		re[k] = e_re + plan->post_re[k] * o_re - plan->post_im[k] * o_im;
+		im[k] = e_im + plan->post_re[k] * o_im + plan->post_im[k] * o_re;
+	}
+}
+
+/*
+		Transforms size / 2 + 1 frequency bins back into size real samples.
+		The result is not normalized, it is size times the original signal.
+
+		plan: Plan created by fft_plan_create.
+		re: Real parts of the bins.
+		im: Imaginary parts of the bins.
+		out: size real samples.
+*/
+void fft_real_inverse(FftPlan *plan, const float *re, const float *im, float *out)
+{
+	int half = plan->half;
+	float *work = plan->work;
+
+	// Undo the split: E[k] + i O[k] is the spectrum of the packed signal
+	for (int k = 0; k < half; k++)
+	{
+		float c_re = re[half - k], c_im = -im[half - k];
+
+		float e_re = re[k] + c_re;
+		float e_im = im[k] + c_im;
+		float d_re = re[k] - c_re;
+		float d_im = im[k] - c_im;
+
+		// O[k] = (X[k] - conj(X[half - k])) / W^k
+		float o_re = d_re * plan->post_re[k] + d_im * plan->post_im[k];
+		float o_im = d_im * plan->post_re[k] - d_re * plan->post_im[k];
+
+		int j = plan->reverse[k];
+		work[2 * j] = e_re - o_im;
+		work[2 * j + 1] = e_im + o_re;
+	}
+
+	transform(plan, 1);
+
+	for (int i = 0; i < half; i++)
+	{
+		out[2 * i] = work[2 * i];
+		out[2 * i + 1] = work[2 * i + 1];
+	}
+}
+
+/*
+		Frees a plan and its tables.
+
+		plan: Plan created by fft_plan_create.
+*/
+void fft_plan_free(FftPlan *plan)
+{
+	free(plan->reverse);
+	free(plan->twiddle_re);
+	free(plan->twiddle_im);
+	free(plan->post_re);
+	free(plan->post_im);
+	free(plan->work);
+	free(plan);
+}
@@ -0,0 +1,60 @@
+#ifndef FFT
+#define FFT
+
+/* Struct which holds the tables of a real FFT of one size.
+
+	 A real signal of size samples is transformed with a complex FFT of
+	 half the size, so every plan only stores size / 2 complex points of
+	 scratch space. Spectra are kept in split form (one array of real
+	 parts and one of imaginary parts) with size / 2 + 1 bins, which is
+	 everything a real signal's spectrum holds.
+*/
+typedef struct
+{
+	int size;					// Amount of real samples transformed
+	int half;					// Size of the complex FFT, size / 2
+	int *reverse;			// Bit reversed index of every complex point
+	float *twiddle_re;	// exp(-2 pi i k / half) for k < half / 2
+	float *twiddle_im;
+	float *post_re;		// exp(-2 pi i k / size) for k <= half
+	float *post_im;
+	float *work;				// Interleaved complex scratch, half points
+} FftPlan;
+
+/*
+		Creates the tables for transforms of the given size.
+
+		size: Amount of real samples, a power of two of at least 4.
+
+		returns: Pointer to the new FftPlan, or NULL if size is not supported.
+*/
+FftPlan *fft_plan_create(int size);
+
+/*
+		Transforms size real samples into size / 2 + 1 frequency bins.
+
+		plan: Plan created by fft_plan_create.
+		in: size real samples.
+		re: Real parts of the bins.
+		im: Imaginary parts of the bins.
+*/
+void fft_real_forward(FftPlan *plan, const float *in, float *re, float *im);
+
+/*
+		Transforms size / 2 + 1 frequency bins back into size real samples.
+		The result is not normalized, it is size times the original signal.
+
+		plan: Plan created by fft_plan_create.
+		re: Real parts of the bins.
+		im: Imaginary parts of the bins.
+		out: size real samples.
+*/
+void fft_real_inverse(FftPlan *plan, const float *re, const float *im, float *out);
+
+/*
+		Frees a plan and its tables.
+
+		plan: Plan created by fft_plan_create.
+*/
+void fft_plan_free(FftPlan *plan);
+#endif
@@ -0,0 +1,236 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Fixed point implementation of the block engine, for targets like
+	the Feather M4 where every float operation costs a library call,
+	and for servers where the delay lines of many instances have to
+	share a cache. Every stage is run over a span of samples before
+	the next stage starts, exactly like engine.c.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/* Header files */
+#include "fixed.h"
+#include "convert.h"
+#include "constants.h"
+#include "delayline.h"
+
+/*
+		Converts a gain to Q16. Returns -1 if it does not fit.
+*/
+static int to_q16(float gain, int32_t *q16)
+{
+	double scaled = round((double) gain * 65536);
+
+	if (!(scaled >= INT32_MIN && scaled <= INT32_MAX))
+	{
+		return -1;
+	}
+
+	*q16 = (int32_t) scaled;
+	return 0;
+}
+
+/*
+		Rounds a sum of Q31 products to Q15 and saturates it to 16 bits.
+*/
+static int16_t saturate_q15(int64_t sum)
+{
+	sum = (sum + (1 << 15)) >> 16;
+
+	if (sum > INT16_MAX)
+	{
+		return INT16_MAX;
+	}
+	if (sum < INT16_MIN)
+	{
+		return INT16_MIN;
+	}
+	return (int16_t) sum;
+}
+
+/*
+		Creates a fixed point reverb state for the given parameters and
+		sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb, which pass config_check.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new FixedState, or NULL (after printing why)
+		         if a gain does not fit in Q16 or the config asks for a
+		         comb bank.
+*/
+FixedState *fixed_state_create(const CVerbConfig *config, unsigned int sample_rate)
+{
+	if (config->bank_combs > 0)
+	{
+		fprintf(stderr, "fixed point engine: the comb bank is not supported\n");
+		return NULL;
+	}
+
+	FixedState *state = malloc(sizeof(FixedState));
+
+	if (to_q16(config->comb_ff, &state->comb_ff) != 0 || to_q16(config->comb_fb, &state->comb_fb) != 0 ||
+	    to_q16(config->all_pass_ff, &state->all_pass_ff) != 0 || to_q16(config->all_pass_fb, &state->all_pass_fb) != 0)
+	{
+		fprintf(stderr, "fixed point engine: gains must lie within +-32768\n");
+		free(state);
+		return NULL;
+	}
+
+	state->num_combs = config->num_combs;
+	state->num_all_pass = config->num_all_pass;
+	state->position = 0;
+
+	// The same delays as the block engine
+	for (int i = 0; i < state->num_combs; i++)
+	{
+		state->comb_taps[i] = (int) ((i+1) * config->delay_ms * sample_rate / 1000);
+	}
+	state->all_pass_delay = (int) (config->delay_ms * sample_rate / 1000);
+
+	state->max_span = state->all_pass_delay < MAX_SPAN_FRAMES ? state->all_pass_delay : MAX_SPAN_FRAMES;
+
+	int comb_reach = state->all_pass_delay;
+	if (state->num_combs > 0 && state->comb_taps[state->num_combs - 1] > comb_reach)
+	{
+		comb_reach = state->comb_taps[state->num_combs - 1];
+	}
+	uint32_t comb_length = next_power_of_two(comb_reach + state->max_span, LINE_ALIGN_BYTES / sizeof(int16_t));
+	uint32_t all_pass_length = next_power_of_two(state->all_pass_delay + state->max_span, LINE_ALIGN_BYTES / sizeof(int16_t));
+
+	// Power of two lengths of at least 32 samples keep every line 64 byte aligned
+	size_t samples = comb_length + (size_t) state->num_all_pass * all_pass_length;
+	state->arena_bytes = samples * sizeof(int16_t);
+	if (posix_memalign((void **) &state->arena, 64, state->arena_bytes) != 0)
+	{
+		free(state);
+		return NULL;
+	}
+	for (size_t i = 0; i < samples; i++)
+	{
+		state->arena[i] = 0;
+	}
+
+	state->comb_out.buffer = state->arena;
+	state->comb_out.mask = comb_length - 1;
+	state->all_pass = malloc((state->num_all_pass > 0 ? state->num_all_pass : 1) * sizeof(FixedLine));
+	for (int i = 0; i < state->num_all_pass; i++)
+	{
+		state->all_pass[i].buffer = state->arena + comb_length + (size_t) i * all_pass_length;
+		state->all_pass[i].mask = all_pass_length - 1;
+	}
+
+	return state;
+}
+
+/*
+		Runs a block of 16-bit samples through the comb bank and the all
+		pass chain. The output saturates instead of wrapping around.
+
+		state: Reverb state created by fixed_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fixed_process_block(FixedState *state, const int16_t *in, int16_t *out, size_t frames)
+{
+	const int delay = state->all_pass_delay;
+	size_t done = 0;
+
+	while (done < frames)
+	{
+		int span = (frames - done < (size_t) state->max_span) ? (int) (frames - done) : state->max_span;
+		uint32_t position = state->position;
+		FixedLine *comb = &state->comb_out;
+
+		// Parallel comb filters
+		for (int j = 0; j < span; j++)
+		{
+			uint32_t now = position + j;
+			int64_t sum = (int64_t) state->comb_ff * in[done + j];
+
+			for (int i = 0; i < state->num_combs; i++)
+			{
+				sum += (int64_t) state->comb_fb * comb->buffer[(now - state->comb_taps[i]) & comb->mask];
+			}
+
+			comb->buffer[now & comb->mask] = saturate_q15(sum);
+		}
+
+		// All pass filters in series, each one reads the previous stage's output
+		const FixedLine *stage_in = comb;
+		for (int i = 0; i < state->num_all_pass; i++)
+		{
+			FixedLine *stage_out = &state->all_pass[i];
+
+			for (int j = 0; j < span; j++)
+			{
+				uint32_t now = position + j;
+				int64_t sum = -(int64_t) state->all_pass_ff * stage_in->buffer[now & stage_in->mask];
+				sum += (int64_t) stage_in->buffer[(now - delay) & stage_in->mask] * 65536;
+				sum += (int64_t) state->all_pass_fb * stage_out->buffer[(now - delay) & stage_out->mask];
+				stage_out->buffer[now & stage_out->mask] = saturate_q15(sum);
+			}
+
+			stage_in = stage_out;
+		}
+
+		// The output taps the comb bank and the space after every all pass filter
+		for (int j = 0; j < span; j++)
+		{
+			uint32_t now = position + j;
+			int64_t sum = (int64_t) comb->buffer[now & comb->mask];
+
+			for (int i = 0; i < state->num_all_pass; i++)
+			{
+				sum += state->all_pass[i].buffer[now & state->all_pass[i].mask];
+			}
+
+			out[done + j] = saturate_q15(sum * 65536);
+		}
+
+		state->position += span;
+		done += span;
+	}
+}
+
+/*
+		Runs a block of float samples on the scale of 16-bit samples through
+		the reverb, converting them to and from 16 bits on the way.
+
+		state: Reverb state created by fixed_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fixed_process_float(FixedState *state, const float *in, float *out, size_t frames)
+{
+	int16_t in_q15[MAX_SPAN_FRAMES];
+	int16_t out_q15[MAX_SPAN_FRAMES];
+
+	for (size_t done = 0; done < frames; done += MAX_SPAN_FRAMES)
+	{
+		size_t count = frames - done < MAX_SPAN_FRAMES ? frames - done : MAX_SPAN_FRAMES;
+
+		convert_from_float(in_q15, in + done, SAMPLE_S16, count);
+		fixed_process_block(state, in_q15, out_q15, count);
+		convert_to_float(out + done, out_q15, SAMPLE_S16, count);
+	}
+}
+
+/*
+		Frees a fixed point reverb state and all of its delay lines.
+
+		state: Reverb state created by fixed_state_create.
+*/
+void fixed_state_free(FixedState *state)
+{
+	free(state->arena);
+	free(state->all_pass);
+	free(state);
+}
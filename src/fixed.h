@@ -0,0 +1,85 @@
+#ifndef FIXED
+#define FIXED
+/* Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Header files */
+#include "config.h"
+
+/* Struct which holds one delay line of the fixed point engine */
+typedef struct
+{
+	int16_t *buffer;
+	uint32_t mask;											// Length - 1, the length is a power of two
+} FixedLine;
+
+/* Struct which holds the delay lines of one fixed point Schroeder reverb.
+
+	 Runs the same network as the block engine without any floating
+	 point, for processors without an FPU. Samples are stored as Q15
+	 (the 16-bit samples themselves), which takes half the memory of
+	 the float delay lines. Gains are Q16, so a gain of 1 (the default
+	 feedforward gain of the comb bank) fits. A product of a sample and
+	 a gain is Q31, and the products of a stage are summed in 64 bits,
+	 so a stage can not overflow before its result is rounded and
+	 saturated back to Q15 once.
+*/
+typedef struct
+{
+	int16_t *arena;											// Single allocation holding every delay line
+	size_t arena_bytes;
+	FixedLine comb_out;									// Output of the parallel comb filters
+	FixedLine *all_pass;								// Output of each all pass filter
+	uint32_t position;									// Index of the next sample, masked by every line
+	int num_combs;
+	int num_all_pass;
+	int comb_taps[MAX_COMB_TAPS];				// Delay of each comb feedback tap [samples]
+	int all_pass_delay;									// Delay of the all pass filters [samples]
+	int max_span;												// Longest span without intra-span feedback [samples]
+	int32_t comb_ff, comb_fb;						// Q16 gains
+	int32_t all_pass_ff, all_pass_fb;
+} FixedState;
+
+/*
+		Creates a fixed point reverb state for the given parameters and
+		sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb, which pass config_check.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new FixedState, or NULL (after printing why)
+		         if a gain does not fit in Q16 or the config asks for a
+		         comb bank.
+*/
+FixedState *fixed_state_create(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Runs a block of 16-bit samples through the comb bank and the all
+		pass chain. The output saturates instead of wrapping around.
+
+		state: Reverb state created by fixed_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fixed_process_block(FixedState *state, const int16_t *in, int16_t *out, size_t frames);
+
+/*
+		Runs a block of float samples on the scale of 16-bit samples through
+		the reverb, converting them to and from 16 bits on the way.
+
+		state: Reverb state created by fixed_state_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void fixed_process_float(FixedState *state, const float *in, float *out, size_t frames);
+
+/*
+		Frees a fixed point reverb state and all of its delay lines.
+
+		state: Reverb state created by fixed_state_create.
+*/
+void fixed_state_free(FixedState *state);
+#endif
@@ -0,0 +1,173 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Counters behind the probes in instrument.h. Only compiled into the
+	instrumentation build. Counters are shared by every thread and
+	updated with relaxed atomic adds, which keeps them exact without
+	any locking on the hot path.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+/* Header files */
+#include "instrument.h"
+
+#define NUM_BUCKETS 64 // Bucket b counts events of [2^b, 2^(b+1)) cycles
+
+/* Counters of one stage */
+typedef struct
+{
+	atomic_ullong events;
+	atomic_ullong samples;
+	atomic_ullong cycles;
+	atomic_ullong buckets[NUM_BUCKETS];
+} ProbeStats;
+
+static ProbeStats probes[NUM_PROBES];
+static volatile sig_atomic_t dump_requested = 0;
+
+/*
+		Returns the name a stage is printed with.
+*/
+static void probe_name(int probe, char *name, size_t size)
+{
+	if (probe >= PROBE_ALL_PASS && probe < PROBE_MIX)
+	{
+		snprintf(name, size, "all_pass_%d", probe - PROBE_ALL_PASS + 1);
+		return;
+	}
+
+	switch (probe)
+	{
+		case PROBE_READ: snprintf(name, size, "read"); break;
+		case PROBE_COMB: snprintf(name, size, "comb"); break;
+		case PROBE_MIX: snprintf(name, size, "mix"); break;
+		case PROBE_CONV: snprintf(name, size, "conv"); break;
+		case PROBE_FDN: snprintf(name, size, "fdn"); break;
+		case PROBE_WRITE: snprintf(name, size, "write"); break;
+		default: snprintf(name, size, "probe_%d", probe); break;
+	}
+}
+
+/*
+		Adds one timed event to the histogram of a stage. Safe to call from
+		several threads at once.
+
+		probe: Stage that was timed.
+		cycles: Cycles the event took.
+		samples: Samples the event processed.
+*/
+void instrument_record(int probe, uint64_t cycles, size_t samples)
+{
+	ProbeStats *stats = &probes[probe];
+	int bucket = 0;
+
+	while (bucket < NUM_BUCKETS - 1 && (cycles >> (bucket + 1)) != 0)
+	{
+		bucket++;
+	}
+
+	atomic_fetch_add_explicit(&stats->events, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->samples, samples, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->cycles, cycles, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats->buckets[bucket], 1, memory_order_relaxed);
+}
+
+/*
+		Prints every stage that recorded an event.
+
+		out: Stream to print to.
+*/
+void instrument_dump(FILE *out)
+{
+	unsigned long long io = 0, dsp = 0;
+	char name[32];
+
+	fprintf(out, "%-12s %12s %14s %14s %14s\n", "stage", "events", "samples", "cycles/sample", "cycles/event");
+	for (int p = 0; p < NUM_PROBES; p++)
+	{
+		unsigned long long events = atomic_load(&probes[p].events);
+		unsigned long long samples = atomic_load(&probes[p].samples);
+		unsigned long long cycles = atomic_load(&probes[p].cycles);
+
+		if (events == 0)
+		{
+			continue;
+		}
+
+		probe_name(p, name, sizeof(name));
+		fprintf(out, "%-12s %12llu %14llu %14.2f %14.1f\n", name, events, samples,
+		        samples > 0 ? (double) cycles / samples : 0.0, (double) cycles / events);
+
+		for (int b = 0; b < NUM_BUCKETS; b++)
+		{
+			unsigned long long count = atomic_load(&probes[p].buckets[b]);
+
+			if (count > 0)
+			{
+				char range[32];
+
+				snprintf(range, sizeof(range), "[2^%d, 2^%d)", b, b + 1);
+				fprintf(out, "    %-14s %12llu\n", range, count);
+			}
+		}
+
+		if (p == PROBE_READ || p == PROBE_WRITE)
+		{
+			io += cycles;
+		}
+		else
+		{
+			dsp += cycles;
+		}
+	}
+
+	if (io + dsp > 0)
+	{
+		fprintf(out, "I/O %.1f%%, DSP %.1f%% of the timed cycles\n", 100.0 * io / (io + dsp), 100.0 * dsp / (io + dsp));
+	}
+	fflush(out);
+}
+
+static void dump_at_exit(void)
+{
+	instrument_dump(stderr);
+}
+
+static void request_dump(int signal)
+{
+	(void) signal;
+	dump_requested = 1;
+}
+
+/*
+		Registers the dump at exit and the SIGUSR1 handler.
+*/
+void instrument_init(void)
+{
+	struct sigaction action;
+
+	action.sa_handler = request_dump;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &action, NULL);
+
+	atexit(dump_at_exit);
+}
+
+/*
+		Prints the histograms if SIGUSR1 arrived since the last call. The
+		signal handler only sets a flag, printing happens here, outside of it.
+*/
+void instrument_poll(void)
+{
+	if (dump_requested)
+	{
+		dump_requested = 0;
+		instrument_dump(stderr);
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef INSTRUMENT
+#define INSTRUMENT
+/*
+		Opt-in hot path instrumentation. Built with -DCVERB_INSTRUMENT
+		(make instrument) every probe adds the cycles spent in a stage to a
+		log2 histogram, which is printed to stderr at exit and whenever the
+		process receives SIGUSR1. In every other build the macros below
+		expand to nothing, so the probes cost nothing.
+
+		PROBE_START(timer);
+		... stage ...
+		PROBE_STOP(timer, PROBE_COMB, samples);
+*/
+#ifdef CVERB_INSTRUMENT
+/* Libraries */
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Header files */
+#include "config.h"
+
+/* Stages that can be timed */
+enum
+{
+	PROBE_READ,																// Reading input samples
+	PROBE_COMB,																// Comb bank
+	PROBE_ALL_PASS,														// First all pass filter, the others follow
+	PROBE_MIX = PROBE_ALL_PASS + MAX_ALL_PASS,	// Summing the network's outputs
+	PROBE_CONV,																// One block of the convolution engine
+	PROBE_FDN,																// One span of the feedback delay network
+	PROBE_WRITE,															// Writing output samples
+	NUM_PROBES
+};
+
+/*
+		Returns a timestamp in cycles (or nanoseconds where there is no cycle counter).
+*/
+static inline uint64_t instrument_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/*
+		Adds one timed event to the histogram of a stage. Safe to call from
+		several threads at once.
+
+		probe: Stage that was timed.
+		cycles: Cycles the event took.
+		samples: Samples the event processed.
+*/
+void instrument_record(int probe, uint64_t cycles, size_t samples);
+
+/*
+		Registers the dump at exit and the SIGUSR1 handler.
+*/
+void instrument_init(void);
+
+/*
+		Prints the histograms if SIGUSR1 arrived since the last call. The
+		signal handler only sets a flag, printing happens here, outside of it.
+*/
+void instrument_poll(void);
+
+/*
+		Prints every stage that recorded an event.
+
+		out: Stream to print to.
+*/
+void instrument_dump(FILE *out);
+
+#define PROBE_START(timer) uint64_t timer = instrument_now()
+#define PROBE_STOP(timer, probe, samples) instrument_record((probe), instrument_now() - (timer), (samples))
+#define INSTRUMENT_INIT() instrument_init()
+#define INSTRUMENT_POLL() instrument_poll()
+#else
+#define PROBE_START(timer)
+#define PROBE_STOP(timer, probe, samples)
+#define INSTRUMENT_INIT()
+#define INSTRUMENT_POLL()
+#endif
+#endif
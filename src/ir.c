@@ -0,0 +1,213 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Impulse responses for the convolution engine, either read from a
+	.wav file (a measured room) or rendered once from the comb/all pass
+	network so both engines can be compared on the same sound.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Header files */
+#include "ir.h"
+#include "wav.h"
+#include "wavio.h"
+#include "convert.h"
+#include "engine.h"
+#include "constants.h"
+
+/*
+		Allocates an impulse response of the given shape. Returns NULL if
+		the memory could not be allocated.
+*/
+static ImpulseResponse *ir_alloc(int channels, size_t length, unsigned int sample_rate)
+{
+	ImpulseResponse *ir = malloc(sizeof(ImpulseResponse));
+	if (ir == NULL)
+	{
+		return NULL;
+	}
+	ir->channels = channels;
+	ir->length = length;
+	ir->sample_rate = sample_rate;
+	ir->samples = calloc(channels, sizeof(float *));
+	int allocated = ir->samples != NULL;
+	for (int c = 0; allocated && c < channels; c++)
+	{
+		ir->samples[c] = malloc((length > 0 ? length : 1) * sizeof(float));
+		allocated = ir->samples[c] != NULL;
+	}
+	if (!allocated)
+	{
+		ir->channels = ir->samples != NULL ? channels : 0;
+		ir_free(ir);
+		return NULL;
+	}
+
+	return ir;
+}
+
+/*
+		Reads an impulse response from a .wav file in any of the sample formats
+		of wav.h.
+
+		path: Path of the .wav file.
+
+		returns: Pointer to the new ImpulseResponse, or NULL (after printing
+		         why) if the file could not be read.
+*/
+ImpulseResponse *ir_load(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		perror(path);
+		return NULL;
+	}
+
+	WaveHeader header;
+	SampleFormat format;
+	parse_wav(file, NULL, &header);
+	// parse_wav only gets as far as a data chunk in a RIFF, RF64 or Wave64 file
+	if (memcmp(header.data_chunk_header, "data", 4) != 0 || header.channels == 0 ||
+	    wav_sample_format(&header, &format) != 0)
+	{
+		fprintf(stderr, "%s: not a .wav file in a supported sample format\n", path);
+		fclose(file);
+		return NULL;
+	}
+
+	int channels = header.channels;
+	size_t length = wav_sample_count(file, &header) / channels;
+	ImpulseResponse *ir = ir_alloc(channels, length, header.sample_rate);
+	if (ir == NULL)
+	{
+		fprintf(stderr, "%s: out of memory for the impulse response\n", path);
+		fclose(file);
+		return NULL;
+	}
+
+	WavReader *reader = wav_reader_open(file, &header);
+	float *converted = malloc(BLOCK_FRAMES * sizeof(float));
+	const void *samples;
+	size_t count;
+	size_t frame = 0;
+	int channel = 0;
+
+	while (frame < length)
+	{
+		size_t wanted = (length - frame) * channels;
+		if ((count = wav_reader_read(reader, &samples, wanted < BLOCK_FRAMES ? wanted : BLOCK_FRAMES)) == 0)
+		{
+			break;
+		}
+
+		convert_to_float(converted, samples, format, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			ir->samples[channel][frame] = converted[i] / 32768.0f;
+			if (++channel == channels)
+			{
+				channel = 0;
+				frame++;
+			}
+		}
+	}
+	ir->length = frame;
+
+	free(converted);
+	wav_reader_close(reader);
+	fclose(file);
+
+	return ir;
+}
+
+/*
+		Renders the impulse response of the comb/all pass network by running
+		a single full scale sample through the block engine until the output
+		has decayed below IR_SILENCE, or IR_MAX_SECONDS have passed.
+
+		config: Parameters of the reverb.
+		sample_rate: Sample rate the impulse response is rendered at [Hz].
+
+		returns: Pointer to the new single channel ImpulseResponse, or NULL
+		         if it could not be allocated.
+*/
+ImpulseResponse *ir_render(const CVerbConfig *config, unsigned int sample_rate)
+{
+	size_t max_length = (size_t) IR_MAX_SECONDS * sample_rate;
+	ImpulseResponse *ir = ir_alloc(1, max_length, sample_rate);
+	float *in = calloc(CONV_BLOCK_FRAMES, sizeof(float));
+
+	// The response is rendered at full scale 1 and convolved with 16-bit
+	// samples, so the silence bypass would cut it off far too early
+	CVerbConfig exact = *config;
+	exact.silence = -1;
+	CVerbState *state = ir != NULL && in != NULL ? cverb_state_create(&exact, sample_rate) : NULL;
+	if (state == NULL)
+	{
+		if (ir != NULL)
+		{
+			ir_free(ir);
+		}
+		free(in);
+		return NULL;
+	}
+	float *out = ir->samples[0];
+
+	// The network can be silent for up to its longest delay before a tap
+	// brings the sound back, so only stop after that much silence
+	size_t reach = state->all_pass_delay;
+	if (state->num_combs > 0 && (size_t) state->comb_taps[state->num_combs - 1] > reach)
+	{
+		reach = state->comb_taps[state->num_combs - 1];
+	}
+
+	size_t length = 0;
+	size_t loud = 0;	// One past the last sample above IR_SILENCE
+	in[0] = 1.0f;
+	while (length < max_length && length - loud <= reach)
+	{
+		size_t span = max_length - length < CONV_BLOCK_FRAMES ? max_length - length : CONV_BLOCK_FRAMES;
+
+		cverb_process_block(state, in, out + length, span);
+		in[0] = 0.0f;
+
+		for (size_t i = length; i < length + span; i++)
+		{
+			if (out[i] > IR_SILENCE || out[i] < -IR_SILENCE)
+			{
+				loud = i + 1;
+			}
+		}
+		length += span;
+	}
+
+	ir->length = loud;
+	// Shrinking can not fail in practice, but if it does the longer buffer still holds the response
+	float *trimmed = realloc(out, (loud > 0 ? loud : 1) * sizeof(float));
+	ir->samples[0] = trimmed != NULL ? trimmed : out;
+
+	cverb_state_free(state);
+	free(in);
+
+	return ir;
+}
+
+/*
+		Frees an impulse response.
+
+		ir: Impulse response created by ir_load or ir_render.
+*/
+void ir_free(ImpulseResponse *ir)
+{
+	for (int c = 0; c < ir->channels; c++)
+	{
+		free(ir->samples[c]);
+	}
+	free(ir->samples);
+	free(ir);
+}
@@ -0,0 +1,48 @@
+#ifndef IR
+#define IR
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "config.h"
+
+/* Struct which holds an impulse response for the convolution engine */
+typedef struct
+{
+	int channels;
+	size_t length;							// Samples per channel
+	unsigned int sample_rate;		// [Hz]
+	float **samples;						// One array per channel, full scale is 1.0
+} ImpulseResponse;
+
+/*
+		Reads an impulse response from a .wav file in any of the sample formats
+		of wav.h.
+
+		path: Path of the .wav file.
+
+		returns: Pointer to the new ImpulseResponse, or NULL (after printing
+		         why) if the file could not be read.
+*/
+ImpulseResponse *ir_load(const char *path);
+
+/*
+		Renders the impulse response of the comb/all pass network by running
+		a single full scale sample through the block engine until the output
+		has decayed below IR_SILENCE, or IR_MAX_SECONDS have passed.
+
+		config: Parameters of the reverb.
+		sample_rate: Sample rate the impulse response is rendered at [Hz].
+
+		returns: Pointer to the new single channel ImpulseResponse, or NULL
+		         if it could not be allocated.
+*/
+ImpulseResponse *ir_render(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Frees an impulse response.
+
+		ir: Impulse response created by ir_load or ir_render.
+*/
+void ir_free(ImpulseResponse *ir);
+#endif
@@ -0,0 +1,383 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Vectorized DSP kernels for the block engine. Every stage of the
+	network feeds back at least one delay length, which is far longer
+	than a vector register, so consecutive samples of a span never
+	depend on each other and can be computed side by side.
+
+	This file holds the scalar kernels and picks the vector variants of
+	kernels_<isa>.c at run time.
+*/
+
+/* Libraries */
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Header files */
+#include "kernels.h"
+
+/* Scalar kernels */
+
+void kernel_comb_scalar(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span)
+{
+	for (size_t j = 0; j < span; j++)
+	{
+		float sample = ff * in[j];
+
+		for (int i = 0; i < num_taps; i++)
+		{
+			sample += fb * taps[i][j];
+		}
+
+		out[j] = sample;
+	}
+}
+
+void kernel_comb_bank_scalar(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                             int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span)
+{
+	const float pass = 1.0f - damp;
+
+	for (size_t j = 0; j < span; j++)
+	{
+		out[j] = 0;
+	}
+
+	// The combs only meet in the sum, so each one runs over the whole span in turn.
+	// Every delay is at least one sample, so no comb reads the row being written.
+	for (int k = 0; k < lanes; k++)
+	{
+		float state = damped[k];
+
+		for (size_t j = 0; j < span; j++)
+		{
+			unsigned int now = position + j;
+			float delayed = line[(size_t) ((now - delays[k]) & mask) * lanes + k];
+
+			state = delayed * pass + state * damp;
+			line[(size_t) (now & mask) * lanes + k] = gains[k] * in[j] + state * fb;
+			if (k < num_combs)
+			{
+				out[j] += delayed;
+			}
+		}
+
+		damped[k] = state;
+	}
+}
+
+void kernel_hadamard_scalar(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span)
+{
+	for (size_t j = 0; j < span; j++)
+	{
+		float column[MAX_HADAMARD_ROWS];
+
+		for (int k = 0; k < num_rows; k++)
+		{
+			column[k] = gains[k] * in[k][j];
+		}
+
+		for (int half = 1; half < num_rows; half *= 2)
+		{
+			for (int i = 0; i < num_rows; i += 2 * half)
+			{
+				for (int k = i; k < i + half; k++)
+				{
+					float a = column[k], b = column[k + half];
+					column[k] = a + b;
+					column[k + half] = a - b;
+				}
+			}
+		}
+
+		for (int k = 0; k < num_rows; k++)
+		{
+			out[k][j] = column[k];
+		}
+	}
+}
+
+void kernel_interleave_scalar(float *rows, const float *const *planar, int num_streams, size_t span)
+{
+	for (int s = 0; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			rows[j * num_streams + s] = planar[s][j];
+		}
+	}
+}
+
+void kernel_deinterleave_scalar(float *const *planar, const float *rows, int num_streams, size_t span)
+{
+	for (int s = 0; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			planar[s][j] = rows[j * num_streams + s];
+		}
+	}
+}
+
+void kernel_all_pass_scalar(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span)
+{
+	for (size_t j = 0; j < span; j++)
+	{
+		float sample = -ff * in_now[j];
+		sample += in_delayed[j];
+		sample += fb * out_delayed[j];
+		out[j] = sample;
+	}
+}
+
+void kernel_accumulate_scalar(float *out, const float *in, size_t span)
+{
+	for (size_t j = 0; j < span; j++)
+	{
+		out[j] += in[j];
+	}
+}
+
+void kernel_complex_mac_scalar(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins)
+{
+	for (size_t j = 0; j < bins; j++)
+	{
+		float re = x_re[j] * h_re[j];
+		float im = x_re[j] * h_im[j];
+		re -= x_im[j] * h_im[j];
+		im += x_im[j] * h_re[j];
+		acc_re[j] += re;
+		acc_im[j] += im;
+	}
+}
+
+float kernel_peak_scalar(const float *in, size_t span)
+{
+	float peak = 0;
+
+	for (size_t j = 0; j < span; j++)
+	{
+		float magnitude = fabsf(in[j]);
+		peak = magnitude > peak ? magnitude : peak;
+	}
+
+	return peak;
+}
+
+#if defined(__SSE2__)
+
+/* Flush to zero (bit 15) and denormals are zero (bit 6) of MXCSR */
+#define MXCSR_FLUSH_DENORMALS 0x8040
+
+unsigned int kernel_flush_denormals(void)
+{
+	unsigned int mode = _mm_getcsr();
+
+	_mm_setcsr(mode | MXCSR_FLUSH_DENORMALS);
+	return mode;
+}
+
+void kernel_restore_denormals(unsigned int mode)
+{
+	_mm_setcsr(mode);
+}
+
+#else
+
+unsigned int kernel_flush_denormals(void)
+{
+	return 0;
+}
+
+void kernel_restore_denormals(unsigned int mode)
+{
+	(void) mode;
+}
+
+#endif
+
+/* Dispatch */
+
+static const KernelTable kernels_scalar = {
+	.name = "scalar",
+	.comb = kernel_comb_scalar,
+	.comb_bank = kernel_comb_bank_scalar,
+	.hadamard = kernel_hadamard_scalar,
+	.interleave = kernel_interleave_scalar,
+	.deinterleave = kernel_deinterleave_scalar,
+	.all_pass = kernel_all_pass_scalar,
+	.accumulate = kernel_accumulate_scalar,
+	.complex_mac = kernel_complex_mac_scalar,
+	.peak = kernel_peak_scalar,
+	.to_float = convert_to_float_scalar,
+	.from_float = convert_from_float_scalar
+};
+
+/* Every instruction set, each one a superset of the one before */
+static const KernelTable *const isa_tables[] = {
+	&kernels_scalar,
+#if defined(KERNEL_DISPATCH)
+	&kernels_sse2,
+	&kernels_avx2,
+	&kernels_avx512
+#endif
+};
+
+#define NUM_ISAS ((int) (sizeof(isa_tables) / sizeof(isa_tables[0])))
+
+static KernelTable resolved[NUM_ISAS];				// isa_tables with the gaps filled from below
+static int fastest_isa;												// Fastest instruction set the processor supports
+static _Atomic(const KernelTable *) active;		// Kernels the calls without a suffix go to
+static pthread_once_t resolve_once = PTHREAD_ONCE_INIT;
+
+/*
+		Returns whether the processor and the operating system support an
+		instruction set of isa_tables. The checks of the compiler's CPUID
+		probe include the operating system saving the wider registers.
+*/
+static int isa_supported(int isa)
+{
+#if defined(KERNEL_DISPATCH)
+	__builtin_cpu_init();
+	switch (isa)
+	{
+		case 1:
+			return __builtin_cpu_supports("sse2");
+		case 2:
+			return __builtin_cpu_supports("avx2");
+		case 3:
+			return __builtin_cpu_supports("avx512f");
+		default:
+			break;
+	}
+#endif
+	return isa == 0;
+}
+
+/* Takes a kernel the instruction set leaves out from the one below it */
+#define INHERIT(table, lower, kernel) ((table)->kernel = (table)->kernel != NULL ? (table)->kernel : (lower)->kernel)
+
+/*
+		Fills in the kernels every instruction set leaves out and makes the
+		fastest one the processor supports active. Runs once per process.
+*/
+static void resolve_tables(void)
+{
+	resolved[0] = kernels_scalar;
+	for (int i = 1; i < NUM_ISAS; i++)
+	{
+		KernelTable *table = &resolved[i];
+		const KernelTable *lower = &resolved[i - 1];
+
+		*table = *isa_tables[i];
+		INHERIT(table, lower, comb);
+		INHERIT(table, lower, comb_bank);
+		INHERIT(table, lower, hadamard);
+		INHERIT(table, lower, interleave);
+		INHERIT(table, lower, deinterleave);
+		INHERIT(table, lower, all_pass);
+		INHERIT(table, lower, accumulate);
+		INHERIT(table, lower, complex_mac);
+		INHERIT(table, lower, peak);
+		INHERIT(table, lower, to_float);
+		INHERIT(table, lower, from_float);
+	}
+
+	// An instruction set may fall back to the ones below it, so they have to be supported too
+	fastest_isa = 0;
+	while (fastest_isa + 1 < NUM_ISAS && isa_supported(fastest_isa + 1))
+	{
+		fastest_isa++;
+	}
+	atomic_store_explicit(&active, &resolved[fastest_isa], memory_order_release);
+}
+
+const KernelTable *kernel_table(void)
+{
+	const KernelTable *table = atomic_load_explicit(&active, memory_order_acquire);
+
+	if (table == NULL)
+	{
+		pthread_once(&resolve_once, resolve_tables);
+		table = atomic_load_explicit(&active, memory_order_acquire);
+	}
+	return table;
+}
+
+int kernel_use_isa(const char *name)
+{
+	pthread_once(&resolve_once, resolve_tables);
+
+	if (strcmp(name, "auto") == 0)
+	{
+		atomic_store_explicit(&active, &resolved[fastest_isa], memory_order_release);
+		return 0;
+	}
+	for (int i = 0; i <= fastest_isa; i++)
+	{
+		if (strcmp(resolved[i].name, name) == 0)
+		{
+			atomic_store_explicit(&active, &resolved[i], memory_order_release);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+const char *kernel_isa(void)
+{
+	return kernel_table()->name;
+}
+
+void kernel_comb(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span)
+{
+	kernel_table()->comb(out, in, taps, num_taps, ff, fb, span);
+}
+
+void kernel_comb_bank(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                      int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span)
+{
+	kernel_table()->comb_bank(out, in, line, delays, gains, damped, num_combs, lanes, mask, position, fb, damp, span);
+}
+
+void kernel_hadamard(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span)
+{
+	kernel_table()->hadamard(out, in, gains, num_rows, span);
+}
+
+void kernel_interleave(float *rows, const float *const *planar, int num_streams, size_t span)
+{
+	kernel_table()->interleave(rows, planar, num_streams, span);
+}
+
+void kernel_deinterleave(float *const *planar, const float *rows, int num_streams, size_t span)
+{
+	kernel_table()->deinterleave(planar, rows, num_streams, span);
+}
+
+void kernel_all_pass(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span)
+{
+	kernel_table()->all_pass(out, in_now, in_delayed, out_delayed, ff, fb, span);
+}
+
+void kernel_accumulate(float *out, const float *in, size_t span)
+{
+	kernel_table()->accumulate(out, in, span);
+}
+
+void kernel_complex_mac(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins)
+{
+	kernel_table()->complex_mac(acc_re, acc_im, x_re, x_im, h_re, h_im, bins);
+}
+
+float kernel_peak(const float *in, size_t span)
+{
+	return kernel_table()->peak(in, span);
+}
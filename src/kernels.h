@@ -0,0 +1,230 @@
+#ifndef KERNELS
+#define KERNELS
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "convert.h"
+
+#define MAX_HADAMARD_ROWS 16 // Largest matrix kernel_hadamard mixes
+
+/* Processors on which the vector kernels are picked at run time. Each
+	 kernels_<isa>.c is compiled for its own instruction set, so one build
+	 runs everywhere and uses whatever the processor has. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_DISPATCH
+#endif
+
+/*
+		DSP kernels used by the block engine. Each kernel processes a span of
+		samples in which neither the output nor any delayed read wraps around
+		the end of its delay line, so every argument is a plain array.
+
+		The kernels without a suffix call the fastest variant the processor
+		supports (AVX-512, AVX2, SSE2 or scalar), which is looked up with
+		CPUID once per process, or the one kernel_use_isa asked for. The
+		_scalar variants are always available and produce bit for bit the
+		same output, because every variant performs the same float
+		operations in the same order.
+*/
+
+/* Struct which holds the kernels of one instruction set. An instruction
+	 set only fills in the kernels it speeds up, the ones left NULL are
+	 taken from the instruction set below it. */
+typedef struct
+{
+	const char *name;										// Name kernel_use_isa knows it by
+	void (*comb)(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span);
+	void (*comb_bank)(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+	                  int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span);
+	void (*hadamard)(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span);
+	void (*interleave)(float *rows, const float *const *planar, int num_streams, size_t span);
+	void (*deinterleave)(float *const *planar, const float *rows, int num_streams, size_t span);
+	void (*all_pass)(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span);
+	void (*accumulate)(float *out, const float *in, size_t span);
+	void (*complex_mac)(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins);
+	float (*peak)(const float *in, size_t span);
+	void (*to_float)(float *out, const void *in, SampleFormat format, size_t count);
+	void (*from_float)(void *out, const float *in, SampleFormat format, size_t count);
+} KernelTable;
+
+#if defined(KERNEL_DISPATCH)
+extern const KernelTable kernels_sse2;		// kernels_sse2.c
+extern const KernelTable kernels_avx2;		// kernels_avx2.c
+extern const KernelTable kernels_avx512;	// kernels_avx512.c
+#endif
+
+/*
+		Returns the kernels every call without a suffix goes to. The first
+		call picks them with CPUID, later calls only load a pointer.
+*/
+const KernelTable *kernel_table(void);
+
+/*
+		Makes every later call of the kernels without a suffix, from any
+		thread, use the given instruction set, for testing and benchmarking
+		each variant. Call it before any engine runs.
+
+		name: scalar, sse2, avx2, avx512, or auto for the fastest one the
+		      processor supports.
+
+		returns: 0 on success, -1 if the name is unknown or the processor
+		         (or the operating system) does not support it.
+*/
+int kernel_use_isa(const char *name);
+
+/*
+		Parallel comb filters: out[j] = ff * in[j] + fb * taps[0][j] + ... + fb * taps[num_taps-1][j]
+
+		out: Output of the comb bank.
+		in: Input samples.
+		taps: Delayed comb outputs, one array per feedback tap.
+		num_taps: Amount of feedback taps.
+		ff: Feedforward gain.
+		fb: Feedback gain.
+		span: Amount of samples.
+*/
+void kernel_comb(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span);
+void kernel_comb_scalar(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span);
+
+/*
+		Bank of independent combs with damping in the feedback path
+		(Freeverb's lowpass feedback comb), stored struct of arrays: row t of
+		line holds sample t of every comb side by side, so all combs of the
+		bank are updated together. For every sample j, with
+		row(t) = (t & mask) * lanes and t = position + j:
+
+		  delayed[k] = line[row(t - delays[k]) + k]
+		  damped[k] = (1 - damp) * delayed[k] + damp * damped[k]
+		  line[row(t) + k] = gains[k] * in[j] + fb * damped[k]
+		  out[j] = delayed[0] + ... + delayed[num_combs - 1]
+
+		out: Sum of the comb outputs.
+		in: Input samples.
+		line: Delay lines of the bank, mask + 1 rows of lanes floats.
+		delays: Delay of each lane [samples], between 1 and mask.
+		gains: Input gain of each lane, 0 for the lanes past num_combs.
+		damped: State of the damping filter of each lane, updated in place.
+		num_combs: Amount of lanes that are summed into out.
+		lanes: Floats per row, a multiple of 8.
+		mask: Amount of rows - 1, the amount of rows is a power of two.
+		position: Time of the first sample.
+		fb: Feedback gain.
+		damp: Damping, 0 (none) to 1.
+		span: Amount of samples.
+*/
+void kernel_comb_bank(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                      int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span);
+void kernel_comb_bank_scalar(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                             int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span);
+
+/*
+		Mixing matrix of a feedback delay network: scales every row and
+		multiplies the column of rows at each sample by a Hadamard matrix,
+		computed as a fast Walsh-Hadamard transform (log2(num_rows) stages
+		of butterflies a + b, a - b). Every butterfly works on whole spans,
+		so the rows of a column are never shuffled across a register.
+
+		  out[i][j] = sum over k of H[i][k] * gains[k] * in[k][j]
+
+		with H[i][k] = -1 if i & k has an odd amount of bits set, 1 otherwise.
+
+		out: Mixed rows (may not alias in).
+		in: Rows to mix.
+		gains: Gain of each input row.
+		num_rows: Amount of rows, a power of two from 2 to MAX_HADAMARD_ROWS.
+		span: Amount of samples.
+*/
+void kernel_hadamard(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span);
+void kernel_hadamard_scalar(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span);
+
+/*
+		Interleaves planar streams into rows: rows[j * num_streams + s] = planar[s][j]
+
+		rows: Interleaved samples, span rows of num_streams floats.
+		planar: One array per stream.
+		num_streams: Amount of streams.
+		span: Amount of samples per stream.
+*/
+void kernel_interleave(float *rows, const float *const *planar, int num_streams, size_t span);
+void kernel_interleave_scalar(float *rows, const float *const *planar, int num_streams, size_t span);
+
+/*
+		Splits rows into planar streams: planar[s][j] = rows[j * num_streams + s]
+
+		planar: One array per stream.
+		rows: Interleaved samples, span rows of num_streams floats.
+		num_streams: Amount of streams.
+		span: Amount of samples per stream.
+*/
+void kernel_deinterleave(float *const *planar, const float *rows, int num_streams, size_t span);
+void kernel_deinterleave_scalar(float *const *planar, const float *rows, int num_streams, size_t span);
+
+/*
+		All pass filter: out[j] = -ff * in_now[j] + in_delayed[j] + fb * out_delayed[j]
+
+		out: Output of the filter.
+		in_now: Input at the current position.
+		in_delayed: Input one delay earlier.
+		out_delayed: Output one delay earlier.
+		ff: Feedforward gain.
+		fb: Feedback gain.
+		span: Amount of samples.
+*/
+void kernel_all_pass(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span);
+void kernel_all_pass_scalar(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span);
+
+/*
+		Adds in to out sample by sample: out[j] += in[j]
+
+		out: Running sum.
+		in: Samples to add.
+		span: Amount of samples.
+*/
+void kernel_accumulate(float *out, const float *in, size_t span);
+void kernel_accumulate_scalar(float *out, const float *in, size_t span);
+
+/*
+		Complex multiply accumulate of split spectra: acc[j] += x[j] * h[j]
+
+		acc_re, acc_im: Running sum.
+		x_re, x_im: First factor.
+		h_re, h_im: Second factor.
+		bins: Amount of complex values.
+*/
+void kernel_complex_mac(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins);
+void kernel_complex_mac_scalar(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins);
+
+/*
+		Returns the largest magnitude in a span: max |in[j]|, 0 for an empty span.
+
+		in: Samples.
+		span: Amount of samples.
+*/
+float kernel_peak(const float *in, size_t span);
+float kernel_peak_scalar(const float *in, size_t span);
+
+/*
+		Makes the calling thread flush subnormal floats to zero, both the
+		results (FTZ) and the operands (DAZ). A decaying feedback path
+		otherwise ends up in subnormals, which are many times slower on x86.
+		Nothing changes for samples above about 1e-38. Does nothing where
+		the kernels are scalar.
+
+		returns: The previous mode, for kernel_restore_denormals.
+*/
+unsigned int kernel_flush_denormals(void);
+
+/*
+		Puts back the mode kernel_flush_denormals replaced, so that callers
+		of the library keep their own floating point environment.
+
+		mode: Return value of kernel_flush_denormals.
+*/
+void kernel_restore_denormals(unsigned int mode);
+
+/*
+		Returns the name of the instruction set the kernels without a suffix use.
+*/
+const char *kernel_isa(void);
+#endif
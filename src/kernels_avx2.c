@@ -0,0 +1,432 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	AVX2 variants of the DSP kernels and the sample conversions. The file
+	is compiled for AVX2 whatever the rest of the build targets, and its
+	kernels are only called once kernels.c has found AVX2 with CPUID.
+*/
+
+/* Libraries */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+/* Header files */
+#include "kernels.h"
+#include "convert.h"
+
+#if defined(KERNEL_DISPATCH)
+
+#pragma GCC target("avx2")
+
+/* AVX2 kernels, 8 samples per instruction */
+
+static void kernel_comb_avx2(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span)
+{
+	const __m256 vff = _mm256_set1_ps(ff);
+	const __m256 vfb = _mm256_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 8 <= span; j += 8)
+	{
+		__m256 sample = _mm256_mul_ps(vff, _mm256_loadu_ps(in + j));
+
+		for (int i = 0; i < num_taps; i++)
+		{
+			sample = _mm256_add_ps(sample, _mm256_mul_ps(vfb, _mm256_loadu_ps(taps[i] + j)));
+		}
+
+		_mm256_storeu_ps(out + j, sample);
+	}
+
+	// Finish the samples that do not fill a whole register
+	const float *rest[num_taps > 0 ? num_taps : 1];
+	for (int i = 0; i < num_taps; i++)
+	{
+		rest[i] = taps[i] + j;
+	}
+	kernel_comb_scalar(out + j, in + j, rest, num_taps, ff, fb, span - j);
+}
+
+static void kernel_comb_bank_avx2(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                      int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span)
+{
+	const __m256 vpass = _mm256_set1_ps(1.0f - damp);
+	const __m256 vdamp = _mm256_set1_ps(damp);
+	const __m256 vfb = _mm256_set1_ps(fb);
+	const __m256i vmask = _mm256_set1_epi32((int) mask);
+	const __m256i vlanes = _mm256_set1_epi32(lanes);
+
+	for (size_t j = 0; j < span; j++)
+	{
+		out[j] = 0;
+	}
+
+	// Eight combs at a time, each lane gathers from its own comb's delay
+	for (int k = 0; k < lanes; k += 8)
+	{
+		const __m256i vdelays = _mm256_loadu_si256((const __m256i *) (delays + k));
+		const __m256i lane = _mm256_setr_epi32(k, k + 1, k + 2, k + 3, k + 4, k + 5, k + 6, k + 7);
+		const __m256 vgains = _mm256_loadu_ps(gains + k);
+		int summed = num_combs - k < 8 ? num_combs - k : 8;
+		__m256 state = _mm256_loadu_ps(damped + k);
+		float delayed[8];
+
+		for (size_t j = 0; j < span; j++)
+		{
+			unsigned int now = position + j;
+			__m256i rows = _mm256_and_si256(_mm256_sub_epi32(_mm256_set1_epi32((int) now), vdelays), vmask);
+			__m256 value = _mm256_i32gather_ps(line, _mm256_add_epi32(_mm256_mullo_epi32(rows, vlanes), lane), 4);
+
+			state = _mm256_add_ps(_mm256_mul_ps(value, vpass), _mm256_mul_ps(state, vdamp));
+			_mm256_storeu_ps(line + (size_t) (now & mask) * lanes + k,
+			                 _mm256_add_ps(_mm256_mul_ps(vgains, _mm256_set1_ps(in[j])), _mm256_mul_ps(state, vfb)));
+
+			// Summed one comb after the other, like the scalar kernel does
+			_mm256_storeu_ps(delayed, value);
+			float sample = out[j];
+			for (int i = 0; i < summed; i++)
+			{
+				sample += delayed[i];
+			}
+			out[j] = sample;
+		}
+
+		_mm256_storeu_ps(damped + k, state);
+	}
+}
+
+static void kernel_hadamard_avx2(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span)
+{
+	size_t end = span / 8 * 8;
+
+	// One stage of butterflies at a time, each over the whole span of two rows.
+	// The first stage also applies the gains, the others work in place.
+	for (int i = 0; i < num_rows; i += 2)
+	{
+		const __m256 ga = _mm256_set1_ps(gains[i]), gb = _mm256_set1_ps(gains[i + 1]);
+		for (size_t j = 0; j < end; j += 8)
+		{
+			__m256 a = _mm256_mul_ps(ga, _mm256_loadu_ps(in[i] + j));
+			__m256 b = _mm256_mul_ps(gb, _mm256_loadu_ps(in[i + 1] + j));
+			_mm256_storeu_ps(out[i] + j, _mm256_add_ps(a, b));
+			_mm256_storeu_ps(out[i + 1] + j, _mm256_sub_ps(a, b));
+		}
+	}
+
+	for (int half = 2; half < num_rows; half *= 2)
+	{
+		for (int i = 0; i < num_rows; i += 2 * half)
+		{
+			for (int k = i; k < i + half; k++)
+			{
+				float *row_a = out[k], *row_b = out[k + half];
+				for (size_t j = 0; j < end; j += 8)
+				{
+					__m256 a = _mm256_loadu_ps(row_a + j), b = _mm256_loadu_ps(row_b + j);
+					_mm256_storeu_ps(row_a + j, _mm256_add_ps(a, b));
+					_mm256_storeu_ps(row_b + j, _mm256_sub_ps(a, b));
+				}
+			}
+		}
+	}
+
+	if (end < span)
+	{
+		const float *in_rest[MAX_HADAMARD_ROWS];
+		float *out_rest[MAX_HADAMARD_ROWS];
+
+		for (int k = 0; k < num_rows; k++)
+		{
+			in_rest[k] = in[k] + end;
+			out_rest[k] = out[k] + end;
+		}
+		kernel_hadamard_scalar(out_rest, in_rest, gains, num_rows, span - end);
+	}
+}
+
+static void kernel_interleave_avx2(float *rows, const float *const *planar, int num_streams, size_t span)
+{
+	size_t end = span / 4 * 4;
+	int s = 0;
+
+	// Four samples of four streams at a time, transposed in SSE registers (a transpose
+	// of eight by eight would need more shuffles than it saves)
+	for (; s + 4 <= num_streams; s += 4)
+	{
+		for (size_t j = 0; j < end; j += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(planar[s] + j), r1 = _mm_loadu_ps(planar[s + 1] + j);
+			__m128 r2 = _mm_loadu_ps(planar[s + 2] + j), r3 = _mm_loadu_ps(planar[s + 3] + j);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			float *row = rows + j * num_streams + s;
+			_mm_storeu_ps(row, r0);
+			_mm_storeu_ps(row + num_streams, r1);
+			_mm_storeu_ps(row + 2 * num_streams, r2);
+			_mm_storeu_ps(row + 3 * num_streams, r3);
+		}
+		for (size_t j = end; j < span; j++)
+		{
+			for (int k = s; k < s + 4; k++)
+			{
+				rows[j * num_streams + k] = planar[k][j];
+			}
+		}
+	}
+
+	for (; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			rows[j * num_streams + s] = planar[s][j];
+		}
+	}
+}
+
+static void kernel_deinterleave_avx2(float *const *planar, const float *rows, int num_streams, size_t span)
+{
+	size_t end = span / 4 * 4;
+	int s = 0;
+
+	for (; s + 4 <= num_streams; s += 4)
+	{
+		for (size_t j = 0; j < end; j += 4)
+		{
+			const float *row = rows + j * num_streams + s;
+			__m128 r0 = _mm_loadu_ps(row), r1 = _mm_loadu_ps(row + num_streams);
+			__m128 r2 = _mm_loadu_ps(row + 2 * num_streams), r3 = _mm_loadu_ps(row + 3 * num_streams);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(planar[s] + j, r0);
+			_mm_storeu_ps(planar[s + 1] + j, r1);
+			_mm_storeu_ps(planar[s + 2] + j, r2);
+			_mm_storeu_ps(planar[s + 3] + j, r3);
+		}
+		for (size_t j = end; j < span; j++)
+		{
+			for (int k = s; k < s + 4; k++)
+			{
+				planar[k][j] = rows[j * num_streams + k];
+			}
+		}
+	}
+
+	for (; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			planar[s][j] = rows[j * num_streams + s];
+		}
+	}
+}
+
+static void kernel_all_pass_avx2(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span)
+{
+	const __m256 vff = _mm256_set1_ps(-ff);
+	const __m256 vfb = _mm256_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 8 <= span; j += 8)
+	{
+		__m256 sample = _mm256_mul_ps(vff, _mm256_loadu_ps(in_now + j));
+		sample = _mm256_add_ps(sample, _mm256_loadu_ps(in_delayed + j));
+		sample = _mm256_add_ps(sample, _mm256_mul_ps(vfb, _mm256_loadu_ps(out_delayed + j)));
+		_mm256_storeu_ps(out + j, sample);
+	}
+
+	kernel_all_pass_scalar(out + j, in_now + j, in_delayed + j, out_delayed + j, ff, fb, span - j);
+}
+
+static void kernel_accumulate_avx2(float *out, const float *in, size_t span)
+{
+	size_t j = 0;
+
+	for (; j + 8 <= span; j += 8)
+	{
+		_mm256_storeu_ps(out + j, _mm256_add_ps(_mm256_loadu_ps(out + j), _mm256_loadu_ps(in + j)));
+	}
+
+	kernel_accumulate_scalar(out + j, in + j, span - j);
+}
+
+static void kernel_complex_mac_avx2(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins)
+{
+	size_t j = 0;
+
+	for (; j + 8 <= bins; j += 8)
+	{
+		__m256 xr = _mm256_loadu_ps(x_re + j), xi = _mm256_loadu_ps(x_im + j);
+		__m256 hr = _mm256_loadu_ps(h_re + j), hi = _mm256_loadu_ps(h_im + j);
+		__m256 re = _mm256_sub_ps(_mm256_mul_ps(xr, hr), _mm256_mul_ps(xi, hi));
+		__m256 im = _mm256_add_ps(_mm256_mul_ps(xr, hi), _mm256_mul_ps(xi, hr));
+		_mm256_storeu_ps(acc_re + j, _mm256_add_ps(_mm256_loadu_ps(acc_re + j), re));
+		_mm256_storeu_ps(acc_im + j, _mm256_add_ps(_mm256_loadu_ps(acc_im + j), im));
+	}
+
+	kernel_complex_mac_scalar(acc_re + j, acc_im + j, x_re + j, x_im + j, h_re + j, h_im + j, bins - j);
+}
+
+static float kernel_peak_avx2(const float *in, size_t span)
+{
+	__m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 peaks = _mm256_setzero_ps();
+	size_t j = 0;
+
+	for (; j + 8 <= span; j += 8)
+	{
+		peaks = _mm256_max_ps(peaks, _mm256_and_ps(_mm256_loadu_ps(in + j), magnitude));
+	}
+
+	// The maximum does not depend on the order, so the lanes can be folded in any order
+	__m128 folded = _mm_max_ps(_mm256_castps256_ps128(peaks), _mm256_extractf128_ps(peaks, 1));
+	folded = _mm_max_ps(folded, _mm_movehl_ps(folded, folded));
+	folded = _mm_max_ss(folded, _mm_shuffle_ps(folded, folded, 1));
+	float peak = _mm_cvtss_f32(folded);
+	float rest = kernel_peak_scalar(in + j, span - j);
+
+	return rest > peak ? rest : peak;
+}
+
+/* AVX2 conversions, 8 samples per instruction */
+
+static void convert_to_float_avx2(float *out, const void *in, SampleFormat format, size_t count)
+{
+	const unsigned char *bytes = in;
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (bytes + j)));
+				x = _mm256_slli_epi32(_mm256_sub_epi32(x, _mm256_set1_epi32(128)), 8);
+				_mm256_storeu_ps(out + j, _mm256_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (bytes + 2 * j)));
+				_mm256_storeu_ps(out + j, _mm256_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S24:
+		{
+			// Moves four packed samples into the top three bytes of four lanes
+			const __m128i spread = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+			// The second load reads 16 bytes starting at sample j + 4
+			for (; j + 10 <= count; j += 8)
+			{
+				__m128i low = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (bytes + 3 * j)), spread);
+				__m128i high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (bytes + 3 * j + 12)), spread);
+				__m256 x = _mm256_cvtepi32_ps(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1));
+				_mm256_storeu_ps(out + j, _mm256_mul_ps(x, _mm256_set1_ps(1.0f / 65536)));
+			}
+			break;
+		}
+		case SAMPLE_S32:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256 x = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *) (bytes + 4 * j)));
+				_mm256_storeu_ps(out + j, _mm256_mul_ps(x, _mm256_set1_ps(1.0f / 65536)));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256 x = _mm256_loadu_ps((const float *) (bytes + 4 * j));
+				_mm256_storeu_ps(out + j, _mm256_mul_ps(x, _mm256_set1_ps(32768.0f)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	convert_to_float_scalar(out + j, bytes + j * sample_format_bytes(format), format, count - j);
+}
+
+/*
+		Scales, clamps and converts eight samples to int32, rounding to nearest.
+*/
+static __m256i to_int32(const float *in, float scale, float low, float high)
+{
+	__m256 x = _mm256_mul_ps(_mm256_loadu_ps(in), _mm256_set1_ps(scale));
+	x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(high)), _mm256_set1_ps(low));
+	return _mm256_cvtps_epi32(x);
+}
+
+static void convert_from_float_avx2(void *out, const float *in, SampleFormat format, size_t count)
+{
+	unsigned char *bytes = out;
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256i x = _mm256_add_epi32(to_int32(in + j, 1.0f / 256, -128.0f, 127.0f), _mm256_set1_epi32(128));
+				__m128i words = _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+				_mm_storel_epi64((__m128i *) (bytes + j), _mm_packus_epi16(words, words));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 8 <= count; j += 8)
+			{
+				__m256 x = _mm256_loadu_ps(in + j);
+				x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(INT16_MAX)), _mm256_set1_ps(INT16_MIN));
+				__m256i words = _mm256_cvttps_epi32(x);
+				_mm_storeu_si128((__m128i *) (bytes + 2 * j), _mm_packs_epi32(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+			}
+			break;
+		case SAMPLE_S24:
+		{
+			// Packs the low three bytes of four lanes into twelve bytes
+			const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+			// Each store writes four bytes past its samples, which the next store overwrites
+			for (; j + 10 <= count; j += 8)
+			{
+				__m256i x = to_int32(in + j, 256.0f, -8388608.0f, 8388607.0f);
+				_mm_storeu_si128((__m128i *) (bytes + 3 * j), _mm_shuffle_epi8(_mm256_castsi256_si128(x), pack));
+				_mm_storeu_si128((__m128i *) (bytes + 3 * j + 12), _mm_shuffle_epi8(_mm256_extracti128_si256(x, 1), pack));
+			}
+			break;
+		}
+		case SAMPLE_S32:
+			for (; j + 8 <= count; j += 8)
+			{
+				_mm256_storeu_si256((__m256i *) (bytes + 4 * j), to_int32(in + j, 65536.0f, -2147483648.0f, S32_CLAMP));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 8 <= count; j += 8)
+			{
+				_mm256_storeu_ps((float *) (bytes + 4 * j), _mm256_mul_ps(_mm256_loadu_ps(in + j), _mm256_set1_ps(1.0f / 32768)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	convert_from_float_scalar(bytes + j * sample_format_bytes(format), in + j, format, count - j);
+}
+
+const KernelTable kernels_avx2 = {
+	.name = "avx2",
+	.comb = kernel_comb_avx2,
+	.comb_bank = kernel_comb_bank_avx2,
+	.hadamard = kernel_hadamard_avx2,
+	.interleave = kernel_interleave_avx2,
+	.deinterleave = kernel_deinterleave_avx2,
+	.all_pass = kernel_all_pass_avx2,
+	.accumulate = kernel_accumulate_avx2,
+	.complex_mac = kernel_complex_mac_avx2,
+	.peak = kernel_peak_avx2,
+	.to_float = convert_to_float_avx2,
+	.from_float = convert_from_float_avx2
+};
+
+#endif
@@ -0,0 +1,275 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	AVX-512 variants of the kernels that stream through long spans. The
+	file is compiled for AVX-512F whatever the rest of the build targets,
+	and its kernels are only called once kernels.c has found AVX-512F
+	with CPUID. The comb bank and the (de)interleaving shuffle too little
+	per sample to gain from wider registers, they stay with AVX2.
+*/
+
+/* Libraries */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+/* Header files */
+#include "kernels.h"
+#include "convert.h"
+
+#if defined(KERNEL_DISPATCH)
+
+#pragma GCC target("avx512f")
+
+/* AVX-512 kernels, 16 samples per instruction. The samples that do not fill
+	 a whole register are left to the AVX2 kernels. */
+
+static void kernel_comb_avx512(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span)
+{
+	const __m512 vff = _mm512_set1_ps(ff);
+	const __m512 vfb = _mm512_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 16 <= span; j += 16)
+	{
+		__m512 sample = _mm512_mul_ps(vff, _mm512_loadu_ps(in + j));
+
+		for (int i = 0; i < num_taps; i++)
+		{
+			sample = _mm512_add_ps(sample, _mm512_mul_ps(vfb, _mm512_loadu_ps(taps[i] + j)));
+		}
+
+		_mm512_storeu_ps(out + j, sample);
+	}
+
+	const float *rest[num_taps > 0 ? num_taps : 1];
+	for (int i = 0; i < num_taps; i++)
+	{
+		rest[i] = taps[i] + j;
+	}
+	kernels_avx2.comb(out + j, in + j, rest, num_taps, ff, fb, span - j);
+}
+
+static void kernel_hadamard_avx512(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span)
+{
+	size_t end = span / 16 * 16;
+
+	// One stage of butterflies at a time, like the AVX2 kernel
+	for (int i = 0; i < num_rows; i += 2)
+	{
+		const __m512 ga = _mm512_set1_ps(gains[i]), gb = _mm512_set1_ps(gains[i + 1]);
+		for (size_t j = 0; j < end; j += 16)
+		{
+			__m512 a = _mm512_mul_ps(ga, _mm512_loadu_ps(in[i] + j));
+			__m512 b = _mm512_mul_ps(gb, _mm512_loadu_ps(in[i + 1] + j));
+			_mm512_storeu_ps(out[i] + j, _mm512_add_ps(a, b));
+			_mm512_storeu_ps(out[i + 1] + j, _mm512_sub_ps(a, b));
+		}
+	}
+
+	for (int half = 2; half < num_rows; half *= 2)
+	{
+		for (int i = 0; i < num_rows; i += 2 * half)
+		{
+			for (int k = i; k < i + half; k++)
+			{
+				float *row_a = out[k], *row_b = out[k + half];
+				for (size_t j = 0; j < end; j += 16)
+				{
+					__m512 a = _mm512_loadu_ps(row_a + j), b = _mm512_loadu_ps(row_b + j);
+					_mm512_storeu_ps(row_a + j, _mm512_add_ps(a, b));
+					_mm512_storeu_ps(row_b + j, _mm512_sub_ps(a, b));
+				}
+			}
+		}
+	}
+
+	if (end < span)
+	{
+		const float *in_rest[MAX_HADAMARD_ROWS];
+		float *out_rest[MAX_HADAMARD_ROWS];
+
+		for (int k = 0; k < num_rows; k++)
+		{
+			in_rest[k] = in[k] + end;
+			out_rest[k] = out[k] + end;
+		}
+		kernels_avx2.hadamard(out_rest, in_rest, gains, num_rows, span - end);
+	}
+}
+
+static void kernel_all_pass_avx512(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span)
+{
+	const __m512 vff = _mm512_set1_ps(-ff);
+	const __m512 vfb = _mm512_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 16 <= span; j += 16)
+	{
+		__m512 sample = _mm512_mul_ps(vff, _mm512_loadu_ps(in_now + j));
+		sample = _mm512_add_ps(sample, _mm512_loadu_ps(in_delayed + j));
+		sample = _mm512_add_ps(sample, _mm512_mul_ps(vfb, _mm512_loadu_ps(out_delayed + j)));
+		_mm512_storeu_ps(out + j, sample);
+	}
+
+	kernels_avx2.all_pass(out + j, in_now + j, in_delayed + j, out_delayed + j, ff, fb, span - j);
+}
+
+static void kernel_accumulate_avx512(float *out, const float *in, size_t span)
+{
+	size_t j = 0;
+
+	for (; j + 16 <= span; j += 16)
+	{
+		_mm512_storeu_ps(out + j, _mm512_add_ps(_mm512_loadu_ps(out + j), _mm512_loadu_ps(in + j)));
+	}
+
+	kernels_avx2.accumulate(out + j, in + j, span - j);
+}
+
+static void kernel_complex_mac_avx512(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins)
+{
+	size_t j = 0;
+
+	for (; j + 16 <= bins; j += 16)
+	{
+		__m512 xr = _mm512_loadu_ps(x_re + j), xi = _mm512_loadu_ps(x_im + j);
+		__m512 hr = _mm512_loadu_ps(h_re + j), hi = _mm512_loadu_ps(h_im + j);
+		__m512 re = _mm512_sub_ps(_mm512_mul_ps(xr, hr), _mm512_mul_ps(xi, hi));
+		__m512 im = _mm512_add_ps(_mm512_mul_ps(xr, hi), _mm512_mul_ps(xi, hr));
+		_mm512_storeu_ps(acc_re + j, _mm512_add_ps(_mm512_loadu_ps(acc_re + j), re));
+		_mm512_storeu_ps(acc_im + j, _mm512_add_ps(_mm512_loadu_ps(acc_im + j), im));
+	}
+
+	kernels_avx2.complex_mac(acc_re + j, acc_im + j, x_re + j, x_im + j, h_re + j, h_im + j, bins - j);
+}
+
+static float kernel_peak_avx512(const float *in, size_t span)
+{
+	__m512 peaks = _mm512_setzero_ps();
+	size_t j = 0;
+
+	for (; j + 16 <= span; j += 16)
+	{
+		peaks = _mm512_max_ps(peaks, _mm512_abs_ps(_mm512_loadu_ps(in + j)));
+	}
+
+	// The maximum does not depend on the order, so the lanes can be folded in any order
+	float peak = _mm512_reduce_max_ps(peaks);
+	float rest = kernels_avx2.peak(in + j, span - j);
+
+	return rest > peak ? rest : peak;
+}
+
+/* AVX-512 conversions, 16 samples per instruction. 24-bit samples need byte
+	 shuffles across the register that AVX-512F lacks, they are left to AVX2. */
+
+static void convert_to_float_avx512(float *out, const void *in, SampleFormat format, size_t count)
+{
+	const unsigned char *bytes = in;
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512i x = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) (bytes + j)));
+				x = _mm512_slli_epi32(_mm512_sub_epi32(x, _mm512_set1_epi32(128)), 8);
+				_mm512_storeu_ps(out + j, _mm512_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) (bytes + 2 * j)));
+				_mm512_storeu_ps(out + j, _mm512_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S32:
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512 x = _mm512_cvtepi32_ps(_mm512_loadu_si512(bytes + 4 * j));
+				_mm512_storeu_ps(out + j, _mm512_mul_ps(x, _mm512_set1_ps(1.0f / 65536)));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512 x = _mm512_loadu_ps(bytes + 4 * j);
+				_mm512_storeu_ps(out + j, _mm512_mul_ps(x, _mm512_set1_ps(32768.0f)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	kernels_avx2.to_float(out + j, bytes + j * sample_format_bytes(format), format, count - j);
+}
+
+/*
+		Scales, clamps and converts sixteen samples to int32, rounding to nearest.
+*/
+static __m512i to_int32(const float *in, float scale, float low, float high)
+{
+	__m512 x = _mm512_mul_ps(_mm512_loadu_ps(in), _mm512_set1_ps(scale));
+	x = _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(high)), _mm512_set1_ps(low));
+	return _mm512_cvtps_epi32(x);
+}
+
+static void convert_from_float_avx512(void *out, const float *in, SampleFormat format, size_t count)
+{
+	unsigned char *bytes = out;
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			// Already clamped to 0 to 255, so narrowing keeps every value
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512i x = _mm512_add_epi32(to_int32(in + j, 1.0f / 256, -128.0f, 127.0f), _mm512_set1_epi32(128));
+				_mm_storeu_si128((__m128i *) (bytes + j), _mm512_cvtepi32_epi8(x));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 16 <= count; j += 16)
+			{
+				__m512 x = _mm512_loadu_ps(in + j);
+				x = _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(INT16_MAX)), _mm512_set1_ps(INT16_MIN));
+				_mm256_storeu_si256((__m256i *) (bytes + 2 * j), _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(x)));
+			}
+			break;
+		case SAMPLE_S32:
+			for (; j + 16 <= count; j += 16)
+			{
+				_mm512_storeu_si512(bytes + 4 * j, to_int32(in + j, 65536.0f, -2147483648.0f, S32_CLAMP));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 16 <= count; j += 16)
+			{
+				_mm512_storeu_ps(bytes + 4 * j, _mm512_mul_ps(_mm512_loadu_ps(in + j), _mm512_set1_ps(1.0f / 32768)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	kernels_avx2.from_float(bytes + j * sample_format_bytes(format), in + j, format, count - j);
+}
+
+const KernelTable kernels_avx512 = {
+	.name = "avx512",
+	.comb = kernel_comb_avx512,
+	.hadamard = kernel_hadamard_avx512,
+	.all_pass = kernel_all_pass_avx512,
+	.accumulate = kernel_accumulate_avx512,
+	.complex_mac = kernel_complex_mac_avx512,
+	.peak = kernel_peak_avx512,
+	.to_float = convert_to_float_avx512,
+	.from_float = convert_from_float_avx512
+};
+
+#endif
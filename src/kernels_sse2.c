@@ -0,0 +1,407 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	SSE2 variants of the DSP kernels and the sample conversions. The file
+	is compiled for SSE2 whatever the rest of the build targets, and its
+	kernels are only called once kernels.c has found SSE2 with CPUID.
+*/
+
+/* Libraries */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+
+/* Header files */
+#include "kernels.h"
+#include "convert.h"
+
+#if defined(KERNEL_DISPATCH)
+
+#pragma GCC target("sse2")
+
+/* SSE2 kernels, 4 samples per instruction */
+
+static void kernel_comb_sse2(float *out, const float *in, const float *const *taps, int num_taps, float ff, float fb, size_t span)
+{
+	const __m128 vff = _mm_set1_ps(ff);
+	const __m128 vfb = _mm_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 4 <= span; j += 4)
+	{
+		__m128 sample = _mm_mul_ps(vff, _mm_loadu_ps(in + j));
+
+		for (int i = 0; i < num_taps; i++)
+		{
+			sample = _mm_add_ps(sample, _mm_mul_ps(vfb, _mm_loadu_ps(taps[i] + j)));
+		}
+
+		_mm_storeu_ps(out + j, sample);
+	}
+
+	// Finish the samples that do not fill a whole register
+	const float *rest[num_taps > 0 ? num_taps : 1];
+	for (int i = 0; i < num_taps; i++)
+	{
+		rest[i] = taps[i] + j;
+	}
+	kernel_comb_scalar(out + j, in + j, rest, num_taps, ff, fb, span - j);
+}
+
+static void kernel_comb_bank_sse2(float *out, const float *in, float *line, const int *delays, const float *gains, float *damped,
+                      int num_combs, int lanes, unsigned int mask, unsigned int position, float fb, float damp, size_t span)
+{
+	const __m128 vpass = _mm_set1_ps(1.0f - damp);
+	const __m128 vdamp = _mm_set1_ps(damp);
+	const __m128 vfb = _mm_set1_ps(fb);
+
+	for (size_t j = 0; j < span; j++)
+	{
+		out[j] = 0;
+	}
+
+	// Four combs at a time. SSE2 has no gather, so the delayed samples are collected one by one.
+	for (int k = 0; k < lanes; k += 4)
+	{
+		const __m128 vgains = _mm_loadu_ps(gains + k);
+		int summed = num_combs - k < 4 ? (num_combs - k > 0 ? num_combs - k : 0) : 4;
+		__m128 state = _mm_loadu_ps(damped + k);
+		const unsigned int d0 = delays[k], d1 = delays[k + 1], d2 = delays[k + 2], d3 = delays[k + 3];
+		float *column = line + k;
+		float delayed[4];
+
+		for (size_t j = 0; j < span; j++)
+		{
+			unsigned int now = position + j;
+
+			delayed[0] = column[(size_t) ((now - d0) & mask) * lanes];
+			delayed[1] = column[(size_t) ((now - d1) & mask) * lanes + 1];
+			delayed[2] = column[(size_t) ((now - d2) & mask) * lanes + 2];
+			delayed[3] = column[(size_t) ((now - d3) & mask) * lanes + 3];
+			__m128 value = _mm_setr_ps(delayed[0], delayed[1], delayed[2], delayed[3]);
+
+			state = _mm_add_ps(_mm_mul_ps(value, vpass), _mm_mul_ps(state, vdamp));
+			_mm_storeu_ps(column + (size_t) (now & mask) * lanes,
+			              _mm_add_ps(_mm_mul_ps(vgains, _mm_set1_ps(in[j])), _mm_mul_ps(state, vfb)));
+
+			// Summed one comb after the other, like the scalar kernel does
+			float sample = out[j];
+			for (int i = 0; i < summed; i++)
+			{
+				sample += delayed[i];
+			}
+			out[j] = sample;
+		}
+
+		_mm_storeu_ps(damped + k, state);
+	}
+}
+
+static void kernel_hadamard_sse2(float *const *out, const float *const *in, const float *gains, int num_rows, size_t span)
+{
+	size_t end = span / 4 * 4;
+
+	// One stage of butterflies at a time, each over the whole span of two rows.
+	// The first stage also applies the gains, the others work in place.
+	for (int i = 0; i < num_rows; i += 2)
+	{
+		const __m128 ga = _mm_set1_ps(gains[i]), gb = _mm_set1_ps(gains[i + 1]);
+		for (size_t j = 0; j < end; j += 4)
+		{
+			__m128 a = _mm_mul_ps(ga, _mm_loadu_ps(in[i] + j));
+			__m128 b = _mm_mul_ps(gb, _mm_loadu_ps(in[i + 1] + j));
+			_mm_storeu_ps(out[i] + j, _mm_add_ps(a, b));
+			_mm_storeu_ps(out[i + 1] + j, _mm_sub_ps(a, b));
+		}
+	}
+
+	for (int half = 2; half < num_rows; half *= 2)
+	{
+		for (int i = 0; i < num_rows; i += 2 * half)
+		{
+			for (int k = i; k < i + half; k++)
+			{
+				float *row_a = out[k], *row_b = out[k + half];
+				for (size_t j = 0; j < end; j += 4)
+				{
+					__m128 a = _mm_loadu_ps(row_a + j), b = _mm_loadu_ps(row_b + j);
+					_mm_storeu_ps(row_a + j, _mm_add_ps(a, b));
+					_mm_storeu_ps(row_b + j, _mm_sub_ps(a, b));
+				}
+			}
+		}
+	}
+
+	if (end < span)
+	{
+		const float *in_rest[MAX_HADAMARD_ROWS];
+		float *out_rest[MAX_HADAMARD_ROWS];
+
+		for (int k = 0; k < num_rows; k++)
+		{
+			in_rest[k] = in[k] + end;
+			out_rest[k] = out[k] + end;
+		}
+		kernel_hadamard_scalar(out_rest, in_rest, gains, num_rows, span - end);
+	}
+}
+
+static void kernel_interleave_sse2(float *rows, const float *const *planar, int num_streams, size_t span)
+{
+	size_t end = span / 4 * 4;
+	int s = 0;
+
+	// Four samples of four streams at a time, transposed in registers
+	for (; s + 4 <= num_streams; s += 4)
+	{
+		for (size_t j = 0; j < end; j += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(planar[s] + j), r1 = _mm_loadu_ps(planar[s + 1] + j);
+			__m128 r2 = _mm_loadu_ps(planar[s + 2] + j), r3 = _mm_loadu_ps(planar[s + 3] + j);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			float *row = rows + j * num_streams + s;
+			_mm_storeu_ps(row, r0);
+			_mm_storeu_ps(row + num_streams, r1);
+			_mm_storeu_ps(row + 2 * num_streams, r2);
+			_mm_storeu_ps(row + 3 * num_streams, r3);
+		}
+		for (size_t j = end; j < span; j++)
+		{
+			for (int k = s; k < s + 4; k++)
+			{
+				rows[j * num_streams + k] = planar[k][j];
+			}
+		}
+	}
+
+	for (; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			rows[j * num_streams + s] = planar[s][j];
+		}
+	}
+}
+
+static void kernel_deinterleave_sse2(float *const *planar, const float *rows, int num_streams, size_t span)
+{
+	size_t end = span / 4 * 4;
+	int s = 0;
+
+	for (; s + 4 <= num_streams; s += 4)
+	{
+		for (size_t j = 0; j < end; j += 4)
+		{
+			const float *row = rows + j * num_streams + s;
+			__m128 r0 = _mm_loadu_ps(row), r1 = _mm_loadu_ps(row + num_streams);
+			__m128 r2 = _mm_loadu_ps(row + 2 * num_streams), r3 = _mm_loadu_ps(row + 3 * num_streams);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(planar[s] + j, r0);
+			_mm_storeu_ps(planar[s + 1] + j, r1);
+			_mm_storeu_ps(planar[s + 2] + j, r2);
+			_mm_storeu_ps(planar[s + 3] + j, r3);
+		}
+		for (size_t j = end; j < span; j++)
+		{
+			for (int k = s; k < s + 4; k++)
+			{
+				planar[k][j] = rows[j * num_streams + k];
+			}
+		}
+	}
+
+	for (; s < num_streams; s++)
+	{
+		for (size_t j = 0; j < span; j++)
+		{
+			planar[s][j] = rows[j * num_streams + s];
+		}
+	}
+}
+
+static void kernel_all_pass_sse2(float *out, const float *in_now, const float *in_delayed, const float *out_delayed, float ff, float fb, size_t span)
+{
+	const __m128 vff = _mm_set1_ps(-ff);
+	const __m128 vfb = _mm_set1_ps(fb);
+	size_t j = 0;
+
+	for (; j + 4 <= span; j += 4)
+	{
+		__m128 sample = _mm_mul_ps(vff, _mm_loadu_ps(in_now + j));
+		sample = _mm_add_ps(sample, _mm_loadu_ps(in_delayed + j));
+		sample = _mm_add_ps(sample, _mm_mul_ps(vfb, _mm_loadu_ps(out_delayed + j)));
+		_mm_storeu_ps(out + j, sample);
+	}
+
+	kernel_all_pass_scalar(out + j, in_now + j, in_delayed + j, out_delayed + j, ff, fb, span - j);
+}
+
+static void kernel_accumulate_sse2(float *out, const float *in, size_t span)
+{
+	size_t j = 0;
+
+	for (; j + 4 <= span; j += 4)
+	{
+		_mm_storeu_ps(out + j, _mm_add_ps(_mm_loadu_ps(out + j), _mm_loadu_ps(in + j)));
+	}
+
+	kernel_accumulate_scalar(out + j, in + j, span - j);
+}
+
+static void kernel_complex_mac_sse2(float *acc_re, float *acc_im, const float *x_re, const float *x_im, const float *h_re, const float *h_im, size_t bins)
+{
+	size_t j = 0;
+
+	for (; j + 4 <= bins; j += 4)
+	{
+		__m128 xr = _mm_loadu_ps(x_re + j), xi = _mm_loadu_ps(x_im + j);
+		__m128 hr = _mm_loadu_ps(h_re + j), hi = _mm_loadu_ps(h_im + j);
+		__m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+		__m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+		_mm_storeu_ps(acc_re + j, _mm_add_ps(_mm_loadu_ps(acc_re + j), re));
+		_mm_storeu_ps(acc_im + j, _mm_add_ps(_mm_loadu_ps(acc_im + j), im));
+	}
+
+	kernel_complex_mac_scalar(acc_re + j, acc_im + j, x_re + j, x_im + j, h_re + j, h_im + j, bins - j);
+}
+
+static float kernel_peak_sse2(const float *in, size_t span)
+{
+	__m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 peaks = _mm_setzero_ps();
+	size_t j = 0;
+
+	for (; j + 4 <= span; j += 4)
+	{
+		peaks = _mm_max_ps(peaks, _mm_and_ps(_mm_loadu_ps(in + j), magnitude));
+	}
+
+	// The maximum does not depend on the order, so the lanes can be folded in any order
+	peaks = _mm_max_ps(peaks, _mm_movehl_ps(peaks, peaks));
+	peaks = _mm_max_ss(peaks, _mm_shuffle_ps(peaks, peaks, 1));
+	float peak = _mm_cvtss_f32(peaks);
+	float rest = kernel_peak_scalar(in + j, span - j);
+
+	return rest > peak ? rest : peak;
+}
+
+/* SSE2 conversions. SSE2 can not shuffle bytes, so 24-bit samples stay scalar. */
+
+static void convert_to_float_sse2(float *out, const void *in, SampleFormat format, size_t count)
+{
+	const unsigned char *bytes = in;
+	const __m128i zero = _mm_setzero_si128();
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			for (; j + 4 <= count; j += 4)
+			{
+				int32_t packed;
+				memcpy(&packed, bytes + j, sizeof(packed));
+				__m128i x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+				x = _mm_slli_epi32(_mm_sub_epi32(x, _mm_set1_epi32(128)), 8);
+				_mm_storeu_ps(out + j, _mm_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128i x = _mm_loadl_epi64((const __m128i *) (bytes + 2 * j));
+				x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+				_mm_storeu_ps(out + j, _mm_cvtepi32_ps(x));
+			}
+			break;
+		case SAMPLE_S32:
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 x = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (bytes + 4 * j)));
+				_mm_storeu_ps(out + j, _mm_mul_ps(x, _mm_set1_ps(1.0f / 65536)));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 x = _mm_loadu_ps((const float *) (bytes + 4 * j));
+				_mm_storeu_ps(out + j, _mm_mul_ps(x, _mm_set1_ps(32768.0f)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	convert_to_float_scalar(out + j, bytes + j * sample_format_bytes(format), format, count - j);
+}
+
+/*
+		Scales, clamps and converts four samples to int32, rounding to nearest.
+*/
+static __m128i to_int32(const float *in, float scale, float low, float high)
+{
+	__m128 x = _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(scale));
+	x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(high)), _mm_set1_ps(low));
+	return _mm_cvtps_epi32(x);
+}
+
+static void convert_from_float_sse2(void *out, const float *in, SampleFormat format, size_t count)
+{
+	unsigned char *bytes = out;
+	size_t j = 0;
+
+	switch (format)
+	{
+		case SAMPLE_U8:
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128i x = _mm_add_epi32(to_int32(in + j, 1.0f / 256, -128.0f, 127.0f), _mm_set1_epi32(128));
+				__m128i words = _mm_packs_epi32(x, x);
+				int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+				memcpy(bytes + j, &packed, sizeof(packed));
+			}
+			break;
+		case SAMPLE_S16:
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 x = _mm_loadu_ps(in + j);
+				x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(INT16_MAX)), _mm_set1_ps(INT16_MIN));
+				__m128i words = _mm_cvttps_epi32(x);
+				_mm_storel_epi64((__m128i *) (bytes + 2 * j), _mm_packs_epi32(words, words));
+			}
+			break;
+		case SAMPLE_S32:
+			for (; j + 4 <= count; j += 4)
+			{
+				_mm_storeu_si128((__m128i *) (bytes + 4 * j), to_int32(in + j, 65536.0f, -2147483648.0f, S32_CLAMP));
+			}
+			break;
+		case SAMPLE_F32:
+			for (; j + 4 <= count; j += 4)
+			{
+				_mm_storeu_ps((float *) (bytes + 4 * j), _mm_mul_ps(_mm_loadu_ps(in + j), _mm_set1_ps(1.0f / 32768)));
+			}
+			break;
+		default:
+			break;
+	}
+
+	convert_from_float_scalar(bytes + j * sample_format_bytes(format), in + j, format, count - j);
+}
+
+const KernelTable kernels_sse2 = {
+	.name = "sse2",
+	.comb = kernel_comb_sse2,
+	.comb_bank = kernel_comb_bank_sse2,
+	.hadamard = kernel_hadamard_sse2,
+	.interleave = kernel_interleave_sse2,
+	.deinterleave = kernel_deinterleave_sse2,
+	.all_pass = kernel_all_pass_sse2,
+	.accumulate = kernel_accumulate_sse2,
+	.complex_mac = kernel_complex_mac_sse2,
+	.peak = kernel_peak_sse2,
+	.to_float = convert_to_float_sse2,
+	.from_float = convert_from_float_sse2
+};
+
+#endif
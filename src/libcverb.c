@@ -0,0 +1,165 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Public engine interface of libcverb. Wraps the per-channel reverbs of
+	multichannel.c behind an opaque handle, so that programs embedding the
+	library only ever see create, process, reset and destroy.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+
+/* Header files */
+#include "libcverb.h"
+#include "multichannel.h"
+#include "constants.h"
+
+/* Everything one engine owns. Nothing here is shared between engines. */
+struct CVerbEngine
+{
+	CVerbConfig config;							// Copy of the caller's config, spec points at it
+	ReverbSpec spec;
+	ImpulseResponse *rendered;			// Response of the network, if the convolution engine was given none
+	unsigned int sample_rate;
+	int channels;
+	int threads;
+	CVerbMulti *multi;
+};
+
+/*
+		Creates a reverb engine for an interleaved stream. The config is
+		copied, so it may be changed or freed once this returns.
+
+		engine: Reverb algorithm.
+		config: Parameters of the reverb.
+		ir: Impulse response of the convolution engine, NULL to convolve with
+		    the response of the comb/all pass network. Borrowed, it has to
+		    outlive the engine.
+		sample_rate: Sample rate of the stream [Hz].
+		channels: Amount of interleaved channels, each gets its own reverb.
+		threads: Amount of threads to spread the channels over, including
+		         the calling thread.
+
+		returns: Pointer to the new CVerbEngine, or NULL if it could not be
+		         created, such as for a config that fails config_check.
+*/
+CVerbEngine *cverb_engine_create(EngineType engine, const CVerbConfig *config, const ImpulseResponse *ir,
+                                 unsigned int sample_rate, int channels, int threads)
+{
+	if (config_check(config, sample_rate) != 0)
+	{
+		return NULL;
+	}
+
+	CVerbEngine *created = malloc(sizeof(CVerbEngine));
+	if (created == NULL)
+	{
+		return NULL;
+	}
+
+	created->config = *config;
+	created->spec.engine = engine;
+	created->spec.config = &created->config;
+	created->spec.ir = ir;
+	created->rendered = NULL;
+	created->sample_rate = sample_rate;
+	created->channels = channels > 0 ? channels : 1;
+	created->threads = threads;
+
+	if (engine == ENGINE_CONVOLUTION && ir == NULL)
+	{
+		created->rendered = ir_render(&created->config, sample_rate);
+		created->spec.ir = created->rendered;
+		if (created->rendered == NULL)
+		{
+			free(created);
+			return NULL;
+		}
+	}
+
+	created->multi = cverb_multi_create(created->channels, sample_rate, &created->spec, BLOCK_FRAMES, threads);
+	if (created->multi == NULL)
+	{
+		if (created->rendered != NULL)
+		{
+			ir_free(created->rendered);
+		}
+		free(created);
+		return NULL;
+	}
+
+	return created;
+}
+
+/*
+		Runs interleaved frames through the reverb. Floats are on any scale,
+		the engines are linear. Only the silence bypass depends on the
+		scale: config->silence is a level on the scale of the floats, and
+		config_init leaves it off.
+
+		engine: Engine created by cverb_engine_create.
+		in: Interleaved input samples.
+		out: Interleaved output samples, delayed by cverb_engine_latency
+		     frames (may not alias in).
+		frames: Amount of frames (samples per channel). Any length is accepted.
+*/
+void cverb_engine_process(CVerbEngine *engine, const float *in, float *out, size_t frames)
+{
+	size_t done = 0;
+
+	// The per-channel buffers hold BLOCK_FRAMES frames
+	while (done < frames)
+	{
+		size_t block = frames - done < BLOCK_FRAMES ? frames - done : BLOCK_FRAMES;
+		size_t offset = done * engine->channels;
+
+		cverb_multi_process(engine->multi, in + offset, out + offset, block);
+		done += block;
+	}
+}
+
+/*
+		Returns the amount of frames the output lags behind the input.
+
+		engine: Engine created by cverb_engine_create.
+*/
+int cverb_engine_latency(const CVerbEngine *engine)
+{
+	return engine->multi->latency;
+}
+
+/*
+		Silences every delay line, so the next stream starts without the
+		tail of the previous one.
+
+		engine: Engine created by cverb_engine_create.
+
+		returns: 0 on success, -1 if the delay lines could not be allocated
+		         again. The engine must then only be destroyed.
+*/
+int cverb_engine_reset(CVerbEngine *engine)
+{
+	// Fresh reverbs start out silent, whatever the engine keeps in its lines
+	cverb_multi_free(engine->multi);
+	engine->multi = cverb_multi_create(engine->channels, engine->sample_rate, &engine->spec, BLOCK_FRAMES, engine->threads);
+
+	return engine->multi != NULL ? 0 : -1;
+}
+
+/*
+		Stops the worker threads of an engine and frees everything it owns.
+
+		engine: Engine created by cverb_engine_create.
+*/
+void cverb_engine_destroy(CVerbEngine *engine)
+{
+	if (engine->multi != NULL)
+	{
+		cverb_multi_free(engine->multi);
+	}
+	if (engine->rendered != NULL)
+	{
+		ir_free(engine->rendered);
+	}
+	free(engine);
+}
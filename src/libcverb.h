@@ -0,0 +1,91 @@
+#ifndef LIBCVERB
+#define LIBCVERB
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "config.h"
+#include "reverb.h"
+#include "ir.h"
+
+/*
+		Public interface of libcverb (make libcverb.a libcverb.so).
+
+		A CVerbEngine owns every delay line, buffer and worker thread of one
+		reverb, and nothing in the library is global apart from the choice
+		of kernels (kernels.h), made once per process, so a process can run
+		as many engines as it likes side by side, one per stream. A single
+		engine must only be used by one thread at a time.
+
+		CVerbConfig config;
+		config_init(&config);
+		CVerbEngine *engine = cverb_engine_create(ENGINE_SCHROEDER, &config, NULL, 48000, 2, 1);
+		cverb_engine_process(engine, in, out, frames);
+		cverb_engine_destroy(engine);
+
+		Many mono streams with the same config are cheaper to run together
+		in one CVerbStreams (streams.h), which is part of the library too,
+		like CVerbLive (live.h), a block engine that a control thread can
+		retune while the audio thread runs it.
+*/
+typedef struct CVerbEngine CVerbEngine;
+
+/*
+		Creates a reverb engine for an interleaved stream. The config is
+		copied, so it may be changed or freed once this returns.
+
+		engine: Reverb algorithm.
+		config: Parameters of the reverb.
+		ir: Impulse response of the convolution engine, NULL to convolve with
+		    the response of the comb/all pass network. Borrowed, it has to
+		    outlive the engine.
+		sample_rate: Sample rate of the stream [Hz].
+		channels: Amount of interleaved channels, each gets its own reverb.
+		threads: Amount of threads to spread the channels over, including
+		         the calling thread.
+
+		returns: Pointer to the new CVerbEngine, or NULL if it could not be
+		         created, such as for a config that fails config_check.
+*/
+CVerbEngine *cverb_engine_create(EngineType engine, const CVerbConfig *config, const ImpulseResponse *ir,
+                                 unsigned int sample_rate, int channels, int threads);
+
+/*
+		Runs interleaved frames through the reverb. Floats are on any scale,
+		the engines are linear. Only the silence bypass depends on the
+		scale: config->silence is a level on the scale of the floats, and
+		config_init leaves it off.
+
+		engine: Engine created by cverb_engine_create.
+		in: Interleaved input samples.
+		out: Interleaved output samples, delayed by cverb_engine_latency
+		     frames (may not alias in).
+		frames: Amount of frames (samples per channel). Any length is accepted.
+*/
+void cverb_engine_process(CVerbEngine *engine, const float *in, float *out, size_t frames);
+
+/*
+		Returns the amount of frames the output lags behind the input.
+
+		engine: Engine created by cverb_engine_create.
+*/
+int cverb_engine_latency(const CVerbEngine *engine);
+
+/*
+		Silences every delay line, so the next stream starts without the
+		tail of the previous one.
+
+		engine: Engine created by cverb_engine_create.
+
+		returns: 0 on success, -1 if the delay lines could not be allocated
+		         again. The engine must then only be destroyed.
+*/
+int cverb_engine_reset(CVerbEngine *engine);
+
+/*
+		Stops the worker threads of an engine and frees everything it owns.
+
+		engine: Engine created by cverb_engine_create.
+*/
+void cverb_engine_destroy(CVerbEngine *engine);
+#endif
@@ -0,0 +1,121 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Live parameter updates for the block engine. A control thread
+	publishes configs through a lock-free triple buffer and the audio
+	thread ramps to them between blocks.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Header files */
+#include "live.h"
+
+#define LIVE_FRESH 4 // Set in middle when it holds a config the audio thread has not picked up
+#define LIVE_SLOT 3 // Mask of the slot index in middle
+
+/*
+		Creates a live block engine for the given parameters and sample rate.
+		Set config->max_delay_ms to the longest delay it will be retuned to.
+
+		config: Parameters the engine starts with.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CVerbLive, or NULL (after printing why)
+		         if the config asks for a comb bank or fails config_check, or
+		         if the delay lines could not be allocated.
+*/
+CVerbLive *cverb_live_create(const CVerbConfig *config, unsigned int sample_rate)
+{
+	if (config_check(config, sample_rate) != 0)
+	{
+		return NULL;
+	}
+	if (config->bank_combs > 0)
+	{
+		fprintf(stderr, "live: the comb bank is not supported\n");
+		return NULL;
+	}
+
+	CVerbLive *live = malloc(sizeof(CVerbLive));
+	live->state = cverb_state_create(config, sample_rate);
+	if (live->state == NULL)
+	{
+		free(live);
+		return NULL;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		live->slots[i] = *config;
+	}
+	live->front = 0;
+	live->back = 1;
+	atomic_init(&live->middle, 2);
+	atomic_init(&live->applied, 0);
+
+	return live;
+}
+
+/*
+		Control thread: hands a new config to the audio thread. Returns at
+		once, without locks or allocation. Only one thread may publish.
+
+		live: Engine created by cverb_live_create.
+		config: Parameters to retune to, copied.
+
+		returns: 0 once the config is published, -1 if it changes more than
+		         gains and delays or its delay is longer than the lines
+		         allow (see cverb_state_can_retune).
+*/
+int cverb_live_publish(CVerbLive *live, const CVerbConfig *config)
+{
+	// Rejected here, on the control thread, so the audio thread never sees a config it can not use
+	if (!cverb_state_can_retune(live->state, config))
+	{
+		return -1;
+	}
+
+	// The exchange releases the copy to the audio thread and takes over whichever slot was in the middle
+	live->slots[live->back] = *config;
+	live->back = atomic_exchange(&live->middle, live->back | LIVE_FRESH) & LIVE_SLOT;
+
+	return 0;
+}
+
+/*
+		Audio thread: picks up the latest published config and runs a block
+		of samples through the engine. Never locks or allocates.
+
+		live: Engine created by cverb_live_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void cverb_live_process(CVerbLive *live, const float *in, float *out, size_t frames)
+{
+	// A config published during a ramp waits in the middle slot until the ramp is over
+	if (live->state->ramp_length == 0 && (atomic_load(&live->middle) & LIVE_FRESH))
+	{
+		live->front = atomic_exchange(&live->middle, live->front) & LIVE_SLOT;
+		if (cverb_state_retune(live->state, &live->slots[live->front]) == 0)
+		{
+			atomic_fetch_add(&live->applied, 1);
+		}
+	}
+
+	cverb_process_block(live->state, in, out, frames);
+}
+
+/*
+		Frees a live engine. Neither thread may be using it.
+
+		live: Engine created by cverb_live_create.
+*/
+void cverb_live_free(CVerbLive *live)
+{
+	cverb_state_free(live->state);
+	free(live);
+}
@@ -0,0 +1,79 @@
+#ifndef LIVE
+#define LIVE
+/* Libraries */
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* Header files */
+#include "engine.h"
+#include "config.h"
+
+/* Struct which lets a control thread retune a block engine while an
+	 audio thread runs it, without either of them ever waiting.
+
+	 Configs travel through a triple buffer. The control thread writes
+	 into its back slot and swaps it with the middle slot, the audio
+	 thread swaps its front slot with the middle one whenever the middle
+	 holds a config it has not seen yet. Both swaps are one atomic
+	 exchange, so neither thread takes a lock, and each slot is only ever
+	 touched by the thread that holds it. Configs published faster than
+	 the audio thread picks them up replace each other, the latest wins.
+
+	 The audio thread picks a config up at the start of a block, once the
+	 ramp of the previous one is over, and hands it to cverb_state_retune,
+	 which ramps the gains and crossfades the delays without allocating.
+*/
+typedef struct
+{
+	CVerbState *state;
+	CVerbConfig slots[3];
+	int front;													// Slot of the config the audio thread runs, only it touches this
+	int back;														// Slot the control thread fills next, only it touches this
+	atomic_int middle;									// Slot in between, LIVE_FRESH is set while it holds an unseen config
+	atomic_uint applied;								// Amount of configs the audio thread has started ramping to
+} CVerbLive;
+
+/*
+		Creates a live block engine for the given parameters and sample rate.
+		Set config->max_delay_ms to the longest delay it will be retuned to.
+
+		config: Parameters the engine starts with.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+
+		returns: Pointer to the new CVerbLive, or NULL (after printing why)
+		         if the config asks for a comb bank or fails config_check, or
+		         if the delay lines could not be allocated.
+*/
+CVerbLive *cverb_live_create(const CVerbConfig *config, unsigned int sample_rate);
+
+/*
+		Control thread: hands a new config to the audio thread. Returns at
+		once, without locks or allocation. Only one thread may publish.
+
+		live: Engine created by cverb_live_create.
+		config: Parameters to retune to, copied.
+
+		returns: 0 once the config is published, -1 if it changes more than
+		         gains and delays or its delay is longer than the lines
+		         allow (see cverb_state_can_retune).
+*/
+int cverb_live_publish(CVerbLive *live, const CVerbConfig *config);
+
+/*
+		Audio thread: picks up the latest published config and runs a block
+		of samples through the engine. Never locks or allocates.
+
+		live: Engine created by cverb_live_create.
+		in: Input samples.
+		out: Output samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void cverb_live_process(CVerbLive *live, const float *in, float *out, size_t frames);
+
+/*
+		Frees a live engine. Neither thread may be using it.
+
+		live: Engine created by cverb_live_create.
+*/
+void cverb_live_free(CVerbLive *live);
+#endif
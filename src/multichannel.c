@@ -0,0 +1,245 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Multichannel processing. Each channel of an interleaved stream is
+	an independent mono signal, so it gets its own reverb state and the
+	channels can be processed in parallel.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Header files */
+#include "multichannel.h"
+
+/* Argument handed to each worker thread */
+struct MultiWorker
+{
+	CVerbMulti *multi;
+	int index;		// 0 is the calling thread, workers start at 1
+};
+
+/*
+		Deinterleaves and processes every channel which belongs to the given
+		thread index. Channels are dealt out round robin over the threads.
+*/
+static void process_channels(CVerbMulti *multi, int index)
+{
+	int threads = multi->num_workers + 1;
+
+	for (int c = index; c < multi->channels; c += threads)
+	{
+		float *planar = multi->planar_in[c];
+
+		for (size_t i = 0; i < multi->frames; i++)
+		{
+			planar[i] = multi->in[i * multi->channels + c];
+		}
+
+		reverb_process(multi->reverbs[c], planar, multi->planar_out[c], multi->frames);
+	}
+}
+
+/*
+		Body of a worker thread. Waits for a new block, processes its share
+		of the channels and reports back until told to stop.
+*/
+static void *worker_main(void *arg)
+{
+	struct MultiWorker *worker = arg;
+	CVerbMulti *multi = worker->multi;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&multi->lock);
+	while (1)
+	{
+		while (!multi->stop && multi->generation == seen)
+		{
+			pthread_cond_wait(&multi->start, &multi->lock);
+		}
+		if (multi->stop)
+		{
+			break;
+		}
+		seen = multi->generation;
+		pthread_mutex_unlock(&multi->lock);
+
+		process_channels(multi, worker->index);
+
+		pthread_mutex_lock(&multi->lock);
+		if (--multi->pending == 0)
+		{
+			pthread_cond_signal(&multi->done);
+		}
+	}
+	pthread_mutex_unlock(&multi->lock);
+
+	return NULL;
+}
+
+/*
+		Creates one reverb per channel of an interleaved stream.
+
+		channels: Amount of interleaved channels.
+		sample_rate: Sample rate of the stream [Hz].
+		spec: Which engine to use and its parameters.
+		max_frames: Largest amount of frames that will be passed to
+		            cverb_multi_process at once.
+		threads: Amount of threads to spread the channels over, including
+		         the calling thread. Values below 2 process every channel
+		         on the calling thread.
+
+		returns: Pointer to the new CVerbMulti, or NULL if a reverb could
+		         not be created.
+*/
+CVerbMulti *cverb_multi_create(int channels, unsigned int sample_rate, const ReverbSpec *spec, size_t max_frames, int threads)
+{
+	CVerbMulti *multi = malloc(sizeof(CVerbMulti));
+	multi->channels = channels > 0 ? channels : 1;
+	multi->max_frames = max_frames;
+
+	multi->reverbs = malloc(multi->channels * sizeof(Reverb *));
+	multi->planar_in = malloc(multi->channels * sizeof(float *));
+	multi->planar_out = malloc(multi->channels * sizeof(float *));
+	for (int c = 0; c < multi->channels; c++)
+	{
+		multi->reverbs[c] = reverb_create(spec, sample_rate, c);
+		if (multi->reverbs[c] == NULL)
+		{
+			for (int i = 0; i < c; i++)
+			{
+				reverb_free(multi->reverbs[i]);
+				free(multi->planar_in[i]);
+				free(multi->planar_out[i]);
+			}
+			free(multi->reverbs);
+			free(multi->planar_in);
+			free(multi->planar_out);
+			free(multi);
+			return NULL;
+		}
+		multi->planar_in[c] = malloc(max_frames * sizeof(float));
+		multi->planar_out[c] = malloc(max_frames * sizeof(float));
+	}
+	multi->latency = multi->reverbs[0]->latency;
+
+	// More threads than channels would only sit idle
+	if (threads > multi->channels)
+	{
+		threads = multi->channels;
+	}
+	multi->num_workers = threads > 1 ? threads - 1 : 0;
+	multi->generation = 0;
+	multi->pending = 0;
+	multi->stop = 0;
+	multi->in = NULL;
+	multi->frames = 0;
+	pthread_mutex_init(&multi->lock, NULL);
+	pthread_cond_init(&multi->start, NULL);
+	pthread_cond_init(&multi->done, NULL);
+
+	multi->workers = malloc(multi->num_workers * sizeof(pthread_t));
+	multi->worker_args = malloc(multi->num_workers * sizeof(struct MultiWorker));
+	for (int i = 0; i < multi->num_workers; i++)
+	{
+		multi->worker_args[i].multi = multi;
+		multi->worker_args[i].index = i + 1;
+		if (pthread_create(&multi->workers[i], NULL, worker_main, &multi->worker_args[i]) != 0)
+		{
+			// Carry on with the threads we managed to start
+			multi->num_workers = i;
+			break;
+		}
+	}
+
+	return multi;
+}
+
+/*
+		Runs a block of interleaved frames through the reverb of each channel.
+
+		multi: Multichannel reverb created by cverb_multi_create.
+		in: Interleaved input samples.
+		out: Interleaved output samples, delayed by multi->latency frames.
+		frames: Amount of frames (samples per channel), at most max_frames.
+*/
+void cverb_multi_process(CVerbMulti *multi, const float *in, float *out, size_t frames)
+{
+	// Mono needs no (de)interleaving at all
+	if (multi->channels == 1)
+	{
+		reverb_process(multi->reverbs[0], in, out, frames);
+		return;
+	}
+
+	multi->in = in;
+	multi->frames = frames;
+
+	if (multi->num_workers > 0)
+	{
+		pthread_mutex_lock(&multi->lock);
+		multi->pending = multi->num_workers;
+		multi->generation++;
+		pthread_cond_broadcast(&multi->start);
+		pthread_mutex_unlock(&multi->lock);
+	}
+
+	process_channels(multi, 0);
+
+	if (multi->num_workers > 0)
+	{
+		pthread_mutex_lock(&multi->lock);
+		while (multi->pending > 0)
+		{
+			pthread_cond_wait(&multi->done, &multi->lock);
+		}
+		pthread_mutex_unlock(&multi->lock);
+	}
+
+	// Interleave on this thread so workers never share output cache lines
+	for (int c = 0; c < multi->channels; c++)
+	{
+		const float *planar = multi->planar_out[c];
+
+		for (size_t i = 0; i < frames; i++)
+		{
+			out[i * multi->channels + c] = planar[i];
+		}
+	}
+}
+
+/*
+		Stops the worker threads and frees every reverb and buffer.
+
+		multi: Multichannel reverb created by cverb_multi_create.
+*/
+void cverb_multi_free(CVerbMulti *multi)
+{
+	pthread_mutex_lock(&multi->lock);
+	multi->stop = 1;
+	pthread_cond_broadcast(&multi->start);
+	pthread_mutex_unlock(&multi->lock);
+
+	for (int i = 0; i < multi->num_workers; i++)
+	{
+		pthread_join(multi->workers[i], NULL);
+	}
+
+	for (int c = 0; c < multi->channels; c++)
+	{
+		reverb_free(multi->reverbs[c]);
+		free(multi->planar_in[c]);
+		free(multi->planar_out[c]);
+	}
+
+	pthread_mutex_destroy(&multi->lock);
+	pthread_cond_destroy(&multi->start);
+	pthread_cond_destroy(&multi->done);
+	free(multi->workers);
+	free(multi->worker_args);
+	free(multi->reverbs);
+	free(multi->planar_in);
+	free(multi->planar_out);
+	free(multi);
+}
@@ -0,0 +1,73 @@
+#ifndef MULTICHANNEL
+#define MULTICHANNEL
+/* Libraries */
+#include <stddef.h>
+#include <pthread.h>
+
+/* Header files */
+#include "reverb.h"
+
+struct MultiWorker;
+
+/* Struct which runs one reverb per channel of an interleaved stream.
+
+	 Every channel gets its own Reverb. Interleaved frames are split
+	 into one planar buffer per channel, the channels are processed side
+	 by side on worker threads and the results are interleaved again.
+*/
+typedef struct
+{
+	int channels;
+	size_t max_frames;					// Largest block cverb_multi_process accepts
+	Reverb **reverbs;						// One reverb per channel
+	int latency;								// Samples the output lags behind the input
+	float **planar_in;					// Deinterleaved input, one buffer per channel
+	float **planar_out;					// Processed output, one buffer per channel
+
+	int num_workers;						// Worker threads besides the calling thread
+	pthread_t *workers;
+	struct MultiWorker *worker_args;
+	pthread_mutex_t lock;
+	pthread_cond_t start;				// Signalled when a new block is ready
+	pthread_cond_t done;				// Signalled when a worker finished its channels
+	unsigned long generation;		// Counts blocks handed to the workers
+	int pending;								// Workers still busy with the current block
+	const float *in;						// Interleaved input of the current block
+	size_t frames;							// Length of the current block
+	int stop;										// Tells the workers to exit
+} CVerbMulti;
+
+/*
+		Creates one reverb per channel of an interleaved stream.
+
+		channels: Amount of interleaved channels.
+		sample_rate: Sample rate of the stream [Hz].
+		spec: Which engine to use and its parameters.
+		max_frames: Largest amount of frames that will be passed to
+		            cverb_multi_process at once.
+		threads: Amount of threads to spread the channels over, including
+		         the calling thread. Values below 2 process every channel
+		         on the calling thread.
+
+		returns: Pointer to the new CVerbMulti, or NULL if a reverb could
+		         not be created.
+*/
+CVerbMulti *cverb_multi_create(int channels, unsigned int sample_rate, const ReverbSpec *spec, size_t max_frames, int threads);
+
+/*
+		Runs a block of interleaved frames through the reverb of each channel.
+
+		multi: Multichannel reverb created by cverb_multi_create.
+		in: Interleaved input samples.
+		out: Interleaved output samples, delayed by multi->latency frames.
+		frames: Amount of frames (samples per channel), at most max_frames.
+*/
+void cverb_multi_process(CVerbMulti *multi, const float *in, float *out, size_t frames);
+
+/*
+		Stops the worker threads and frees every reverb and buffer.
+
+		multi: Multichannel reverb created by cverb_multi_create.
+*/
+void cverb_multi_free(CVerbMulti *multi);
+#endif
@@ -15,20 +15,51 @@
 
 */
 ProcessingBuffer *construct_processing_buffer(WaveHeader *header)
+{
+		return construct_processing_buffer_length(PBUFF_LENGTH(header->sample_rate));
+}
+
+/*
+  Function that contructs and returns a pointer to a ProcessingBuffer struct
+  with room for the given amount of samples
+
+  length: Amount of samples the buffer holds
+
+  returns: Pointer to ProcessingBuffer struct
+
+*/
+ProcessingBuffer *construct_processing_buffer_length(int length)
 {
 		ProcessingBuffer *new = malloc(sizeof(ProcessingBuffer));
-		new->head = 0;
-		new->memSize = sizeof(float) * PBUFF_LENGTH;
-		new->length = PBUFF_LENGTH;
-		new->buffer = malloc(new->memSize);
+		pbuff_init_storage(new, malloc(sizeof(float) * length), length);
+
+		return new;
+}
+
+/*
+  Function that sets up a ProcessingBuffer on storage owned by the caller,
+  for example a slice of a larger arena. The storage is cleared. Buffers
+  set up this way must not be passed to pbuff_free.
+
+  pbuff: ProcessingBuffer struct to set up
+  storage: Room for length samples
+  length: Amount of samples the buffer holds. A power of two lets the
+          head wrap with a mask instead of a division.
+
+*/
+void pbuff_init_storage(ProcessingBuffer *pbuff, float *storage, int length)
+{
+		pbuff->buffer = storage;
+		pbuff->head = 0;
+		pbuff->memSize = sizeof(float) * length;
+		pbuff->length = length;
+		pbuff->mask = (length & (length - 1)) == 0 ? length - 1 : -1;
 
     /* Initialize processing buffer */
-    for (int i = 0; i < new->length; i++)
+    for (int i = 0; i < pbuff->length; i++)
     {
-      new->buffer[i] = 0;
+      pbuff->buffer[i] = 0;
     }
-
-		return new;
 }
 
 /*
@@ -100,6 +131,47 @@ void pbuff_update_head(ProcessingBuffer *pbuff)
     }
 }
 
+/*
+		Returns the index which lies delay samples behind the head,
+		wrapping around the start of the array.
+
+		pbuff: Pointer to ProcessingBuffer object.
+		delay: Amount of samples to look back, at most the length.
+*/
+int pbuff_delayed_index(ProcessingBuffer *pbuff, int delay)
+{
+    if (pbuff->mask >= 0)
+    {
+      return (pbuff->head - delay) & pbuff->mask;
+    }
+
+    int index = pbuff->head - delay;
+    if (index < 0)
+    {
+      index += pbuff->length;
+    }
+    return index;
+}
+
+/*
+		Moves the processing buffer's head forward by several
+		samples at once, wrapping around the end of the array.
+
+		pbuff: Pointer to ProcessingBuffer object.
+		count: Amount of samples to move the head by.
+*/
+void pbuff_advance_head(ProcessingBuffer *pbuff, int count)
+{
+    if (pbuff->mask >= 0)
+    {
+      pbuff->head = (pbuff->head + count) & pbuff->mask;
+    }
+    else
+    {
+      pbuff->head = (pbuff->head + count) % pbuff->length;
+    }
+}
+
 /*
 		Frees processing buffer object and its contents.
 
@@ -1,3 +1,5 @@
+#ifndef PBUFF
+#define PBUFF
 // Include libraries
 #include <stdio.h>
 
@@ -10,6 +12,7 @@ typedef struct
 	int memSize; // Amout of bytes allocated for the buffer
 	int length;  // Amount of indexes the buffer has
 	int head;
+	int mask;    // length - 1 if length is a power of two, -1 otherwise
 } ProcessingBuffer;
 
 /*
@@ -22,6 +25,30 @@ typedef struct
 */
 ProcessingBuffer *construct_processing_buffer(WaveHeader *header);
 
+/*
+  Function that contructs and returns a pointer to a ProcessingBuffer struct
+  with room for the given amount of samples
+
+  length: Amount of samples the buffer holds
+
+  returns: Pointer to ProcessingBuffer struct
+
+*/
+ProcessingBuffer *construct_processing_buffer_length(int length);
+
+/*
+  Function that sets up a ProcessingBuffer on storage owned by the caller,
+  for example a slice of a larger arena. The storage is cleared. Buffers
+  set up this way must not be passed to pbuff_free.
+
+  pbuff: ProcessingBuffer struct to set up
+  storage: Room for length samples
+  length: Amount of samples the buffer holds. A power of two lets the
+          head wrap with a mask instead of a division.
+
+*/
+void pbuff_init_storage(ProcessingBuffer *pbuff, float *storage, int length);
+
 /*
 		Puts value into the processing buffer at the location of the
 		"head" attribute of the struct.
@@ -65,9 +92,28 @@ int pbuff_get_head(ProcessingBuffer *pbuff);
 */
 void pbuff_update_head(ProcessingBuffer *pbuff);
 
+/*
+		Returns the index which lies delay samples behind the head,
+		wrapping around the start of the array.
+
+		pbuff: Pointer to ProcessingBuffer object.
+		delay: Amount of samples to look back, at most the length.
+*/
+int pbuff_delayed_index(ProcessingBuffer *pbuff, int delay);
+
+/*
+		Moves the processing buffer's head forward by several
+		samples at once, wrapping around the end of the array.
+
+		pbuff: Pointer to ProcessingBuffer object.
+		count: Amount of samples to move the head by.
+*/
+void pbuff_advance_head(ProcessingBuffer *pbuff, int count);
+
 /*
 		Frees processing buffer object and its contents.
 
 		pbuff: Pointer to ProcessingBuffer object.
 */
 void pbuff_free(ProcessingBuffer *pbuff);
+#endif
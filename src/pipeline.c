@@ -0,0 +1,482 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Pipelined rendering of a whole .wav file. Reading, processing and
+	writing run on three threads, connected by queues of blocks that go
+	round and round, so each thread only waits when the one before it
+	has fallen behind or every block is in flight.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+/* Header files */
+#include "pipeline.h"
+#include "wavio.h"
+#include "libcverb.h"
+#include "convert.h"
+#include "kernels.h"
+#include "spsc_buffer.h"
+#include "instrument.h"
+#include "constants.h"
+
+/* What the frames of a block are */
+typedef enum
+{
+	BLOCK_INPUT,		// Samples of the input
+	BLOCK_LATENCY,	// Silence that pushes the delayed output of the engine out
+	BLOCK_FLUSH,		// Silence that renders the tail past the input
+	BLOCK_END				// No frames, each thread passes it on and stops
+} BlockKind;
+
+/* One block of frames on its way through the pipeline */
+typedef struct
+{
+	BlockKind kind;
+	size_t frames;					// Frames in the block
+	float *in;							// Decoded input, up to BLOCK_FRAMES frames
+	float *out;							// Output of the engine
+	unsigned char *encoded;	// Output in the sample format of the output file
+	size_t offset;					// First output sample to write, later ones than the latency
+	size_t count;						// Amount of output samples to write
+} PipelineBlock;
+
+/* Queue of blocks from one thread to the next. Blocks travel through a lock
+	 free ring, the lock is only taken to sleep on an empty ring and to wake
+	 the thread sleeping on it. Every queue has room for all blocks, so
+	 putting never waits. */
+typedef struct
+{
+	PipelineBlock *slots[PIPELINE_BLOCKS];	// Storage of the ring
+	spsc_handle_t ring;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;								// Signalled after every put
+	size_t waits;													// Times the consumer found the ring empty
+	double wait_seconds;									// Time the consumer slept
+} PipelineQueue;
+
+/* Everything the three threads share */
+typedef struct
+{
+	PipelineQueue decoded;								// Reader to DSP thread
+	PipelineQueue processed;							// DSP thread to writer
+	PipelineQueue recycled;								// Writer back to reader
+	PipelineBlock blocks[PIPELINE_BLOCKS];
+	WavReader *reader;										// Only the reader thread touches this
+	WavWriter *writer;										// Only the writer thread touches this
+	SampleFormat in_format, out_format;
+	int passthrough;											// Float input rendered to float output is not converted
+	int streaming;												// The output is not a regular file, so every block is flushed
+	size_t channels;
+	size_t latency;												// Frames of silence that push the delayed output out
+	size_t flush;													// Most frames of silence the tail may take
+	size_t written;												// Blocks the writer has seen
+	atomic_int stop;											// Set once no more blocks are wanted
+	int failed;														// Set by the writer if writing the output failed
+	int error;														// errno of the writer when it failed
+} Pipeline;
+
+/*
+		Returns a monotonic time in seconds.
+*/
+static double now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void queue_init(PipelineQueue *queue)
+{
+	queue->ring = spsc_buf_init(queue->slots, sizeof(PipelineBlock *), PIPELINE_BLOCKS);
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->filled, NULL);
+	queue->waits = 0;
+	queue->wait_seconds = 0;
+}
+
+static void queue_free(PipelineQueue *queue)
+{
+	spsc_buf_free(queue->ring);
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->filled);
+}
+
+/*
+		Producer: appends a block to the queue.
+*/
+static void queue_put(PipelineQueue *queue, PipelineBlock *block)
+{
+	spsc_buf_put_range(queue->ring, &block, 1);
+
+	// A consumer checks the ring under the lock before it sleeps, so it either sees the block or gets the signal
+	pthread_mutex_lock(&queue->lock);
+	pthread_cond_signal(&queue->filled);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+		Consumer: takes the oldest block of the queue, sleeping until there is one.
+*/
+static PipelineBlock *queue_get(PipelineQueue *queue)
+{
+	PipelineBlock *block;
+
+	if (spsc_buf_get_range(queue->ring, &block, 1) == 1)
+	{
+		return block;
+	}
+
+	double start = now();
+	pthread_mutex_lock(&queue->lock);
+	while (spsc_buf_get_range(queue->ring, &block, 1) == 0)
+	{
+		pthread_cond_wait(&queue->filled, &queue->lock);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	queue->waits++;
+	queue->wait_seconds += now() - start;
+
+	return block;
+}
+
+/*
+		Reader thread: decodes the input into free blocks, followed by the
+		silence that pushes out the latency and renders the tail.
+*/
+static void *read_blocks(void *arg)
+{
+	Pipeline *pipeline = arg;
+	size_t channels = pipeline->channels;
+	size_t tail = pipeline->latency;
+	size_t flush = pipeline->flush;
+	int ended = 0;
+
+	while (1)
+	{
+		PipelineBlock *block = queue_get(&pipeline->recycled);
+		int stop = atomic_load(&pipeline->stop);
+		const void *samples;
+		size_t count = 0;
+
+		PROBE_START(read_timer);
+		if (!ended && !stop)
+		{
+			count = wav_reader_read(pipeline->reader, &samples, BLOCK_FRAMES * channels);
+		}
+
+		// Drop a trailing partial frame of a truncated file
+		block->frames = count / channels;
+		count = block->frames * channels;
+		ended |= block->frames == 0;
+
+		if (block->frames > 0)
+		{
+			block->kind = BLOCK_INPUT;
+			if (pipeline->passthrough)
+			{
+				memcpy(block->in, samples, count * sizeof(float));
+			}
+			else
+			{
+				convert_to_float(block->in, samples, pipeline->in_format, count);
+			}
+			PROBE_STOP(read_timer, PROBE_READ, count);
+		}
+		else if (!stop && tail > 0)
+		{
+			block->kind = BLOCK_LATENCY;
+			block->frames = tail < BLOCK_FRAMES ? tail : BLOCK_FRAMES;
+			tail -= block->frames;
+		}
+		else if (!stop && flush > 0)
+		{
+			block->kind = BLOCK_FLUSH;
+			block->frames = flush < BLOCK_FRAMES ? flush : BLOCK_FRAMES;
+			flush -= block->frames;
+		}
+		else
+		{
+			block->kind = BLOCK_END;
+		}
+
+		if (block->kind == BLOCK_LATENCY || block->kind == BLOCK_FLUSH)
+		{
+			memset(block->in, 0, block->frames * channels * sizeof(float));
+		}
+
+		// Once handed on, the block belongs to the next thread
+		BlockKind kind = block->kind;
+		queue_put(&pipeline->decoded, block);
+		if (kind == BLOCK_END)
+		{
+			return NULL;
+		}
+	}
+}
+
+/*
+		Writer thread: encodes and writes processed blocks, then hands them
+		back to the reader. Once writing failed, blocks are only handed back.
+*/
+static void *write_blocks(void *arg)
+{
+	Pipeline *pipeline = arg;
+
+	while (1)
+	{
+		PipelineBlock *block = queue_get(&pipeline->processed);
+		if (block->kind == BLOCK_END)
+		{
+			return NULL;
+		}
+
+		if (!pipeline->failed && block->count > 0)
+		{
+			const void *out = block->out + block->offset;
+			if (!pipeline->passthrough)
+			{
+				convert_from_float(block->encoded, block->out + block->offset, pipeline->out_format, block->count);
+				out = block->encoded;
+			}
+
+			PROBE_START(write_timer);
+			int written = wav_writer_write(pipeline->writer, out, block->count) == 0 &&
+			              (!pipeline->streaming || wav_writer_flush(pipeline->writer) == 0);
+			PROBE_STOP(write_timer, PROBE_WRITE, block->count);
+			if (!written)
+			{
+				pipeline->failed = 1;
+				pipeline->error = errno;
+				atomic_store(&pipeline->stop, 1);
+			}
+		}
+
+		pipeline->written++;
+		queue_put(&pipeline->recycled, block);
+	}
+}
+
+/*
+		DSP loop on the calling thread: runs decoded blocks through the engine,
+		with the same latency and tail handling as process_blocks(), and
+		hands them to the writer until the reader's BLOCK_END has passed.
+*/
+static void process_blocks_in_flight(Pipeline *pipeline, CVerbEngine *engine, const RenderOptions *options, unsigned int sample_rate)
+{
+	size_t channels = pipeline->channels;
+	size_t skip = pipeline->latency;
+	size_t quiet_frames = 0;
+	float loudest = 0;
+
+	while (1)
+	{
+		PipelineBlock *block = queue_get(&pipeline->decoded);
+		block->count = 0;
+
+		if (block->kind == BLOCK_FLUSH && quiet_frames >= TAIL_QUIET_SECONDS * sample_rate)
+		{
+			// The reader ran ahead of a tail that has turned quiet, the rest is not rendered
+			atomic_store(&pipeline->stop, 1);
+		}
+		else if (block->kind != BLOCK_END)
+		{
+			size_t frames = block->frames;
+			cverb_engine_process(engine, block->in, block->out, frames);
+
+			size_t drop = skip < frames ? skip : frames;
+			skip -= drop;
+			block->offset = drop * channels;
+			block->count = (frames - drop) * channels;
+
+			// The floor is set by the loudest output up to the end of the input
+			if (options->tail_db > 0 && block->kind != BLOCK_FLUSH)
+			{
+				float peak = kernel_peak(block->out + block->offset, block->count);
+				loudest = peak > loudest ? peak : loudest;
+			}
+			else if (block->kind == BLOCK_FLUSH)
+			{
+				float floor = loudest * (float) pow(10, -options->tail_db / 20);
+				quiet_frames = render_quiet_frames(block->out, frames, channels, floor, quiet_frames);
+			}
+		}
+
+		// The writer may recycle the block, and the reader reuse it, before put returns
+		BlockKind kind = block->kind;
+		queue_put(&pipeline->processed, block);
+		if (kind == BLOCK_END)
+		{
+			break;
+		}
+
+		INSTRUMENT_POLL();
+	}
+}
+
+/*
+		Renders a file like process_blocks(), with the same output byte for
+		byte, but reads, processes and writes on three threads, so a slow
+		disk or network share stalls neither the engine nor the other end.
+
+		A reader thread reads and decodes blocks, the calling thread runs
+		them through the engine, and a writer thread encodes and writes
+		them. PIPELINE_BLOCKS preallocated blocks circulate between the
+		three through lock free single producer, single consumer queues
+		(spsc_buffer.h) and are recycled by the writer, so nothing is
+		allocated while the file renders, and a reader that gets ahead
+		waits once every block is in flight. How long each thread waited is
+		added to options->stats.
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render. options->chunks is ignored.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the input format is not supported or the engine,
+		         its buffers or its threads could not be created.
+*/
+int process_pipelined (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options)
+{
+	size_t channels = header->channels > 0 ? header->channels : 1;
+	size_t block_samples = BLOCK_FRAMES * channels;
+	struct stat info;
+
+	SampleFormat in_format, out_format;
+	if (wav_sample_format(header, &in_format) != 0)
+	{
+		return -2;
+	}
+	out_format = options->out_format >= 0 ? (SampleFormat) options->out_format : in_format;
+	WaveHeader out_header = *header;
+	wav_set_sample_format(&out_header, out_format);
+
+	// Set up exactly like process_blocks(), so the output is the same
+	int passthrough = in_format == SAMPLE_F32 && out_format == SAMPLE_F32;
+	size_t available = wav_sample_count(in_file, header);
+	uint64_t data_size = WAV_UNKNOWN_SIZE;
+	if (available != SIZE_MAX && options->tail_db <= 0)
+	{
+		data_size = (uint64_t) (available / channels * channels) * sample_format_bytes(out_format);
+	}
+
+	CVerbEngine *engine = render_engine_create(header, options, passthrough);
+	if (engine == NULL)
+	{
+		return -2;
+	}
+	WavWriter *writer = wav_writer_open(out_file, &out_header, data_size);
+	if (writer == NULL)
+	{
+		cverb_engine_destroy(engine);
+		return -1;
+	}
+
+	Pipeline *pipeline = malloc(sizeof(Pipeline));
+	if (pipeline == NULL)
+	{
+		wav_writer_close(writer);
+		cverb_engine_destroy(engine);
+		return -2;
+	}
+
+	pipeline->reader = wav_reader_open(in_file, header);
+	pipeline->writer = writer;
+	pipeline->in_format = in_format;
+	pipeline->out_format = out_format;
+	pipeline->passthrough = passthrough;
+	pipeline->streaming = fstat(fileno(out_file), &info) != 0 || !S_ISREG(info.st_mode);
+	pipeline->channels = channels;
+	pipeline->latency = cverb_engine_latency(engine);
+	pipeline->flush = options->tail_db > 0 ? (size_t) IR_MAX_SECONDS * header->sample_rate : 0;
+	pipeline->written = 0;
+	pipeline->failed = 0;
+	pipeline->error = 0;
+	atomic_init(&pipeline->stop, 0);
+
+	// Every block starts out free, in the hands of the reader
+	queue_init(&pipeline->decoded);
+	queue_init(&pipeline->processed);
+	queue_init(&pipeline->recycled);
+	int allocated = 1;
+	for (int i = 0; i < PIPELINE_BLOCKS; i++)
+	{
+		PipelineBlock *block = &pipeline->blocks[i];
+		block->in = malloc(block_samples * sizeof(float));
+		block->out = malloc(block_samples * sizeof(float));
+		block->encoded = malloc(block_samples * sample_format_bytes(out_format));
+		allocated &= block->in != NULL && block->out != NULL && block->encoded != NULL;
+		spsc_buf_put_range(pipeline->recycled.ring, &block, 1);
+	}
+
+	// The writer starts first, so that if the reader can not start, a BLOCK_END
+	// taken from the free blocks (no other thread takes them) stops it again
+	pthread_t reader_thread, writer_thread;
+	int writing = allocated && pthread_create(&writer_thread, NULL, write_blocks, pipeline) == 0;
+	int reading = writing && pthread_create(&reader_thread, NULL, read_blocks, pipeline) == 0;
+	if (reading)
+	{
+		process_blocks_in_flight(pipeline, engine, options, header->sample_rate);
+		pthread_join(reader_thread, NULL);
+	}
+	else if (writing)
+	{
+		PipelineBlock *end = queue_get(&pipeline->recycled);
+		end->kind = BLOCK_END;
+		queue_put(&pipeline->processed, end);
+	}
+	if (writing)
+	{
+		pthread_join(writer_thread, NULL);
+	}
+
+	if (options->stats != NULL)
+	{
+		options->stats->blocks += pipeline->written;
+		options->stats->read_waits += pipeline->recycled.waits;
+		options->stats->read_wait_seconds += pipeline->recycled.wait_seconds;
+		options->stats->dsp_waits += pipeline->decoded.waits;
+		options->stats->dsp_wait_seconds += pipeline->decoded.wait_seconds;
+		options->stats->write_waits += pipeline->processed.waits;
+		options->stats->write_wait_seconds += pipeline->processed.wait_seconds;
+	}
+
+	int r = pipeline->failed ? -1 : !reading ? -2 : 0;
+	int error = pipeline->error;
+	if (wav_writer_close(writer) != 0)
+	{
+		r = -1;
+		error = errno;
+	}
+	wav_reader_close(pipeline->reader);
+	cverb_engine_destroy(engine);
+
+	for (int i = 0; i < PIPELINE_BLOCKS; i++)
+	{
+		free(pipeline->blocks[i].in);
+		free(pipeline->blocks[i].out);
+		free(pipeline->blocks[i].encoded);
+	}
+	queue_free(&pipeline->decoded);
+	queue_free(&pipeline->processed);
+	queue_free(&pipeline->recycled);
+	free(pipeline);
+
+	// errno is per thread, the caller gets the one of the failed write
+	if (r == -1)
+	{
+		errno = error;
+	}
+	return r;
+}
@@ -0,0 +1,34 @@
+#ifndef PIPELINE
+#define PIPELINE
+/* Libraries */
+#include <stdio.h>
+
+/* Header files */
+#include "wav.h"
+#include "render.h"
+
+/*
+		Renders a file like process_blocks(), with the same output byte for
+		byte, but reads, processes and writes on three threads, so a slow
+		disk or network share stalls neither the engine nor the other end.
+
+		A reader thread reads and decodes blocks, the calling thread runs
+		them through the engine, and a writer thread encodes and writes
+		them. PIPELINE_BLOCKS preallocated blocks circulate between the
+		three through lock free single producer, single consumer queues
+		(spsc_buffer.h) and are recycled by the writer, so nothing is
+		allocated while the file renders, and a reader that gets ahead
+		waits once every block is in flight. How long each thread waited is
+		added to options->stats.
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render. options->chunks is ignored.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the input format is not supported or the engine
+		         or its buffers could not be created.
+*/
+int process_pipelined (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options);
+#endif
@@ -0,0 +1,270 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Fixed size thread pool with work stealing. Tasks are coarse (whole
+	files), so every queue is simply protected by its own mutex.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Header files */
+#include "pool.h"
+
+/* A queued task */
+typedef struct
+{
+	pool_task_fn task;
+	void *arg;
+} PoolTask;
+
+/* Double ended task queue owned by one worker. The owner takes tasks from
+   the front, in the order they were submitted, other workers steal from
+   the back. */
+typedef struct
+{
+	pthread_mutex_t lock;
+	PoolTask *tasks;
+	size_t capacity;
+	size_t front;
+	size_t back;
+} PoolQueue;
+
+/* Argument handed to each worker thread */
+typedef struct
+{
+	ThreadPool *pool;
+	int index;
+} PoolWorker;
+
+struct ThreadPool
+{
+	int threads;						// Workers actually running
+	int num_queues;
+	pthread_t *workers;
+	PoolWorker *worker_args;
+	PoolQueue *queues;
+	int next_queue;					// Queue the next submitted task goes to
+
+	pthread_mutex_t lock;
+	pthread_cond_t work;		// Signalled when tasks are queued or the pool stops
+	pthread_cond_t idle;		// Signalled when the last unfinished task finishes
+	size_t queued;					// Tasks sitting in a queue
+	size_t unfinished;			// Tasks submitted but not finished
+	int stop;
+};
+
+/* Private functions */
+
+static void queue_push(PoolQueue *queue, PoolTask task)
+{
+	pthread_mutex_lock(&queue->lock);
+
+	if (queue->back == queue->capacity)
+	{
+		// Slide the live tasks to the start before growing
+		size_t count = queue->back - queue->front;
+		for (size_t i = 0; i < count; i++)
+		{
+			queue->tasks[i] = queue->tasks[queue->front + i];
+		}
+		queue->front = 0;
+		queue->back = count;
+
+		if (queue->back == queue->capacity)
+		{
+			queue->capacity = queue->capacity ? 2 * queue->capacity : 16;
+			queue->tasks = realloc(queue->tasks, queue->capacity * sizeof(PoolTask));
+		}
+	}
+	queue->tasks[queue->back++] = task;
+
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/* Takes a task from the front (owner) or the back (thief). Returns 0 on success. */
+static int queue_take(PoolQueue *queue, PoolTask *task, int steal)
+{
+	int r = -1;
+
+	pthread_mutex_lock(&queue->lock);
+	if (queue->back > queue->front)
+	{
+		*task = steal ? queue->tasks[--queue->back] : queue->tasks[queue->front++];
+		r = 0;
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	return r;
+}
+
+/* Finds a task for worker index, looking at its own queue first. Returns 0 on success. */
+static int find_task(ThreadPool *pool, int index, PoolTask *task)
+{
+	if (queue_take(&pool->queues[index], task, 0) == 0)
+	{
+		return 0;
+	}
+
+	for (int i = 1; i < pool->threads; i++)
+	{
+		if (queue_take(&pool->queues[(index + i) % pool->threads], task, 1) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static void *worker_main(void *arg)
+{
+	PoolWorker *worker = arg;
+	ThreadPool *pool = worker->pool;
+	PoolTask task;
+
+	while (1)
+	{
+		if (find_task(pool, worker->index, &task) == 0)
+		{
+			pthread_mutex_lock(&pool->lock);
+			pool->queued--;
+			pthread_mutex_unlock(&pool->lock);
+
+			task.task(task.arg);
+
+			pthread_mutex_lock(&pool->lock);
+			if (--pool->unfinished == 0)
+			{
+				pthread_cond_broadcast(&pool->idle);
+			}
+			pthread_mutex_unlock(&pool->lock);
+			continue;
+		}
+
+		// Nothing to run or steal, sleep until more tasks arrive
+		pthread_mutex_lock(&pool->lock);
+		while (pool->queued == 0 && !pool->stop)
+		{
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		int stop = pool->stop && pool->queued == 0;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (stop)
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* APIs */
+
+ThreadPool *pool_create(int threads)
+{
+	ThreadPool *pool = malloc(sizeof(ThreadPool));
+	pool->threads = threads > 0 ? threads : 1;
+	pool->next_queue = 0;
+	pool->queued = 0;
+	pool->unfinished = 0;
+	pool->stop = 0;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+
+	pool->queues = malloc(pool->threads * sizeof(PoolQueue));
+	pool->workers = malloc(pool->threads * sizeof(pthread_t));
+	pool->worker_args = malloc(pool->threads * sizeof(PoolWorker));
+	pool->num_queues = pool->threads;
+
+	for (int i = 0; i < pool->threads; i++)
+	{
+		pthread_mutex_init(&pool->queues[i].lock, NULL);
+		pool->queues[i].tasks = NULL;
+		pool->queues[i].capacity = 0;
+		pool->queues[i].front = 0;
+		pool->queues[i].back = 0;
+	}
+
+	for (int i = 0; i < pool->threads; i++)
+	{
+		pool->worker_args[i].pool = pool;
+		pool->worker_args[i].index = i;
+		if (pthread_create(&pool->workers[i], NULL, worker_main, &pool->worker_args[i]) != 0)
+		{
+			// Carry on with the workers we managed to start
+			pool->threads = i;
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void pool_submit(ThreadPool *pool, pool_task_fn task, void *arg)
+{
+	PoolTask entry = { task, arg };
+
+	// Without any workers the caller has to do the work itself
+	if (pool->threads == 0)
+	{
+		task(arg);
+		return;
+	}
+
+	// Count the task before it becomes visible so a worker can never take it first
+	pthread_mutex_lock(&pool->lock);
+	int index = pool->next_queue;
+	pool->next_queue = (pool->next_queue + 1) % pool->threads;
+	pool->unfinished++;
+	pool->queued++;
+	pthread_mutex_unlock(&pool->lock);
+
+	queue_push(&pool->queues[index], entry);
+
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait(ThreadPool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	while (pool->unfinished > 0)
+	{
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_free(ThreadPool *pool)
+{
+	pool_wait(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->threads; i++)
+	{
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	for (int i = 0; i < pool->num_queues; i++)
+	{
+		pthread_mutex_destroy(&pool->queues[i].lock);
+		free(pool->queues[i].tasks);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->idle);
+	free(pool->queues);
+	free(pool->workers);
+	free(pool->worker_args);
+	free(pool);
+}
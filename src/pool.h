@@ -0,0 +1,46 @@
+#ifndef POOL
+#define POOL
+
+/* Opaque thread pool structure */
+typedef struct ThreadPool ThreadPool;
+
+/* Function run by the pool for each task */
+typedef void (*pool_task_fn)(void *arg);
+
+/*
+		Starts a pool with a fixed amount of worker threads. Each worker owns a
+		queue of tasks. It runs tasks from its own queue first and steals from
+		the other queues once its own is empty, so a single long task never
+		leaves the other workers without anything to do.
+
+		threads: Amount of worker threads, at least 1.
+
+		returns: Pointer to the new ThreadPool.
+*/
+ThreadPool *pool_create(int threads);
+
+/*
+		Queues a task. Tasks are dealt out round robin over the worker queues
+		and each worker runs its own in the order they were submitted, so
+		submitting the longest tasks first spreads the work most evenly.
+
+		pool: Pool created by pool_create.
+		task: Function to run.
+		arg: Argument passed to task.
+*/
+void pool_submit(ThreadPool *pool, pool_task_fn task, void *arg);
+
+/*
+		Blocks until every submitted task has finished.
+
+		pool: Pool created by pool_create.
+*/
+void pool_wait(ThreadPool *pool);
+
+/*
+		Waits for all tasks, stops the workers and frees the pool.
+
+		pool: Pool created by pool_create.
+*/
+void pool_free(ThreadPool *pool);
+#endif
@@ -0,0 +1,283 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Per-sample reference implementation of the Schroeder reverb. It pushes
+	every sample through the whole network before reading the next one,
+	exactly like the original program, and is kept as the yardstick the
+	faster engines are measured and checked against. It only handles
+	monochannel files.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Header files */
+#include "reference.h"
+#include "circular_buffer.h"
+#include "wavio.h"
+#include "constants.h"
+#include "instrument.h"
+
+/*
+		Retrieves a sample from a circular buffer.
+
+		input: Circular buffer to take the sample from.
+		retreived: Pointer to variable which will
+							 store the retrieved sample.
+*/
+void retrieve_sample (cbuf_handle_t input, int16_t *retrieved)
+{
+		circular_buf_get(input, retrieved);
+}
+
+/*
+		Reads sample from the .wav file and stores it
+		in the circular buffer.
+
+		input: Circular buffer to store the sample in.
+		in_file: File object for the input .wav file.
+*/
+void buffer_sample(cbuf_handle_t input, FILE *in_file)
+{
+		int16_t toBuffer;
+
+		fread(&toBuffer, sizeof(toBuffer), 1, in_file);
+
+		circular_buf_put(input, toBuffer);
+}
+
+
+/*
+		Filter which calculates the output of NUM_COMB_FILTERS comb filters
+		for the sample that is marked by the head of the input buffer (pBuff_in).
+
+		sample_out: Variable to hold output of parellel comb filters.
+		pBuff_in: Processing buffer which stores input of comb filters.
+		pBuff_out Processing buffer which stores output of comb filters.
+		sample_rate: Sample rate of the sound file, turns the delays in
+		             constants.h into samples.
+*/
+void apply_comb_filter (float *sample_out, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, unsigned int sample_rate)
+{
+		int index;
+		*sample_out = FF_C * pbuff_get(pBuff_in, NULL);
+
+		// Each iteration of the for loop is applying a separate comb filter
+		for (int i = 0; i < NUM_COMB_FILTERS; i++)
+		{
+			// Index takes into account the delay from the pBuff head
+			index = pbuff_get_head(pBuff_out) - (int) COMB_TAP_SAMPLES(i+1, sample_rate);
+
+			// If the index goes beyond the lower bound of the array, wrap to the end
+			if(index < 0)
+			{
+				index = pbuff_get_length(pBuff_out) + index;
+			}
+
+			// Applies feedback
+			*sample_out += FB_C * pbuff_get(pBuff_out, &index);
+		}
+}
+
+/*
+		Applies a singular all pass filter at the sample pointed to by the head of the
+		input buffer.
+
+		sample_out: Variable to hold output of parellel comb filters.
+		pBuff_in: Processing buffer which stores input of comb filters.
+		pBuff_out Processing buffer which stores output of comb filters.
+		sample_rate: Sample rate of the sound file, turns the delays in
+		             constants.h into samples.
+*/
+void apply_all_pass_filter(float *output, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, unsigned int sample_rate)
+{
+	int index;
+	*output = 0;
+
+	// Index takes into account the delay from the pBuff head
+	index = pbuff_get_head(pBuff_out) - (int) DELAY_SAMPLES(sample_rate);
+
+	// If the index goes beyond the lower bound of the array, wrap to the end
+	if(index < 0)
+	{
+		index = pbuff_get_length(pBuff_out) + index;
+	}
+
+	// Applies feedback
+	*output += (-1)*FF_A*pbuff_get(pBuff_in, NULL);
+	*output += pbuff_get(pBuff_in, &index);
+	*output += FB_A*pbuff_get(pBuff_out, &index);
+}
+
+
+/*
+  	Proccess_data buffers a sample from in_file, retrieves that sample and
+		runs it through the comb filters and the all pass filters. The resulting
+		proccessed sample is then stored in the out_file.
+
+		in_file: Input .wav sound file.
+		out_file: Output .wav sound file with processed data.
+		state: Buffers of this render, created by reference_state_create.
+*/
+void process_data (FILE *in_file, FILE *out_file, ReferenceState *state)
+{
+		int16_t retrieved;
+		float sample_out;
+		int16_t to_load;
+		float comb_output;
+		float all_pass_output;
+
+		// Buffering a sample and then immediately retrieving it seems unnecessary, but it is to simulate
+		// getting samples from a live input (a guitar) instead of a wav file.
+		PROBE_START(read_timer);
+		buffer_sample(state->input, in_file);
+		retrieve_sample(state->input, &retrieved);
+		PROBE_STOP(read_timer, PROBE_READ, 1);
+
+		pbuff_put(state->in, (float) retrieved);
+
+		PROBE_START(comb_timer);
+		apply_comb_filter(&comb_output, state->in, state->comb_out, state->sample_rate);
+		PROBE_STOP(comb_timer, PROBE_COMB, 1);
+		pbuff_put(state->comb_out, comb_output);
+
+		// The all pass filters are in series, and every one of them is tapped for the output
+		sample_out = comb_output;
+		ProcessingBuffer *stage_in = state->comb_out;
+		for (int i = 0; i < NUM_ALL_PASS_FILTERS; i++)
+		{
+			PROBE_START(all_pass_timer);
+			apply_all_pass_filter(&all_pass_output, stage_in, state->all_pass[i], state->sample_rate);
+			PROBE_STOP(all_pass_timer, PROBE_ALL_PASS + i, 1);
+			pbuff_put(state->all_pass[i], all_pass_output);
+
+			sample_out += all_pass_output;
+			stage_in = state->all_pass[i];
+		}
+
+		pbuff_put(state->out, sample_out);
+
+		// Updates pointer to head in circular processing buffer (input)
+		pbuff_update_head(state->in);
+
+		// Update pointer to head in all pass filter functions
+		pbuff_update_head(state->comb_out);
+		for (int i = 0; i < NUM_ALL_PASS_FILTERS; i++)
+		{
+			pbuff_update_head(state->all_pass[i]);
+		}
+
+		// Updates pointer to head in circular processing buffer (output)
+		pbuff_update_head(state->out);
+
+		to_load = (int16_t) sample_out;
+
+		PROBE_START(write_timer);
+		fwrite(&to_load, sizeof(to_load), 1, out_file);
+		PROBE_STOP(write_timer, PROBE_WRITE, 1);
+
+		INSTRUMENT_POLL();
+}
+
+/*
+		Creates the buffers of the reference implementation for one sound file.
+
+		header: Struct that stores metadata of the sound file.
+		input_storage: Room for CIRC_BUFF_SIZE(header->bits_per_sample)
+		               samples, used by the input circular buffer.
+
+		returns: Pointer to the new ReferenceState.
+*/
+ReferenceState *reference_state_create(WaveHeader *header, int16_t *input_storage)
+{
+		ReferenceState *state = malloc(sizeof(ReferenceState));
+
+		state->input = circular_buf_init(input_storage, CIRC_BUFF_SIZE(header->bits_per_sample));
+		state->in = construct_processing_buffer(header);
+		state->comb_out = construct_processing_buffer(header);
+		for (int i = 0; i < NUM_ALL_PASS_FILTERS; i++)
+		{
+			state->all_pass[i] = construct_processing_buffer(header);
+		}
+		state->out = construct_processing_buffer(header);
+		state->sample_rate = header->sample_rate;
+
+		return state;
+}
+
+/*
+		Frees the buffers of the reference implementation. The storage of
+		the input circular buffer belongs to the caller.
+
+		state: State created by reference_state_create.
+*/
+void reference_state_free(ReferenceState *state)
+{
+		pbuff_free(state->in);
+		pbuff_free(state->comb_out);
+		for (int i = 0; i < NUM_ALL_PASS_FILTERS; i++)
+		{
+			pbuff_free(state->all_pass[i]);
+		}
+		pbuff_free(state->out);
+		circular_buf_free(state->input);
+		free(state);
+}
+
+/*
+		Adds reverb to the monochannel .wav file at in_path with the per-sample
+		reference implementation and writes the result to out_path.
+
+		in_path: Path of the input .wav file.
+		out_path: Path of the output .wav file.
+
+		returns: 0 on success, -1 if a file could not be opened or written.
+*/
+int render_reference (const char *in_path, const char *out_path)
+{
+		/* Open input file and create a new output file for the procesed signal */
+		FILE *in_file = fopen(in_path, "rb");
+		FILE *out_file = fopen(out_path, "w");
+		if (in_file == NULL || out_file == NULL)
+		{
+			perror(in_file == NULL ? in_path : out_path);
+			if (in_file != NULL)
+			{
+				fclose(in_file);
+			}
+			if (out_file != NULL)
+			{
+				fclose(out_file);
+			}
+			return -1;
+		}
+
+		/* Instantiate struct to hold header data of .wav file */
+		WaveHeader *header = malloc(sizeof(WaveHeader));
+
+		/* Parse header data from the .wav file */
+		parse_wav(in_file, out_file, header);
+
+		/* Create instance of circular buffer and the processing buffers */
+		int16_t buffOnStack[CIRC_BUFF_SIZE(header->bits_per_sample)];
+		ReferenceState *state = reference_state_create(header, buffOnStack);
+
+		// Stop at the end of the data chunk instead of relying on feof, which
+		// only turns true after a read has already failed
+		size_t samples = wav_sample_count(in_file, header);
+		for (size_t i = 0; i < samples; i++)
+		{
+			process_data(in_file, out_file, state);
+		}
+
+		// Close files
+		fclose(in_file);
+		int r = fclose(out_file) == 0 ? 0 : -1;
+
+		free(header);
+		reference_state_free(state);
+
+		return r;
+}
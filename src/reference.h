@@ -0,0 +1,107 @@
+#ifndef REFERENCE
+#define REFERENCE
+/* Libraries */
+#include <stdio.h>
+#include <stdint.h>
+
+/* Header files */
+#include "circular_buffer.h"
+#include "wav.h"
+#include "pbuff.h"
+#include "constants.h"
+
+/* Struct which holds every buffer the reference implementation keeps
+   between samples, so that several renders can run at the same time */
+typedef struct
+{
+	cbuf_handle_t input;											// Input circular buffer, simulates a live input
+	ProcessingBuffer *in;											// Input of the comb filters
+	ProcessingBuffer *comb_out;								// Output of the parallel comb filters
+	ProcessingBuffer *all_pass[NUM_ALL_PASS_FILTERS];	// Output of each all pass filter
+	ProcessingBuffer *out;										// Output of the DSP system
+	unsigned int sample_rate;									// Turns the delays in constants.h into samples
+} ReferenceState;
+
+/*
+		Retrieves a sample from a circular buffer.
+
+		input: Circular buffer to take the sample from.
+		retreived: Pointer to variable which will
+							 store the retrieved sample.
+*/
+void retrieve_sample (cbuf_handle_t input, int16_t *retrieved);
+
+/*
+		Reads sample from the .wav file and stores it
+		in the circular buffer.
+
+		input: Circular buffer to store the sample in.
+		in_file: File object for the input .wav file.
+*/
+void buffer_sample(cbuf_handle_t input, FILE *in_file);
+
+/*
+		Filter which calculates the output of NUM_COMB_FILTERS comb filters
+		for the sample that is marked by the head of the input buffer (pBuff_in).
+
+		sample_out: Variable to hold output of parellel comb filters.
+		pBuff_in: Processing buffer which stores input of comb filters.
+		pBuff_out Processing buffer which stores output of comb filters.
+		sample_rate: Sample rate of the sound file, turns the delays in
+		             constants.h into samples.
+*/
+void apply_comb_filter (float *sample_out, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, unsigned int sample_rate);
+
+/*
+		Applies a singular all pass filter at the sample pointed to by the head of the
+		input buffer.
+
+		sample_out: Variable to hold output of parellel comb filters.
+		pBuff_in: Processing buffer which stores input of comb filters.
+		pBuff_out Processing buffer which stores output of comb filters.
+		sample_rate: Sample rate of the sound file, turns the delays in
+		             constants.h into samples.
+*/
+void apply_all_pass_filter(float *output, ProcessingBuffer *pBuff_in, ProcessingBuffer *pBuff_out, unsigned int sample_rate);
+
+/*
+  	Proccess_data buffers a sample from in_file, retrieves that sample and
+		runs it through the comb filters and the all pass filters. The resulting
+		proccessed sample is then stored in the out_file.
+
+		in_file: Input .wav sound file.
+		out_file: Output .wav sound file with processed data.
+		state: Buffers of this render, created by reference_state_create.
+*/
+void process_data (FILE *in_file, FILE *out_file, ReferenceState *state);
+
+/*
+		Creates the buffers of the reference implementation for one sound file.
+
+		header: Struct that stores metadata of the sound file.
+		input_storage: Room for CIRC_BUFF_SIZE(header->bits_per_sample)
+		               samples, used by the input circular buffer.
+
+		returns: Pointer to the new ReferenceState.
+*/
+ReferenceState *reference_state_create(WaveHeader *header, int16_t *input_storage);
+
+/*
+		Frees the buffers of the reference implementation. The storage of
+		the input circular buffer belongs to the caller.
+
+		state: State created by reference_state_create.
+*/
+void reference_state_free(ReferenceState *state);
+
+/*
+		Adds reverb to the monochannel .wav file at in_path with the per-sample
+		reference implementation and writes the result to out_path.
+
+		in_path: Path of the input .wav file.
+		out_path: Path of the output .wav file.
+
+		returns: 0 on success, -1 if a file could not be opened or written.
+*/
+int render_reference (const char *in_path, const char *out_path);
+#endif
@@ -0,0 +1,409 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Renders a whole .wav file through the block engine. Nothing in here
+	is shared between calls, so files can be rendered side by side.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+/* Header files */
+#include "render.h"
+#include "wavio.h"
+#include "libcverb.h"
+#include "chunked.h"
+#include "pipeline.h"
+#include "convert.h"
+#include "kernels.h"
+#include "constants.h"
+#include "instrument.h"
+
+/*
+		Returns how many frames at the end of a block of the tail are at or
+		below floor in every channel. If the whole block is, the quiet frames
+		before it count as well.
+
+		samples: Interleaved output of the block.
+		frames: Amount of frames in the block.
+		channels: Amount of interleaved channels.
+		floor: Level at or below which a sample is quiet.
+		quiet_before: Quiet frames at the end of the blocks before.
+*/
+size_t render_quiet_frames(const float *samples, size_t frames, size_t channels, float floor, size_t quiet_before)
+{
+	size_t quiet = 0;
+
+	for (; quiet < frames; quiet++)
+	{
+		const float *frame = samples + (frames - 1 - quiet) * channels;
+		for (size_t c = 0; c < channels; c++)
+		{
+			if (fabsf(frame[c]) > floor)
+			{
+				return quiet;
+			}
+		}
+	}
+
+	return quiet_before + frames;
+}
+
+/*
+		Creates the engine a render of the file runs through, and warns if
+		an impulse response does not match the sample rate of the audio.
+
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+		passthrough: Whether the samples stay on the float scale of the file
+		             instead of the 16-bit scale.
+
+		returns: Pointer to the new CVerbEngine, or NULL if it could not be created.
+*/
+CVerbEngine *render_engine_create(const WaveHeader *header, const RenderOptions *options, int passthrough)
+{
+		if (options->engine == ENGINE_CONVOLUTION && options->ir != NULL && options->ir->sample_rate != header->sample_rate)
+		{
+			fprintf(stderr, "warning: impulse response is %u Hz but the audio is %u Hz\n",
+			        options->ir->sample_rate, header->sample_rate);
+		}
+
+		// The silence level is on the 16-bit scale the samples are otherwise converted to
+		CVerbConfig config = options->config;
+		if (passthrough)
+		{
+			config.silence /= 32768;
+		}
+
+		// Without a given impulse response the convolution engine convolves with the network's
+		return cverb_engine_create(options->engine, &config, options->ir,
+		                           header->sample_rate, header->channels > 0 ? (int) header->channels : 1, options->threads);
+}
+
+/*
+		Writes a .wav header to out_file, then processes the samples of in_file
+		BLOCK_FRAMES frames at a time with the block engine and writes them to
+		out_file. Every channel is processed separately. The latency of the
+		engine is compensated, so the output lines up with the input. If
+		out_file is not a regular file every block is written as soon as it
+		is ready. Samples are converted from the format of the input to
+		options->out_format, float input rendered to float output is not
+		converted at all. The output is RF64 once it passes 4 GB (Wave64 if
+		the input is), and a regular output file whose length was not known
+		up front gets its header sizes filled in at the end. With
+		options->tail_db the reverb tail is rendered past the end of the
+		input, until it has stayed that many dB below the loudest output for
+		TAIL_QUIET_SECONDS (IR_MAX_SECONDS at most).
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the input format is not supported or the engine
+		         or its buffers could not be created.
+*/
+int process_blocks (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options)
+{
+		const void *samples;
+		size_t count;
+		size_t channels = header->channels > 0 ? header->channels : 1;
+		size_t block_samples = BLOCK_FRAMES * channels;
+		struct stat info;
+		int r = 0;
+
+		SampleFormat in_format, out_format;
+		if (wav_sample_format(header, &in_format) != 0)
+		{
+			return -2;
+		}
+		out_format = options->out_format >= 0 ? (SampleFormat) options->out_format : in_format;
+		WaveHeader out_header = *header;
+		wav_set_sample_format(&out_header, out_format);
+
+		// The engines are linear, so float samples can be rendered on their own scale
+		int passthrough = in_format == SAMPLE_F32 && out_format == SAMPLE_F32;
+
+		// The output has as many whole frames as the input. If that is not known
+		// up front the writer fills in the length once the input has ended.
+		size_t available = wav_sample_count(in_file, header);
+		uint64_t data_size = WAV_UNKNOWN_SIZE;
+		if (available != SIZE_MAX && options->tail_db <= 0)
+		{
+			data_size = (uint64_t) (available / channels * channels) * sample_format_bytes(out_format);
+		}
+		int streaming = fstat(fileno(out_file), &info) != 0 || !S_ISREG(info.st_mode);
+
+		CVerbEngine *engine = render_engine_create(header, options, passthrough);
+		if (engine == NULL)
+		{
+			return -2;
+		}
+		WavWriter *writer = wav_writer_open(out_file, &out_header, data_size);
+		if (writer == NULL)
+		{
+			cverb_engine_destroy(engine);
+			return -1;
+		}
+
+		unsigned char *to_load = malloc(block_samples * sample_format_bytes(out_format));
+		float *block_in = malloc(block_samples * sizeof(float));
+		float *block_out = malloc(block_samples * sizeof(float));
+		if (to_load == NULL || block_in == NULL || block_out == NULL)
+		{
+			r = -2;
+		}
+
+		WavReader *reader = wav_reader_open(in_file, header);
+
+		// A delayed engine is fed silence after the input ends and the same
+		// amount of output is dropped at the start, so nothing shifts in time
+		size_t skip = cverb_engine_latency(engine);
+		size_t tail = skip;
+
+		// After that, silence keeps coming until the tail has decayed below the floor
+		size_t flush = options->tail_db > 0 ? (size_t) IR_MAX_SECONDS * header->sample_rate : 0;
+		size_t quiet_frames = 0;
+		float loudest = 0;
+		int flushing = 0;
+
+		while (r == 0)
+		{
+			PROBE_START(read_timer);
+			count = wav_reader_read(reader, &samples, block_samples);
+			PROBE_STOP(read_timer, PROBE_READ, count);
+
+			// Drop a trailing partial frame of a truncated file
+			size_t frames = count / channels;
+			count = frames * channels;
+
+			const float *in = block_in;
+			if (frames == 0)
+			{
+				if (tail > 0)
+				{
+					frames = tail < BLOCK_FRAMES ? tail : BLOCK_FRAMES;
+					tail -= frames;
+				}
+				else if (flush > 0 && quiet_frames < TAIL_QUIET_SECONDS * header->sample_rate)
+				{
+					frames = flush < BLOCK_FRAMES ? flush : BLOCK_FRAMES;
+					flush -= frames;
+					flushing = 1;
+				}
+				else
+				{
+					break;
+				}
+				memset(block_in, 0, frames * channels * sizeof(float));
+			}
+			else if (passthrough && (uintptr_t) samples % sizeof(float) == 0)
+			{
+				in = samples;
+			}
+			else if (passthrough)
+			{
+				memcpy(block_in, samples, count * sizeof(float));
+			}
+			else
+			{
+				convert_to_float(block_in, samples, in_format, count);
+			}
+
+			cverb_engine_process(engine, in, block_out, frames);
+
+			size_t drop = skip < frames ? skip : frames;
+			skip -= drop;
+			count = (frames - drop) * channels;
+
+			// The floor is set by the loudest output up to the end of the input
+			if (options->tail_db > 0 && !flushing)
+			{
+				float peak = kernel_peak(block_out + drop * channels, count);
+				loudest = peak > loudest ? peak : loudest;
+			}
+			else if (flushing)
+			{
+				float floor = loudest * (float) pow(10, -options->tail_db / 20);
+				quiet_frames = render_quiet_frames(block_out, frames, channels, floor, quiet_frames);
+			}
+
+			const void *out = block_out + drop * channels;
+			if (!passthrough)
+			{
+				convert_from_float(to_load, block_out + drop * channels, out_format, count);
+				out = to_load;
+			}
+
+			PROBE_START(write_timer);
+			int written = wav_writer_write(writer, out, count) == 0 && (!streaming || wav_writer_flush(writer) == 0);
+			PROBE_STOP(write_timer, PROBE_WRITE, count);
+			if (!written)
+			{
+				r = -1;
+				break;
+			}
+
+			INSTRUMENT_POLL();
+		}
+
+		if (wav_writer_close(writer) != 0)
+		{
+			r = -1;
+		}
+		wav_reader_close(reader);
+		cverb_engine_destroy(engine);
+		free(to_load);
+		free(block_in);
+		free(block_out);
+
+		return r;
+}
+
+/*
+		Fills options with the default settings: one thread, no chunks, .wav input,
+		output in the format of the input, as long as the input, the comb/all
+		pass network with its default parameters, stages bypassed below
+		SILENCE_LEVEL on the 16-bit scale the samples are rendered at, and no
+		pipeline.
+
+		options: Settings to initialize.
+*/
+void render_options_init(RenderOptions *options)
+{
+		options->threads = 1;
+		options->chunks = 1;
+		options->raw_rate = 0;
+		options->raw_channels = 1;
+		config_init(&options->config);
+		options->config.silence = SILENCE_LEVEL;
+		options->engine = DEFAULT_ENGINE;
+		options->ir = NULL;
+		options->out_format = -1;
+		options->tail_db = 0;
+		options->pipelined = 0;
+		options->stats = NULL;
+}
+
+/*
+		Fills header for headerless 16-bit PCM input of unknown length.
+*/
+static void raw_header(WaveHeader *header, RenderOptions *options)
+{
+		memcpy(header->riff, "RIFF", 4);
+		memcpy(header->wave, "WAVE", 4);
+		memcpy(header->fmt_chunk_marker, "fmt ", 4);
+		memcpy(header->data_chunk_header, "data", 4);
+		header->overall_size = WAV_UNKNOWN_SIZE;
+		header->length_of_fmt = 16;
+		header->format_type = 1;
+		header->channels = options->raw_channels;
+		header->sample_rate = options->raw_rate;
+		header->bits_per_sample = 16;
+		header->block_align = header->channels * sizeof(int16_t);
+		header->byterate = header->sample_rate * header->block_align;
+		header->data_size = WAV_UNKNOWN_SIZE;
+}
+
+/*
+		Adds reverb to the .wav file at in_path and writes the result to out_path.
+		Everything the render needs is created and freed inside, so several
+		renders can run on different threads at the same time. out_path is
+		only created once the input has turned out to be a .wav file, and
+		never if it is the input itself.
+
+		in_path: Path of the input .wav file, "-" for standard input.
+		out_path: Path of the output .wav file, "-" for standard output.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 (after printing why) if a file could not
+		         be opened or written, out_path is in_path or the render could
+		         not be set up.
+*/
+int render_file (const char *in_path, const char *out_path, RenderOptions *options)
+{
+		int from_stdin = strcmp(in_path, "-") == 0;
+		int to_stdout = strcmp(out_path, "-") == 0;
+
+		FILE *in_file = from_stdin ? stdin : fopen(in_path, "rb");
+		if (in_file == NULL)
+		{
+			perror(in_path);
+			return -1;
+		}
+
+		WaveHeader header;
+		if (options->raw_rate != 0)
+		{
+			raw_header(&header, options);
+		}
+		else
+		{
+			memset(&header, 0, sizeof(header));
+			parse_wav(in_file, NULL, &header);
+		}
+
+		int r = 0;
+		SampleFormat format;
+		FILE *out_file = NULL;
+		struct stat in_info, out_info;
+		// parse_wav only gets as far as a data chunk in a RIFF, RF64 or Wave64 file
+		if (memcmp(header.data_chunk_header, "data", 4) != 0 || header.channels == 0)
+		{
+			fprintf(stderr, "%s: not a .wav file\n", in_path);
+			r = -1;
+		}
+		else if (wav_sample_format(&header, &format) != 0)
+		{
+			fprintf(stderr, "%s: unsupported sample format (format type %u, %u bits)\n",
+			        in_path, header.format_type, header.bits_per_sample);
+			r = -1;
+		}
+		// Opening the output truncates it, so it must not be the file being read
+		else if (!to_stdout && fstat(fileno(in_file), &in_info) == 0 && stat(out_path, &out_info) == 0 &&
+		         in_info.st_dev == out_info.st_dev && in_info.st_ino == out_info.st_ino)
+		{
+			fprintf(stderr, "%s: output would overwrite the input\n", out_path);
+			r = -1;
+		}
+		else if ((out_file = to_stdout ? stdout : fopen(out_path, "wb")) == NULL)
+		{
+			perror(out_path);
+			r = -1;
+		}
+		else
+		{
+			r = options->pipelined ? process_pipelined(in_file, out_file, &header, options) :
+			                         process_chunked(in_file, out_file, &header, options);
+			// errno only tells why when writing failed
+			if (r == -1)
+			{
+				perror(out_path);
+			}
+			else if (r != 0)
+			{
+				fprintf(stderr, "%s: the render could not be set up\n", out_path);
+				r = -1;
+			}
+		}
+
+		if (!from_stdin)
+		{
+			fclose(in_file);
+		}
+		if (!to_stdout && out_file != NULL && fclose(out_file) != 0)
+		{
+			if (r == 0)
+			{
+				perror(out_path);
+			}
+			r = -1;
+		}
+		return r;
+}
@@ -0,0 +1,118 @@
+#ifndef RENDER
+#define RENDER
+/* Libraries */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Header files */
+#include "wav.h"
+#include "config.h"
+#include "reverb.h"
+#include "ir.h"
+#include "libcverb.h"
+
+/* Struct which adds up how long each thread of pipelined renders (pipeline.h)
+	 waited for the others. The thread that waits least is the bottleneck. */
+typedef struct
+{
+	size_t blocks;							// Blocks that went through all three threads
+	size_t read_waits;					// Times the reader found every block taken, held back by the DSP or the writer
+	double read_wait_seconds;
+	size_t dsp_waits;						// Times the DSP thread found no decoded block, starved by the reader
+	double dsp_wait_seconds;
+	size_t write_waits;					// Times the writer found no processed block
+	double write_wait_seconds;
+} PipelineStats;
+
+/* Struct which collects the settings of a render */
+typedef struct
+{
+	int threads;								// Amount of threads the channels may be spread over
+	int chunks;									// If above 1 a single file is split into this many chunks rendered side by side
+	unsigned int raw_rate;			// If not 0 the input is headerless 16-bit PCM at this sample rate
+	unsigned int raw_channels;	// Amount of channels of headerless input
+	CVerbConfig config;					// Parameters of the reverb
+	EngineType engine;					// Reverb algorithm
+	const ImpulseResponse *ir;	// Impulse response of the convolution engine, NULL renders one from config
+	int out_format;							// SampleFormat of the output, -1 keeps the format of the input
+	double tail_db;							// If above 0 the tail is rendered past the input until this many dB below the loudest output
+	int pipelined;							// If set, reading, processing and writing run on three threads (pipeline.h)
+	PipelineStats *stats;				// If not NULL, pipelined renders add their waits here (one render at a time)
+} RenderOptions;
+
+/*
+		Fills options with the default settings: one thread, no chunks, .wav input,
+		output in the format of the input, as long as the input, the comb/all
+		pass network with its default parameters, stages bypassed below
+		SILENCE_LEVEL on the 16-bit scale the samples are rendered at, and no
+		pipeline.
+
+		options: Settings to initialize.
+*/
+void render_options_init(RenderOptions *options);
+
+/*
+		Creates the engine a render of the file runs through, and warns if
+		an impulse response does not match the sample rate of the audio.
+
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+		passthrough: Whether the samples stay on the float scale of the file
+		             instead of the 16-bit scale.
+
+		returns: Pointer to the new CVerbEngine, or NULL if it could not be created.
+*/
+CVerbEngine *render_engine_create(const WaveHeader *header, const RenderOptions *options, int passthrough);
+
+/*
+		Returns how many frames at the end of a block of the tail are at or
+		below floor in every channel. If the whole block is, the quiet frames
+		before it count as well.
+
+		samples: Interleaved output of the block.
+		frames: Amount of frames in the block.
+		channels: Amount of interleaved channels.
+		floor: Level at or below which a sample is quiet.
+		quiet_before: Quiet frames at the end of the blocks before.
+*/
+size_t render_quiet_frames(const float *samples, size_t frames, size_t channels, float floor, size_t quiet_before);
+
+/*
+		Writes a .wav header to out_file, then processes the samples of in_file
+		BLOCK_FRAMES frames at a time with the block engine and writes them to
+		out_file. Every channel is processed separately. The latency of the
+		engine is compensated, so the output lines up with the input. If
+		out_file is not a regular file every block is written as soon as it
+		is ready. Samples are converted from the format of the input to
+		options->out_format, float input rendered to float output is not
+		converted at all. With options->tail_db the reverb tail is rendered
+		past the end of the input, until it has decayed that far.
+
+		in_file: Input sound file, positioned at the start of the sample data.
+		out_file: Output .wav sound file with processed data.
+		header: Struct that stores metadata of the sound file.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 if writing the output failed (errno tells
+		         why), -2 if the input format is not supported or the engine
+		         or its buffers could not be created.
+*/
+int process_blocks (FILE *in_file, FILE *out_file, WaveHeader *header, RenderOptions *options);
+
+/*
+		Adds reverb to the .wav file at in_path and writes the result to out_path.
+		Everything the render needs is created and freed inside, so several
+		renders can run on different threads at the same time. out_path is
+		only created once the input has turned out to be a .wav file, and
+		never if it is the input itself.
+
+		in_path: Path of the input .wav file, "-" for standard input.
+		out_path: Path of the output .wav file, "-" for standard output.
+		options: Settings of the render.
+
+		returns: 0 on success, -1 if a file could not be opened or written,
+		         or if out_path is in_path.
+*/
+int render_file (const char *in_path, const char *out_path, RenderOptions *options);
+#endif
@@ -0,0 +1,177 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Common interface of the reverb engines, so that adding an engine
+	only means adding a case to reverb_create.
+*/
+
+/* Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* Header files */
+#include "reverb.h"
+#include "engine.h"
+#include "conv.h"
+#include "fixed.h"
+#include "fdn.h"
+#include "kernels.h"
+#include "constants.h"
+
+/* Adapters from the generic interface to each engine */
+
+static void schroeder_process(void *state, const float *in, float *out, size_t frames)
+{
+	cverb_process_block(state, in, out, frames);
+}
+
+static void schroeder_destroy(void *state)
+{
+	cverb_state_free(state);
+}
+
+static void conv_process(void *state, const float *in, float *out, size_t frames)
+{
+	conv_process_block(state, in, out, frames);
+}
+
+static void conv_destroy(void *state)
+{
+	conv_state_free(state);
+}
+
+static void fixed_process(void *state, const float *in, float *out, size_t frames)
+{
+	fixed_process_float(state, in, out, frames);
+}
+
+static void fixed_destroy(void *state)
+{
+	fixed_state_free(state);
+}
+
+static void fdn_process(void *state, const float *in, float *out, size_t frames)
+{
+	fdn_process_block(state, in, out, frames);
+}
+
+static void fdn_destroy(void *state)
+{
+	fdn_state_free(state);
+}
+
+/*
+		Looks up an engine by its name on the command line.
+
+		name: "schroeder", "conv", "fixed" or "fdn".
+		engine: Set to the engine with that name.
+
+		returns: 0 on success, -1 if there is no engine with that name.
+*/
+int reverb_engine_from_name(const char *name, EngineType *engine)
+{
+	if (strcmp(name, "schroeder") == 0)
+	{
+		*engine = ENGINE_SCHROEDER;
+		return 0;
+	}
+	if (strcmp(name, "conv") == 0)
+	{
+		*engine = ENGINE_CONVOLUTION;
+		return 0;
+	}
+	if (strcmp(name, "fixed") == 0)
+	{
+		*engine = ENGINE_FIXED;
+		return 0;
+	}
+	if (strcmp(name, "fdn") == 0)
+	{
+		*engine = ENGINE_FDN;
+		return 0;
+	}
+	return -1;
+}
+
+/*
+		Creates the reverb of one channel.
+
+		spec: Which engine to use and its parameters.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+		channel: Index of the channel. A multichannel impulse response gives
+		         each channel its own response, wrapping around if the
+		         audio has more channels than the response.
+
+		returns: Pointer to the new Reverb, or NULL if it could not be created.
+*/
+Reverb *reverb_create(const ReverbSpec *spec, unsigned int sample_rate, int channel)
+{
+	Reverb *reverb = malloc(sizeof(Reverb));
+	reverb->latency = 0;
+
+	// Looks the kernels up with CPUID now rather than in the first block of audio
+	kernel_table();
+
+	switch (spec->engine)
+	{
+		case ENGINE_CONVOLUTION:
+		{
+			const ImpulseResponse *ir = spec->ir;
+			ConvState *state = conv_state_create(ir->samples[channel % ir->channels], ir->length, CONV_BLOCK_FRAMES);
+
+			reverb->state = state;
+			reverb->process = conv_process;
+			reverb->destroy = conv_destroy;
+			reverb->latency = state != NULL ? state->latency : 0;
+			break;
+		}
+		case ENGINE_FIXED:
+			reverb->state = fixed_state_create(spec->config, sample_rate);
+			reverb->process = fixed_process;
+			reverb->destroy = fixed_destroy;
+			break;
+		case ENGINE_FDN:
+			reverb->state = fdn_state_create(spec->config, sample_rate);
+			reverb->process = fdn_process;
+			reverb->destroy = fdn_destroy;
+			break;
+		case ENGINE_SCHROEDER:
+		default:
+			reverb->state = cverb_state_create(spec->config, sample_rate);
+			reverb->process = schroeder_process;
+			reverb->destroy = schroeder_destroy;
+			break;
+	}
+
+	if (reverb->state == NULL)
+	{
+		free(reverb);
+		return NULL;
+	}
+
+	return reverb;
+}
+
+/*
+		Runs a block of samples through the reverb.
+
+		reverb: Reverb created by reverb_create.
+		in: Input samples.
+		out: Output samples, delayed by reverb->latency samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void reverb_process(Reverb *reverb, const float *in, float *out, size_t frames)
+{
+	reverb->process(reverb->state, in, out, frames);
+}
+
+/*
+		Frees a reverb and its engine state.
+
+		reverb: Reverb created by reverb_create.
+*/
+void reverb_free(Reverb *reverb)
+{
+	reverb->destroy(reverb->state);
+	free(reverb);
+}
@@ -0,0 +1,88 @@
+#ifndef REVERB
+#define REVERB
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "config.h"
+#include "ir.h"
+
+/* Reverb algorithms a render can use */
+typedef enum
+{
+	ENGINE_SCHROEDER,		// Comb/all pass network (engine.h)
+	ENGINE_CONVOLUTION,	// Partitioned FFT convolution with an impulse response (conv.h)
+	ENGINE_FIXED,				// Comb/all pass network in fixed point (fixed.h)
+	ENGINE_FDN					// Feedback delay network (fdn.h)
+} EngineType;
+
+/* Engine used unless another one is asked for. make FIXED=1 builds for
+   processors without an FPU, where the fixed point engine is the default */
+#ifdef CVERB_FIXED
+#define DEFAULT_ENGINE ENGINE_FIXED
+#else
+#define DEFAULT_ENGINE ENGINE_SCHROEDER
+#endif
+
+/* Struct which says how to build the reverb of each channel */
+typedef struct
+{
+	EngineType engine;
+	const CVerbConfig *config;				// Parameters of the network
+	const ImpulseResponse *ir;				// Impulse response of the convolution engine
+} ReverbSpec;
+
+/* Struct which hides which engine processes a channel.
+
+	 Each engine keeps its own state type, this struct only remembers
+	 how to process and free it so the multichannel code and the
+	 renderer can treat every engine the same.
+*/
+typedef struct
+{
+	void *state;
+	void (*process)(void *state, const float *in, float *out, size_t frames);
+	void (*destroy)(void *state);
+	int latency;											// Samples the output lags behind the input
+} Reverb;
+
+/*
+		Looks up an engine by its name on the command line.
+
+		name: "schroeder", "conv", "fixed" or "fdn".
+		engine: Set to the engine with that name.
+
+		returns: 0 on success, -1 if there is no engine with that name.
+*/
+int reverb_engine_from_name(const char *name, EngineType *engine);
+
+/*
+		Creates the reverb of one channel.
+
+		spec: Which engine to use and its parameters.
+		sample_rate: Sample rate of the audio that will be processed [Hz].
+		channel: Index of the channel. A multichannel impulse response gives
+		         each channel its own response, wrapping around if the
+		         audio has more channels than the response.
+
+		returns: Pointer to the new Reverb, or NULL if it could not be created.
+*/
+Reverb *reverb_create(const ReverbSpec *spec, unsigned int sample_rate, int channel);
+
+/*
+		Runs a block of samples through the reverb.
+
+		reverb: Reverb created by reverb_create.
+		in: Input samples.
+		out: Output samples, delayed by reverb->latency samples (may not alias in).
+		frames: Number of samples in the block. Any length is accepted.
+*/
+void reverb_process(Reverb *reverb, const float *in, float *out, size_t frames);
+
+/*
+		Frees a reverb and its engine state.
+
+		reverb: Reverb created by reverb_create.
+*/
+void reverb_free(Reverb *reverb);
+#endif
@@ -0,0 +1,186 @@
+/*
+		Lock-free single producer / single consumer circular buffer.
+
+		head and tail count elements ever written and read. They only grow,
+		so full and empty can be told apart without a flag, and the slot of
+		an index is index & mask. The producer owns head and the consumer
+		owns tail; each publishes its index with a release store and reads
+		the other one with an acquire load, which makes the element data
+		visible before the index that covers it.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "spsc_buffer.h"
+
+#define SPSC_CACHE_LINE 64
+
+// head and tail sit on separate cache lines so the two threads do not contend
+struct spsc_buf_t {
+	unsigned char * buffer;
+	size_t elem_size;
+	size_t max; //of the buffer
+	size_t mask;
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t head;
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t tail;
+};
+
+spsc_handle_t spsc_buf_init(void* storage, size_t elem_size, size_t capacity)
+{
+	assert(storage && elem_size && capacity);
+	assert((capacity & (capacity - 1)) == 0);
+
+	spsc_handle_t sbuf = aligned_alloc(SPSC_CACHE_LINE, sizeof(spsc_buf_t));
+	assert(sbuf);
+
+	sbuf->buffer = storage;
+	sbuf->elem_size = elem_size;
+	sbuf->max = capacity;
+	sbuf->mask = capacity - 1;
+	atomic_init(&sbuf->head, 0);
+	atomic_init(&sbuf->tail, 0);
+
+	return sbuf;
+}
+
+void spsc_buf_free(spsc_handle_t sbuf)
+{
+	assert(sbuf);
+	free(sbuf);
+}
+
+void spsc_buf_reset(spsc_handle_t sbuf)
+{
+	assert(sbuf);
+
+	atomic_store(&sbuf->head, 0);
+	atomic_store(&sbuf->tail, 0);
+}
+
+size_t spsc_buf_write_span(spsc_handle_t sbuf, void** span)
+{
+	assert(sbuf && span);
+
+	size_t head = atomic_load_explicit(&sbuf->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&sbuf->tail, memory_order_acquire);
+	size_t free_slots = sbuf->max - (head - tail);
+	size_t slot = head & sbuf->mask;
+
+	// Stop at the end of the storage, the rest comes with the next span
+	size_t run = sbuf->max - slot;
+	if(run > free_slots)
+	{
+		run = free_slots;
+	}
+
+	*span = sbuf->buffer + slot * sbuf->elem_size;
+	return run;
+}
+
+void spsc_buf_commit_write(spsc_handle_t sbuf, size_t count)
+{
+	assert(sbuf);
+
+	size_t head = atomic_load_explicit(&sbuf->head, memory_order_relaxed);
+	atomic_store_explicit(&sbuf->head, head + count, memory_order_release);
+}
+
+size_t spsc_buf_read_span(spsc_handle_t sbuf, const void** span)
+{
+	assert(sbuf && span);
+
+	size_t tail = atomic_load_explicit(&sbuf->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&sbuf->head, memory_order_acquire);
+	size_t used = head - tail;
+	size_t slot = tail & sbuf->mask;
+
+	size_t run = sbuf->max - slot;
+	if(run > used)
+	{
+		run = used;
+	}
+
+	*span = sbuf->buffer + slot * sbuf->elem_size;
+	return run;
+}
+
+void spsc_buf_commit_read(spsc_handle_t sbuf, size_t count)
+{
+	assert(sbuf);
+
+	size_t tail = atomic_load_explicit(&sbuf->tail, memory_order_relaxed);
+	atomic_store_explicit(&sbuf->tail, tail + count, memory_order_release);
+}
+
+size_t spsc_buf_put_range(spsc_handle_t sbuf, const void* data, size_t len)
+{
+	const unsigned char * bytes = data;
+	size_t done = 0;
+	void * span;
+	size_t run;
+
+	// At most two spans: up to the end of the storage, then from the start
+	while(done < len && (run = spsc_buf_write_span(sbuf, &span)) > 0)
+	{
+		if(run > len - done)
+		{
+			run = len - done;
+		}
+		memcpy(span, bytes + done * sbuf->elem_size, run * sbuf->elem_size);
+		spsc_buf_commit_write(sbuf, run);
+		done += run;
+	}
+
+	return done;
+}
+
+size_t spsc_buf_get_range(spsc_handle_t sbuf, void* data, size_t len)
+{
+	unsigned char * bytes = data;
+	size_t done = 0;
+	const void * span;
+	size_t run;
+
+	while(done < len && (run = spsc_buf_read_span(sbuf, &span)) > 0)
+	{
+		if(run > len - done)
+		{
+			run = len - done;
+		}
+		memcpy(bytes + done * sbuf->elem_size, span, run * sbuf->elem_size);
+		spsc_buf_commit_read(sbuf, run);
+		done += run;
+	}
+
+	return done;
+}
+
+bool spsc_buf_empty(spsc_handle_t sbuf)
+{
+	return spsc_buf_size(sbuf) == 0;
+}
+
+bool spsc_buf_full(spsc_handle_t sbuf)
+{
+	return spsc_buf_size(sbuf) == sbuf->max;
+}
+
+size_t spsc_buf_capacity(spsc_handle_t sbuf)
+{
+	assert(sbuf);
+
+	return sbuf->max;
+}
+
+size_t spsc_buf_size(spsc_handle_t sbuf)
+{
+	assert(sbuf);
+
+	size_t tail = atomic_load_explicit(&sbuf->tail, memory_order_acquire);
+	size_t head = atomic_load_explicit(&sbuf->head, memory_order_acquire);
+
+	return head - tail;
+}
@@ -0,0 +1,72 @@
+/*
+		Lock-free single producer / single consumer variant of the circular
+		buffer in circular_buffer.h, for handing samples from a capture or
+		reader thread to the DSP thread without locks.
+
+		Exactly one thread may put and exactly one (other) thread may get.
+		The capacity is a power of two, so indices wrap with a mask. Whole
+		runs of elements are exchanged through spans that point straight into
+		the storage, which avoids both per-element calls and copies.
+*/
+
+#ifndef SPSC_BUFFER_H_
+#define SPSC_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Opaque SPSC buffer structure
+typedef struct spsc_buf_t spsc_buf_t;
+
+/// Handle type, the way users interact with the API
+typedef spsc_buf_t* spsc_handle_t;
+
+/// Pass in a storage buffer, the size of one element and the capacity in elements
+/// Requires: storage is not NULL, elem_size > 0, capacity is a power of two
+/// Ensures: buffer has been created and is returned in an empty state
+spsc_handle_t spsc_buf_init(void* storage, size_t elem_size, size_t capacity);
+
+/// Free an SPSC buffer structure
+/// Does not free the storage; owner is responsible for that
+void spsc_buf_free(spsc_handle_t sbuf);
+
+/// Reset the buffer to empty. Neither thread may be using it
+void spsc_buf_reset(spsc_handle_t sbuf);
+
+/// Producer: get the largest contiguous run of free slots
+/// Sets span to the first free slot
+/// Returns the number of free slots in the run, 0 if the buffer is full
+size_t spsc_buf_write_span(spsc_handle_t sbuf, void** span);
+
+/// Producer: publish count elements written into the span from spsc_buf_write_span
+void spsc_buf_commit_write(spsc_handle_t sbuf, size_t count);
+
+/// Consumer: get the largest contiguous run of filled slots
+/// Sets span to the oldest element
+/// Returns the number of elements in the run, 0 if the buffer is empty
+size_t spsc_buf_read_span(spsc_handle_t sbuf, const void** span);
+
+/// Consumer: release count elements read from the span from spsc_buf_read_span
+void spsc_buf_commit_read(spsc_handle_t sbuf, size_t count);
+
+/// Producer: copy up to len elements into the buffer
+/// Returns the number of elements added
+size_t spsc_buf_put_range(spsc_handle_t sbuf, const void* data, size_t len);
+
+/// Consumer: copy up to len elements out of the buffer
+/// Returns the number of elements retrieved
+size_t spsc_buf_get_range(spsc_handle_t sbuf, void* data, size_t len);
+
+/// Checks if the buffer is empty (exact only on the consumer thread)
+bool spsc_buf_empty(spsc_handle_t sbuf);
+
+/// Checks if the buffer is full (exact only on the producer thread)
+bool spsc_buf_full(spsc_handle_t sbuf);
+
+/// Returns the maximum capacity of the buffer
+size_t spsc_buf_capacity(spsc_handle_t sbuf);
+
+/// Returns the current number of elements stored in the buffer
+size_t spsc_buf_size(spsc_handle_t sbuf);
+
+#endif //SPSC_BUFFER_H_
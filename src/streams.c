@@ -0,0 +1,210 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Block engine for many independent mono streams at once. The delay
+	lines of all streams are interleaved sample by sample, so the
+	kernels of engine.c run over every stream in one call.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Header files */
+#include "streams.h"
+#include "kernels.h"
+#include "constants.h"
+#include "delayline.h"
+
+/*
+		Shortens a span of rows so that reading it starting at the float
+		index does not run past the end of an interleaved line.
+*/
+static int clamp_rows(int span, int index, const ProcessingBuffer *line, int row)
+{
+	int left = (line->length - index) / row;
+
+	return span > left ? left : span;
+}
+
+/*
+		Creates the delay lines of num_streams streams for the given
+		parameters and sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb, shared by every stream.
+		sample_rate: Sample rate of every stream [Hz].
+		num_streams: Amount of streams, 1 to MAX_STREAMS.
+
+		returns: Pointer to the new CVerbStreams, or NULL (after printing
+		         why) if the config asks for a comb bank, fails config_check
+		         or num_streams is out of range, or if the delay lines could
+		         not be allocated.
+*/
+CVerbStreams *cverb_streams_create(const CVerbConfig *config, unsigned int sample_rate, int num_streams)
+{
+	if (config_check(config, sample_rate) != 0)
+	{
+		return NULL;
+	}
+	if (config->bank_combs > 0)
+	{
+		fprintf(stderr, "streams: the comb bank is not supported\n");
+		return NULL;
+	}
+	if (num_streams < 1 || num_streams > MAX_STREAMS)
+	{
+		fprintf(stderr, "streams: between 1 and %d streams are supported\n", MAX_STREAMS);
+		return NULL;
+	}
+
+	CVerbStreams *streams = malloc(sizeof(CVerbStreams));
+	streams->num_streams = num_streams;
+	streams->num_combs = config->num_combs;
+	streams->num_all_pass = config->num_all_pass;
+	streams->comb_ff = config->comb_ff;
+	streams->comb_fb = config->comb_fb;
+	streams->all_pass_ff = config->all_pass_ff;
+	streams->all_pass_fb = config->all_pass_fb;
+
+	// The same delays as cverb_state_create, so every stream sounds like the block engine
+	for (int i = 0; i < streams->num_combs; i++)
+	{
+		streams->comb_taps[i] = (int) ((i+1) * config->delay_ms * sample_rate / 1000);
+	}
+	streams->all_pass_delay = (int) (config->delay_ms * sample_rate / 1000);
+
+	streams->max_span = streams->all_pass_delay < MAX_SPAN_FRAMES ? streams->all_pass_delay : MAX_SPAN_FRAMES;
+	if (streams->max_span < 1)
+	{
+		streams->max_span = 1;
+	}
+
+	int comb_reach = streams->all_pass_delay;
+	if (streams->num_combs > 0 && streams->comb_taps[streams->num_combs - 1] > comb_reach)
+	{
+		comb_reach = streams->comb_taps[streams->num_combs - 1];
+	}
+	int comb_rows = next_power_of_two(comb_reach + streams->max_span, LINE_ALIGN_BYTES / sizeof(float));
+	int all_pass_rows = next_power_of_two(streams->all_pass_delay + streams->max_span, LINE_ALIGN_BYTES / sizeof(float));
+
+	// Whole lines of 16 rows keep every line and the span rows 64 byte aligned
+	size_t row_floats = (size_t) num_streams;
+	size_t floats = (comb_rows + (size_t) streams->num_all_pass * all_pass_rows + 2 * MAX_SPAN_FRAMES) * row_floats;
+	streams->arena_bytes = floats * sizeof(float);
+	if (posix_memalign((void **) &streams->arena, 64, streams->arena_bytes) != 0)
+	{
+		free(streams);
+		return NULL;
+	}
+
+	float *storage = streams->arena;
+	pbuff_init_storage(&streams->comb_out, storage, comb_rows * num_streams);
+	storage += comb_rows * row_floats;
+	streams->all_pass = malloc(streams->num_all_pass * sizeof(ProcessingBuffer));
+	for (int i = 0; i < streams->num_all_pass; i++)
+	{
+		pbuff_init_storage(&streams->all_pass[i], storage, all_pass_rows * num_streams);
+		storage += all_pass_rows * row_floats;
+	}
+	streams->rows_in = storage;
+	streams->rows_out = storage + MAX_SPAN_FRAMES * row_floats;
+
+	return streams;
+}
+
+/*
+		Runs a block of samples of every stream through the network.
+
+		streams: Streams created by cverb_streams_create.
+		in: Input samples, one array per stream.
+		out: Output samples, one array per stream (may not alias in).
+		frames: Number of samples per stream. Any length is accepted.
+*/
+void cverb_streams_process(CVerbStreams *streams, const float *const *in, float *const *out, size_t frames)
+{
+	unsigned int mode = kernel_flush_denormals();
+	int row = streams->num_streams;
+	size_t done = 0;
+
+	while (done < frames)
+	{
+		ProcessingBuffer *comb_out = &streams->comb_out;
+		int span = (frames - done < (size_t) streams->max_span) ? (int) (frames - done) : streams->max_span;
+
+		// Same as cverb_process_block, with every delay and span in rows of all streams
+		span = clamp_rows(span, comb_out->head, comb_out, row);
+		const float *taps[MAX_COMB_TAPS];
+		for (int i = 0; i < streams->num_combs; i++)
+		{
+			int index = pbuff_delayed_index(comb_out, streams->comb_taps[i] * row);
+			span = clamp_rows(span, index, comb_out, row);
+			taps[i] = comb_out->buffer + index;
+		}
+
+		int delayed[MAX_ALL_PASS + 1];
+		delayed[0] = pbuff_delayed_index(comb_out, streams->all_pass_delay * row);
+		span = clamp_rows(span, delayed[0], comb_out, row);
+		for (int i = 0; i < streams->num_all_pass; i++)
+		{
+			ProcessingBuffer *line = &streams->all_pass[i];
+			delayed[i + 1] = pbuff_delayed_index(line, streams->all_pass_delay * row);
+			span = clamp_rows(span, line->head, line, row);
+			span = clamp_rows(span, delayed[i + 1], line, row);
+		}
+
+		// Interleave the planar input, one row per sample
+		const float *span_in[MAX_STREAMS];
+		float *span_out[MAX_STREAMS];
+		for (int s = 0; s < row; s++)
+		{
+			span_in[s] = in[s] + done;
+			span_out[s] = out[s] + done;
+		}
+		kernel_interleave(streams->rows_in, span_in, row, span);
+
+		size_t count = (size_t) span * row;
+		float *comb = comb_out->buffer + comb_out->head;
+		kernel_comb(comb, streams->rows_in, taps, streams->num_combs, streams->comb_ff, streams->comb_fb, count);
+
+		ProcessingBuffer *stage_in = comb_out;
+		for (int i = 0; i < streams->num_all_pass; i++)
+		{
+			ProcessingBuffer *stage_out = &streams->all_pass[i];
+			kernel_all_pass(stage_out->buffer + stage_out->head, stage_in->buffer + stage_in->head,
+			                stage_in->buffer + delayed[i], stage_out->buffer + delayed[i + 1],
+			                streams->all_pass_ff, streams->all_pass_fb, count);
+			stage_in = stage_out;
+		}
+
+		memcpy(streams->rows_out, comb, count * sizeof(float));
+		for (int i = 0; i < streams->num_all_pass; i++)
+		{
+			kernel_accumulate(streams->rows_out, streams->all_pass[i].buffer + streams->all_pass[i].head, count);
+		}
+
+		// And take the rows apart again
+		kernel_deinterleave(span_out, streams->rows_out, row, span);
+
+		pbuff_advance_head(comb_out, (int) count);
+		for (int i = 0; i < streams->num_all_pass; i++)
+		{
+			pbuff_advance_head(&streams->all_pass[i], (int) count);
+		}
+		done += span;
+	}
+
+	kernel_restore_denormals(mode);
+}
+
+/*
+		Frees the streams and all of their delay lines.
+
+		streams: Streams created by cverb_streams_create.
+*/
+void cverb_streams_free(CVerbStreams *streams)
+{
+	free(streams->arena);
+	free(streams->all_pass);
+	free(streams);
+}
@@ -0,0 +1,75 @@
+#ifndef STREAMS
+#define STREAMS
+/* Libraries */
+#include <stddef.h>
+
+/* Header files */
+#include "pbuff.h"
+#include "config.h"
+
+#define MAX_STREAMS 64 // Largest amount of streams one CVerbStreams runs side by side
+
+/* Struct which holds the delay lines of several independent mono
+	 streams that share one config, for servers that host many rooms.
+
+	 Runs the network of the block engine, but every delay line holds
+	 all streams interleaved: row t of a line holds sample t of every
+	 stream side by side, num_streams floats. A span of rows is then one
+	 contiguous array, so each kernel call of engine.c updates a whole
+	 span of every stream at once, and the per-call bookkeeping (finding
+	 taps, clamping spans) is paid once for all streams instead of once
+	 per stream. Every stream gets exactly the output the block engine
+	 would give it on its own.
+
+	 Input and output are planar, one array per stream.
+*/
+typedef struct
+{
+	float *arena;												// Single allocation holding every delay line and the rows of one span
+	size_t arena_bytes;
+	ProcessingBuffer comb_out;					// Output of the parallel comb filters, indexed in floats
+	ProcessingBuffer *all_pass;					// Output of each all pass filter, indexed in floats
+	float *rows_in;											// Interleaved input of one span
+	float *rows_out;										// Interleaved output of one span
+	int num_streams;
+	int num_combs;
+	int num_all_pass;
+	int comb_taps[MAX_COMB_TAPS];				// Delay of each comb feedback tap [samples]
+	int all_pass_delay;									// Delay of the all pass filters [samples]
+	int max_span;												// Longest span without intra-span feedback [samples]
+	float comb_ff, comb_fb;
+	float all_pass_ff, all_pass_fb;
+} CVerbStreams;
+
+/*
+		Creates the delay lines of num_streams streams for the given
+		parameters and sample rate. All delay lines start out silent.
+
+		config: Parameters of the reverb, shared by every stream.
+		sample_rate: Sample rate of every stream [Hz].
+		num_streams: Amount of streams, 1 to MAX_STREAMS.
+
+		returns: Pointer to the new CVerbStreams, or NULL (after printing
+		         why) if the config asks for a comb bank, fails config_check
+		         or num_streams is out of range, or if the delay lines could
+		         not be allocated.
+*/
+CVerbStreams *cverb_streams_create(const CVerbConfig *config, unsigned int sample_rate, int num_streams);
+
+/*
+		Runs a block of samples of every stream through the network.
+
+		streams: Streams created by cverb_streams_create.
+		in: Input samples, one array per stream.
+		out: Output samples, one array per stream (may not alias in).
+		frames: Number of samples per stream. Any length is accepted.
+*/
+void cverb_streams_process(CVerbStreams *streams, const float *const *in, float *const *out, size_t frames);
+
+/*
+		Frees the streams and all of their delay lines.
+
+		streams: Streams created by cverb_streams_create.
+*/
+void cverb_streams_free(CVerbStreams *streams);
+#endif
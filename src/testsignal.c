@@ -0,0 +1,181 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Synthetic test signals shared by the benchmark suite and the
+	equivalence harness.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+/* Header files */
+#include "testsignal.h"
+#include "constants.h"
+
+const char *test_signal_names[NUM_TEST_SIGNALS] = { "silence", "noise", "impulses", "sweep" };
+
+/*
+		Starts a test signal.
+
+		signal: Signal to start.
+		kind: 0 silence, 1 white noise, 2 two clicks per second,
+		      3 exponential sine sweep from 20 Hz to just below Nyquist.
+		sample_rate: [Hz]
+		length: Amount of samples.
+		amplitude: Peak level of the signal.
+*/
+void test_signal_init(TestSignal *signal, int kind, unsigned int sample_rate, size_t length, int16_t amplitude)
+{
+	signal->signal = kind;
+	signal->sample_rate = sample_rate;
+	signal->length = length;
+	signal->position = 0;
+	signal->amplitude = amplitude;
+	signal->noise = 0x12345678;
+}
+
+/*
+		Fills out with the next samples of the signal.
+
+		signal: Signal started by test_signal_init.
+		out: Room for max_samples samples.
+		max_samples: Largest amount of samples wanted.
+
+		returns: Amount of samples produced, 0 at the end of the signal.
+*/
+size_t test_signal_next(TestSignal *signal, int16_t *out, size_t max_samples)
+{
+	size_t count = signal->length - signal->position;
+	if (count > max_samples)
+	{
+		count = max_samples;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t n = signal->position + i;
+
+		switch (signal->signal)
+		{
+			case 1:
+				// White noise from a xorshift generator
+				signal->noise ^= signal->noise << 13;
+				signal->noise ^= signal->noise >> 17;
+				signal->noise ^= signal->noise << 5;
+				out[i] = (int16_t) (((int32_t) (signal->noise >> 16) - 32768) * signal->amplitude / 32768);
+				break;
+			case 2:
+				out[i] = n % (signal->sample_rate / 2) == 0 ? signal->amplitude : 0;
+				break;
+			case 3:
+			{
+				double duration = (double) signal->length / signal->sample_rate;
+				double rise = log(0.45 * signal->sample_rate / 20.0);
+				double t = (double) n / signal->sample_rate;
+				double phase = 2 * M_PI * 20.0 * duration / rise * (exp(t * rise / duration) - 1);
+				out[i] = (int16_t) (signal->amplitude * sin(phase));
+				break;
+			}
+			default:
+				out[i] = 0;
+				break;
+		}
+	}
+
+	signal->position += count;
+	return count;
+}
+
+/*
+		Fills header for a monochannel 16-bit file.
+
+		header: Header to fill.
+		sample_rate: [Hz]
+		samples: Amount of samples in the file.
+*/
+void test_signal_header(WaveHeader *header, unsigned int sample_rate, size_t samples)
+{
+	memset(header, 0, sizeof(WaveHeader));
+	memcpy(header->riff, "RIFF", 4);
+	memcpy(header->wave, "WAVE", 4);
+	memcpy(header->fmt_chunk_marker, "fmt ", 4);
+	memcpy(header->data_chunk_header, "data", 4);
+	header->length_of_fmt = 16;
+	header->format_type = 1;
+	header->channels = 1;
+	header->sample_rate = sample_rate;
+	header->bits_per_sample = 16;
+	header->block_align = sizeof(int16_t);
+	header->byterate = sample_rate * header->block_align;
+	header->data_size = samples * sizeof(int16_t);
+	header->overall_size = 36 + header->data_size;
+}
+
+/*
+		Creates an empty file in $TMPDIR (or /tmp) and returns its path,
+		which the caller frees. Exits if no file can be created.
+*/
+char *test_temp_file(void)
+{
+	const char *dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+	size_t length = strlen(dir) + 32;
+	char *path = malloc(length);
+	snprintf(path, length, "%s/cverb-test-XXXXXX", dir);
+
+	int fd = mkstemp(path);
+	if (fd < 0)
+	{
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+
+	return path;
+}
+
+/*
+		Writes the rest of the signal to a monochannel 16-bit .wav file.
+
+		signal: Signal started by test_signal_init.
+		path: Path of the file.
+
+		returns: 0 on success, -1 if the file could not be written.
+*/
+int test_signal_write(TestSignal *signal, const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return -1;
+	}
+
+	WaveHeader header;
+	int16_t *block = malloc(BLOCK_FRAMES * sizeof(int16_t));
+	size_t count;
+	int r = 0;
+
+	test_signal_header(&header, signal->sample_rate, signal->length - signal->position);
+	if (write_wav_header(file, &header, header.data_size) != 0)
+	{
+		r = -1;
+	}
+	while ((count = test_signal_next(signal, block, BLOCK_FRAMES)) > 0)
+	{
+		if (fwrite(block, sizeof(int16_t), count, file) != count)
+		{
+			r = -1;
+		}
+	}
+
+	if (fclose(file) != 0)
+	{
+		r = -1;
+	}
+	free(block);
+
+	return r;
+}
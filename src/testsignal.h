@@ -0,0 +1,75 @@
+#ifndef TESTSIGNAL
+#define TESTSIGNAL
+/* Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Header files */
+#include "wav.h"
+
+#define NUM_TEST_SIGNALS 4
+
+/* Names of the test signals, indexed by the kind argument of test_signal_init */
+extern const char *test_signal_names[NUM_TEST_SIGNALS];
+
+/* Struct which produces a synthetic monochannel test signal block by
+   block, so signals of any length can be generated without holding
+   them in memory. The same arguments always give the same samples. */
+typedef struct
+{
+	int signal;							// Kind of signal, index into test_signal_names
+	unsigned int sample_rate;
+	size_t length;					// Samples in the whole signal
+	size_t position;				// Samples produced so far
+	int16_t amplitude;			// Peak level
+	uint32_t noise;					// State of the noise generator
+} TestSignal;
+
+/*
+		Starts a test signal.
+
+		signal: Signal to start.
+		kind: 0 silence, 1 white noise, 2 two clicks per second,
+		      3 exponential sine sweep from 20 Hz to just below Nyquist.
+		sample_rate: [Hz]
+		length: Amount of samples.
+		amplitude: Peak level of the signal.
+*/
+void test_signal_init(TestSignal *signal, int kind, unsigned int sample_rate, size_t length, int16_t amplitude);
+
+/*
+		Fills out with the next samples of the signal.
+
+		signal: Signal started by test_signal_init.
+		out: Room for max_samples samples.
+		max_samples: Largest amount of samples wanted.
+
+		returns: Amount of samples produced, 0 at the end of the signal.
+*/
+size_t test_signal_next(TestSignal *signal, int16_t *out, size_t max_samples);
+
+/*
+		Fills header for a monochannel 16-bit file.
+
+		header: Header to fill.
+		sample_rate: [Hz]
+		samples: Amount of samples in the file.
+*/
+void test_signal_header(WaveHeader *header, unsigned int sample_rate, size_t samples);
+
+/*
+		Creates an empty file in $TMPDIR (or /tmp) and returns its path,
+		which the caller frees. Exits if no file can be created.
+*/
+char *test_temp_file(void);
+
+/*
+		Writes the rest of the signal to a monochannel 16-bit .wav file.
+
+		signal: Signal started by test_signal_init.
+		path: Path of the file.
+
+		returns: 0 on success, -1 if the file could not be written.
+*/
+int test_signal_write(TestSignal *signal, const char *path);
+#endif
@@ -0,0 +1,1735 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Equivalence harness. Renders a corpus of generated signals (and any
+	.wav files given on the command line) with the per-sample reference
+	implementation and with every other engine and sample format, and
+	compares the results sample by sample. Also checks that the vectorized
+	kernels match the scalar ones bit for bit and that .wav headers
+	survive parse_wav().
+
+	usage: cverb-verify [-l seconds] [input.wav ...]
+
+	Exits with 1 if any check fails.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Header files */
+#include "reference.h"
+#include "render.h"
+#include "wavio.h"
+#include "kernels.h"
+#include "combbank.h"
+#include "fdn.h"
+#include "libcverb.h"
+#include "streams.h"
+#include "live.h"
+#include "pool.h"
+#include "circular_buffer.h"
+#include "spsc_buffer.h"
+#include "engine.h"
+#include "convert.h"
+#include "testsignal.h"
+#include "constants.h"
+
+#define SIGNAL_AMPLITUDE 4096 // Quiet enough that only the loudest resonances saturate
+
+static const unsigned int test_rates[] = { 8000, 22050, 44100, 96000 };
+#define NUM_TEST_RATES 4
+
+/* Struct which holds the outcome of comparing an output with the reference */
+typedef struct
+{
+	size_t samples;					// Samples compared
+	size_t clipped;					// Samples left out because the engine saturated
+	int max_error;					// Largest difference [LSB]
+	double signal;					// Energy of the reference
+	double noise;						// Energy of the difference
+	int same_length;				// 0 if the outputs differ in length
+} Comparison;
+
+/* An engine under test and how far it may stray from the reference */
+typedef struct
+{
+	const char *name;
+	EngineType engine;
+	int chunks;
+	int tolerance;					// Largest allowed difference [LSB]
+} EngineCase;
+
+/*
+		The block engines compute in float while the reference promotes to
+		double, so they may round the other way now and then. The convolution
+		engine adds the rounding of the FFT on top. The fixed point engine
+		rounds every stage to 16 bits, and that error recirculates through
+		the feedback of the combs and all pass filters, so it lands a few
+		LSB away (about 60 dB below an impulse, 75 dB below music).
+*/
+static const EngineCase engine_cases[] = {
+	{ "block", ENGINE_SCHROEDER, 1, 1 },
+	{ "chunked", ENGINE_SCHROEDER, 4, 1 },
+	{ "conv", ENGINE_CONVOLUTION, 1, 2 },
+	{ "fixed", ENGINE_FIXED, 1, 10 },
+};
+#define NUM_ENGINE_CASES 4
+
+/*
+		Formats the input is rewritten in before the block engine renders it.
+		The output keeps the format, so f32 is rendered without any conversion.
+		Wider formats hold every 16-bit sample exactly, but the output may
+		round to the other side of a 16-bit step.
+*/
+static const SampleFormat format_cases[] = { SAMPLE_S24, SAMPLE_S32, SAMPLE_F32 };
+#define NUM_FORMAT_CASES 3
+
+static int failures = 0;
+
+/*
+		Opens a .wav file and a reader for its samples. Returns NULL if it can not be read.
+*/
+static WavReader *open_samples(const char *path, FILE **file, WaveHeader *header)
+{
+	*file = fopen(path, "rb");
+	if (*file == NULL)
+	{
+		return NULL;
+	}
+
+	memset(header, 0, sizeof(WaveHeader));
+	parse_wav(*file, NULL, header);
+	return wav_reader_open(*file, header);
+}
+
+/*
+		Reads up to max_samples samples of a file in any format as 16-bit
+		samples, converted the way 16-bit output is.
+*/
+static size_t read_s16(WavReader *reader, SampleFormat format, int16_t *out, size_t max_samples)
+{
+	const void *samples;
+	float *converted = malloc(max_samples * sizeof(float));
+	size_t count = wav_reader_read(reader, &samples, max_samples);
+
+	convert_to_float(converted, samples, format, count);
+	convert_from_float(out, converted, SAMPLE_S16, count);
+	free(converted);
+
+	return count;
+}
+
+/*
+		Compares one channel of the output at test_path with the monochannel
+		output of the reference at reference_path. Samples where the engine
+		saturated are left out, since the reference wraps around there instead.
+*/
+static void compare(const char *reference_path, const char *test_path, int channel, Comparison *result)
+{
+	FILE *ref_file, *test_file;
+	WaveHeader ref_header, test_header;
+	SampleFormat test_format;
+	WavReader *ref = open_samples(reference_path, &ref_file, &ref_header);
+	WavReader *test = open_samples(test_path, &test_file, &test_header);
+	int channels = test_header.channels > 0 ? test_header.channels : 1;
+	int16_t *ref_block = malloc(BLOCK_FRAMES * sizeof(int16_t));
+	int16_t *test_block = malloc(BLOCK_FRAMES * channels * sizeof(int16_t));
+	const int16_t *ref_samples = ref_block, *test_samples = test_block;
+	size_t ref_count = 0, test_count = 0;
+
+	memset(result, 0, sizeof(Comparison));
+	result->same_length = ref != NULL && test != NULL && wav_sample_format(&test_header, &test_format) == 0;
+
+	while (result->same_length)
+	{
+		if (ref_count == 0)
+		{
+			ref_count = read_s16(ref, SAMPLE_S16, ref_block, BLOCK_FRAMES);
+			ref_samples = ref_block;
+		}
+		if (test_count < (size_t) channels)
+		{
+			test_count = read_s16(test, test_format, test_block, BLOCK_FRAMES * channels);
+			test_samples = test_block;
+		}
+		if (ref_count == 0 || test_count < (size_t) channels)
+		{
+			result->same_length = ref_count == 0 && test_count == 0;
+			break;
+		}
+
+		int expected = *ref_samples++;
+		int actual = test_samples[channel];
+		ref_count--;
+		test_samples += channels;
+		test_count -= channels;
+
+		if (actual == INT16_MAX || actual == INT16_MIN)
+		{
+			result->clipped++;
+			continue;
+		}
+
+		int error = abs(actual - expected);
+		if (error > result->max_error)
+		{
+			result->max_error = error;
+		}
+		result->signal += (double) expected * expected;
+		result->noise += (double) error * error;
+		result->samples++;
+	}
+
+	if (ref != NULL)
+	{
+		wav_reader_close(ref);
+	}
+	if (test != NULL)
+	{
+		wav_reader_close(test);
+	}
+	if (ref_file != NULL)
+	{
+		fclose(ref_file);
+	}
+	if (test_file != NULL)
+	{
+		fclose(test_file);
+	}
+	free(ref_block);
+	free(test_block);
+}
+
+/*
+		Prints one comparison and counts it as a failure if it is out of tolerance.
+*/
+static void report(const char *engine, const char *input, const Comparison *result, int tolerance)
+{
+	int ok = result->same_length && result->max_error <= tolerance;
+	char snr[32];
+
+	if (result->noise == 0)
+	{
+		snprintf(snr, sizeof(snr), "inf");
+	}
+	else
+	{
+		snprintf(snr, sizeof(snr), "%.2f", 10 * log10(result->signal / result->noise));
+	}
+
+	printf("%-10s %-28s %8d %10s %6s %8zu  %s\n", engine, input, result->max_error, snr,
+	       result->noise == 0 && result->clipped == 0 && result->same_length ? "yes" : "no",
+	       result->clipped, ok ? "ok" : "FAIL");
+
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+/*
+		Writes a file which holds the monochannel 16-bit file at mono_path on
+		every one of channels channels, in the given sample format and container.
+*/
+static void widen(const char *mono_path, const char *path, int channels, SampleFormat format, WavContainer container)
+{
+	FILE *in_file, *out_file = fopen(path, "wb");
+	WaveHeader header;
+	WavReader *reader = open_samples(mono_path, &in_file, &header);
+	const void *samples;
+	size_t count;
+	float *converted = malloc(BLOCK_FRAMES * sizeof(float));
+	float *frames = malloc(BLOCK_FRAMES * channels * sizeof(float));
+	unsigned char *encoded = malloc(BLOCK_FRAMES * channels * sample_format_bytes(format));
+
+	size_t total = wav_sample_count(in_file, &header);
+	header.channels = channels;
+	header.container = container;
+	wav_set_sample_format(&header, format);
+	uint64_t data_size = (uint64_t) total * channels * sample_format_bytes(format);
+	write_wav_header(out_file, &header, data_size);
+
+	while ((count = wav_reader_read(reader, &samples, BLOCK_FRAMES)) > 0)
+	{
+		convert_to_float(converted, samples, SAMPLE_S16, count);
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				frames[i * channels + c] = converted[i];
+			}
+		}
+		convert_from_float(encoded, frames, format, count * channels);
+		fwrite(encoded, sample_format_bytes(format), count * channels, out_file);
+	}
+	static const unsigned char zeros[8] = { 0 };
+	fwrite(zeros, 1, wav_padding(&header, data_size), out_file);
+
+	wav_reader_close(reader);
+	fclose(in_file);
+	fclose(out_file);
+	free(converted);
+	free(frames);
+	free(encoded);
+}
+
+/*
+		Renders in_path to out_path, removing any earlier output first, so a
+		failed render can not be compared as the output of an earlier case.
+		Returns 1 if the render succeeded.
+*/
+static int render_fresh(const char *in_path, const char *out_path, RenderOptions *options)
+{
+	unlink(out_path);
+	return render_file(in_path, out_path, options) == 0;
+}
+
+/*
+		Renders the monochannel file at path with the reference and every
+		engine, and compares them. A render that fails counts as a failure
+		whatever it left behind.
+*/
+static void verify_input(const char *path, const char *name)
+{
+	FILE *file = fopen(path, "rb");
+	WaveHeader header;
+
+	memset(&header, 0, sizeof(header));
+	if (file != NULL)
+	{
+		parse_wav(file, NULL, &header);
+		fclose(file);
+	}
+	if (file == NULL || header.channels != 1 || header.bits_per_sample != 16)
+	{
+		printf("%-10s %-28s not a monochannel 16-bit file  FAIL\n", "reference", name);
+		failures++;
+		return;
+	}
+
+	char *reference_path = test_temp_file();
+	char *test_path = test_temp_file();
+	char *wide_path = test_temp_file();
+	Comparison result;
+
+	if (render_reference(path, reference_path) != 0)
+	{
+		printf("%-10s %-28s could not be rendered  FAIL\n", "reference", name);
+		failures++;
+	}
+	else
+	{
+		for (int e = 0; e < NUM_ENGINE_CASES; e++)
+		{
+			RenderOptions options;
+			render_options_init(&options);
+			options.engine = engine_cases[e].engine;
+			options.chunks = engine_cases[e].chunks;
+
+			int rendered = render_fresh(path, test_path, &options);
+			compare(reference_path, test_path, 0, &result);
+			result.same_length &= rendered;
+			report(engine_cases[e].name, name, &result, engine_cases[e].tolerance);
+		}
+
+		// Every channel of a multichannel file, rendered on worker threads, must match as well
+		RenderOptions options;
+		render_options_init(&options);
+		options.engine = ENGINE_SCHROEDER;
+		options.threads = 2;
+		widen(path, wide_path, 2, SAMPLE_S16, WAV_CONTAINER_RIFF);
+		int rendered = render_fresh(wide_path, test_path, &options);
+		for (int c = 0; c < 2; c++)
+		{
+			compare(reference_path, test_path, c, &result);
+			result.same_length &= rendered;
+			report(c == 0 ? "stereo-l" : "stereo-r", name, &result, engine_cases[0].tolerance);
+		}
+
+		// The same sound in a wider format must render to the same sound
+		for (int f = 0; f < NUM_FORMAT_CASES; f++)
+		{
+			render_options_init(&options);
+			options.engine = ENGINE_SCHROEDER;
+			widen(path, wide_path, 1, format_cases[f], WAV_CONTAINER_RIFF);
+			rendered = render_fresh(wide_path, test_path, &options);
+			compare(reference_path, test_path, 0, &result);
+			result.same_length &= rendered;
+			report(sample_format_names[format_cases[f]], name, &result, engine_cases[0].tolerance);
+		}
+
+		// Wave64 input renders to Wave64 output with the same samples
+		render_options_init(&options);
+		options.engine = ENGINE_SCHROEDER;
+		widen(path, wide_path, 1, SAMPLE_S16, WAV_CONTAINER_W64);
+		rendered = render_fresh(wide_path, test_path, &options);
+		compare(reference_path, test_path, 0, &result);
+		result.same_length &= rendered;
+		report("w64", name, &result, engine_cases[0].tolerance);
+
+		// The comb bank has no reference, but rendering it in chunks must give the same sound
+		render_options_init(&options);
+		options.engine = ENGINE_SCHROEDER;
+		options.config.bank_combs = 8;
+		rendered = render_fresh(path, wide_path, &options);
+		options.chunks = 4;
+		rendered &= render_fresh(path, test_path, &options);
+		compare(wide_path, test_path, 0, &result);
+		result.same_length &= rendered;
+		report("bank", name, &result, engine_cases[0].tolerance);
+	}
+
+	unlink(reference_path);
+	unlink(test_path);
+	unlink(wide_path);
+	free(reference_path);
+	free(test_path);
+	free(wide_path);
+}
+
+/*
+		Fills samples with uniform noise in [-1, 1).
+*/
+static void random_fill(float *samples, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		samples[i] = rand() / (RAND_MAX / 2.0f) - 1.0f;
+	}
+}
+
+/*
+		Checks that the kernels without a suffix give exactly the output of the
+		_scalar kernels, for every span length up to a few registers and one long span.
+*/
+static void verify_isa(void)
+{
+	enum { LENGTH = 1031, TAPS = 5 };
+	static float in[TAPS + 3][LENGTH];
+	static float expected[2][LENGTH], actual[2][LENGTH];
+	const float *taps[TAPS];
+	int mismatches = 0;
+
+	srand(1);
+	for (int i = 0; i < TAPS + 3; i++)
+	{
+		random_fill(in[i], LENGTH);
+	}
+	for (int i = 0; i < TAPS; i++)
+	{
+		taps[i] = in[i + 3];
+	}
+
+	for (size_t span = 0; span <= LENGTH; span = span < 40 ? span + 1 : span + 331)
+	{
+		for (int num_taps = 0; num_taps <= TAPS; num_taps++)
+		{
+			kernel_comb_scalar(expected[0], in[0], taps, num_taps, FF_C, FB_C, span);
+			kernel_comb(actual[0], in[0], taps, num_taps, FF_C, FB_C, span);
+			mismatches += memcmp(expected[0], actual[0], span * sizeof(float)) != 0;
+		}
+
+		kernel_all_pass_scalar(expected[0], in[0], in[1], in[2], FF_A, FB_A, span);
+		kernel_all_pass(actual[0], in[0], in[1], in[2], FF_A, FB_A, span);
+		mismatches += memcmp(expected[0], actual[0], span * sizeof(float)) != 0;
+
+		memcpy(expected[0], in[1], span * sizeof(float));
+		memcpy(actual[0], in[1], span * sizeof(float));
+		kernel_accumulate_scalar(expected[0], in[0], span);
+		kernel_accumulate(actual[0], in[0], span);
+		mismatches += memcmp(expected[0], actual[0], span * sizeof(float)) != 0;
+
+		mismatches += kernel_peak_scalar(in[2], span) != kernel_peak(in[2], span);
+
+		for (int part = 0; part < 2; part++)
+		{
+			memcpy(expected[part], in[part + 1], span * sizeof(float));
+			memcpy(actual[part], in[part + 1], span * sizeof(float));
+		}
+		kernel_complex_mac_scalar(expected[0], expected[1], in[0], in[3], in[4], in[5], span);
+		kernel_complex_mac(actual[0], actual[1], in[0], in[3], in[4], in[5], span);
+		mismatches += memcmp(expected[0], actual[0], span * sizeof(float)) != 0;
+		mismatches += memcmp(expected[1], actual[1], span * sizeof(float)) != 0;
+
+		// Samples well past full scale, so every format has to clamp some of them
+		for (size_t j = 0; j < span; j++)
+		{
+			expected[1][j] = in[0][j] * 40000.0f;
+		}
+		for (int f = 0; f < NUM_SAMPLE_FORMATS; f++)
+		{
+			static unsigned char encoded[2][4 * LENGTH];
+			size_t bytes = span * sample_format_bytes(f);
+
+			convert_from_float_scalar(encoded[0], expected[1], f, span);
+			convert_from_float(encoded[1], expected[1], f, span);
+			mismatches += memcmp(encoded[0], encoded[1], bytes) != 0;
+
+			convert_to_float_scalar(expected[0], encoded[0], f, span);
+			convert_to_float(actual[0], encoded[0], f, span);
+			mismatches += memcmp(expected[0], actual[0], span * sizeof(float)) != 0;
+		}
+	}
+
+	// Comb banks of one and two registers of lanes, with delays anywhere in their lines
+	for (int combs = 1; combs <= MAX_BANK_COMBS; combs += 5)
+	{
+		enum { ROWS = 64 };
+		static float line[2][ROWS * MAX_BANK_LANES];
+		float gains[MAX_BANK_LANES], damped[2][MAX_BANK_LANES] = { { 0 } };
+		int delays[MAX_BANK_LANES];
+		int lanes = (combs + 7) / 8 * 8;
+
+		random_fill(line[0], ROWS * lanes);
+		random_fill(gains, lanes);
+		random_fill(damped[0], lanes);
+		memcpy(line[1], line[0], sizeof(line[0]));
+		memcpy(damped[1], damped[0], sizeof(damped[0]));
+		for (int k = 0; k < lanes; k++)
+		{
+			delays[k] = 1 + rand() % (ROWS - 1);
+		}
+
+		kernel_comb_bank_scalar(expected[0], in[0], line[0], delays, gains, damped[0], combs, lanes, ROWS - 1, 60, BANK_FB, BANK_DAMP, LENGTH);
+		kernel_comb_bank(actual[0], in[0], line[1], delays, gains, damped[1], combs, lanes, ROWS - 1, 60, BANK_FB, BANK_DAMP, LENGTH);
+		mismatches += memcmp(expected[0], actual[0], sizeof(expected[0])) != 0;
+		mismatches += memcmp(line[0], line[1], sizeof(line[0])) != 0 || memcmp(damped[0], damped[1], sizeof(damped[0])) != 0;
+	}
+
+	// Interleaving any amount of streams and taking them apart again
+	for (int num_streams = 1; num_streams <= TAPS + 3; num_streams += 3)
+	{
+		static float rows[2][(TAPS + 3) * LENGTH];
+		static float planar[2][TAPS + 3][LENGTH];
+		const float *streams_in[TAPS + 3];
+		float *streams_out[2][TAPS + 3];
+
+		for (int k = 0; k < num_streams; k++)
+		{
+			streams_in[k] = in[k % (TAPS + 3)] + k;
+			streams_out[0][k] = planar[0][k];
+			streams_out[1][k] = planar[1][k];
+		}
+
+		size_t count = LENGTH - TAPS - 3;
+		kernel_interleave_scalar(rows[0], streams_in, num_streams, count);
+		kernel_interleave(rows[1], streams_in, num_streams, count);
+		mismatches += memcmp(rows[0], rows[1], count * num_streams * sizeof(float)) != 0;
+
+		kernel_deinterleave_scalar(streams_out[0], rows[0], num_streams, count);
+		kernel_deinterleave(streams_out[1], rows[0], num_streams, count);
+		for (int k = 0; k < num_streams; k++)
+		{
+			mismatches += memcmp(planar[0][k], planar[1][k], count * sizeof(float)) != 0;
+			mismatches += memcmp(planar[0][k], streams_in[k], count * sizeof(float)) != 0;
+		}
+	}
+
+	// Hadamard matrices of every size, with rows that start anywhere in a register
+	for (int rows = 2; rows <= MAX_HADAMARD_ROWS; rows *= 2)
+	{
+		static float mixed[2][MAX_HADAMARD_ROWS][LENGTH];
+		const float *rows_in[MAX_HADAMARD_ROWS];
+		float *rows_out[2][MAX_HADAMARD_ROWS];
+		float gains[MAX_HADAMARD_ROWS];
+
+		random_fill(gains, rows);
+		for (int k = 0; k < rows; k++)
+		{
+			rows_in[k] = in[k % (TAPS + 3)] + k;
+			rows_out[0][k] = mixed[0][k];
+			rows_out[1][k] = mixed[1][k];
+		}
+
+		kernel_hadamard_scalar(rows_out[0], rows_in, gains, rows, LENGTH - MAX_HADAMARD_ROWS);
+		kernel_hadamard(rows_out[1], rows_in, gains, rows, LENGTH - MAX_HADAMARD_ROWS);
+		mismatches += memcmp(mixed[0], mixed[1], sizeof(mixed[0])) != 0;
+	}
+
+	printf("%-10s %-28s %d mismatches  %s\n", "kernels", kernel_isa(), mismatches, mismatches == 0 ? "ok" : "FAIL");
+	failures += mismatches != 0;
+}
+
+/*
+		Runs verify_isa with the kernels of every instruction set the processor
+		supports, then goes back to the ones the rest of the checks use.
+*/
+static void verify_kernels(const char *isa)
+{
+	static const char *const names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		if (kernel_use_isa(names[i]) == 0)
+		{
+			verify_isa();
+		}
+		else
+		{
+			printf("%-10s %-28s not supported here\n", "kernels", names[i]);
+		}
+	}
+	kernel_use_isa(isa);
+}
+
+/*
+		Sends an impulse through the feedback delay network of every size and
+		checks that it decays by 60 dB in fdn_decay seconds (within 3 dB),
+		and that the same samples come out when they are processed in
+		blocks of a few samples.
+*/
+static void verify_fdn(void)
+{
+	enum { RATE = 44100, WINDOW = RATE / 20 };
+	CVerbConfig config;
+	config_init(&config);
+	size_t length = (size_t) ((config.fdn_decay + 0.3) * RATE);
+	float *in = calloc(length, sizeof(float));
+	float *whole = malloc(length * sizeof(float));
+	float *pieces = malloc(length * sizeof(float));
+
+	in[0] = 1;
+	for (int lines = 4; lines <= MAX_FDN_LINES; lines *= 2)
+	{
+		config.fdn_lines = lines;
+		FdnState *state = fdn_state_create(&config, RATE);
+		fdn_process_block(state, in, whole, length);
+		fdn_state_free(state);
+
+		state = fdn_state_create(&config, RATE);
+		for (size_t done = 0, block = 1; done < length; done += block, block = block % 7 + 1)
+		{
+			fdn_process_block(state, in + done, pieces + done, done + block < length ? block : length - done);
+		}
+		fdn_state_free(state);
+
+		// Energy of a window once the echoes are dense, and of the same window fdn_decay seconds later
+		double early = 0, late = 0;
+		size_t start = (size_t) (0.2 * RATE), decayed = start + (size_t) (config.fdn_decay * RATE);
+		for (size_t j = 0; j < WINDOW; j++)
+		{
+			early += (double) whole[start + j] * whole[start + j];
+			late += (double) whole[decayed + j] * whole[decayed + j];
+		}
+		double decay_db = 10 * log10(early / late);
+
+		char name[64];
+		int ok = memcmp(whole, pieces, length * sizeof(float)) == 0 && fabs(decay_db - 60) < 3;
+		snprintf(name, sizeof(name), "%d lines", lines);
+		printf("%-10s %-28s decays %.1f dB in %.1f s  %s\n", "fdn", name, decay_db, config.fdn_decay, ok ? "ok" : "FAIL");
+		failures += !ok;
+	}
+
+	free(in);
+	free(whole);
+	free(pieces);
+}
+
+/*
+		Runs two libcverb engines of every kind on different signals, a few
+		frames of one and then of the other, and checks that each gives
+		exactly the output of an engine that ran alone. Then resets one and
+		checks that it starts over like a new engine.
+*/
+static void verify_library(void)
+{
+	enum { RATE = 22050, CHANNELS = 2, FRAMES = 20000 };
+	static const EngineType engines[] = { ENGINE_SCHROEDER, ENGINE_CONVOLUTION, ENGINE_FIXED, ENGINE_FDN };
+	static const char *names[] = { "schroeder", "conv", "fixed", "fdn" };
+	static float in[2][FRAMES * CHANNELS], out[2][FRAMES * CHANNELS], alone[FRAMES * CHANNELS];
+	CVerbConfig config;
+
+	config_init(&config);
+	srand(2);
+	for (int i = 0; i < 2; i++)
+	{
+		random_fill(in[i], FRAMES * CHANNELS);
+		for (size_t j = 0; j < FRAMES * CHANNELS; j++)
+		{
+			in[i][j] *= SIGNAL_AMPLITUDE;
+		}
+	}
+
+	for (int e = 0; e < 4; e++)
+	{
+		CVerbEngine *engine[2];
+		for (int i = 0; i < 2; i++)
+		{
+			engine[i] = cverb_engine_create(engines[e], &config, NULL, RATE, CHANNELS, 1 + i);
+		}
+		for (size_t done = 0, block = 1; done < FRAMES; done += block, block = block * 3 % 1000 + 1)
+		{
+			block = done + block < FRAMES ? block : FRAMES - done;
+			for (int i = 0; i < 2; i++)
+			{
+				cverb_engine_process(engine[i], in[i] + done * CHANNELS, out[i] + done * CHANNELS, block);
+			}
+		}
+
+		CVerbEngine *single = cverb_engine_create(engines[e], &config, NULL, RATE, CHANNELS, 1);
+		cverb_engine_process(single, in[0], alone, FRAMES);
+		int ok = memcmp(out[0], alone, sizeof(alone)) == 0;
+
+		ok &= cverb_engine_reset(engine[0]) == 0;
+		cverb_engine_process(engine[0], in[0], out[0], FRAMES);
+		ok &= memcmp(out[0], alone, sizeof(alone)) == 0;
+
+		cverb_engine_destroy(single);
+		for (int i = 0; i < 2; i++)
+		{
+			cverb_engine_destroy(engine[i]);
+		}
+
+		printf("%-10s %-28s %s\n", "library", names[e], ok ? "ok" : "FAIL");
+		failures += !ok;
+	}
+}
+
+/*
+		Runs different signals through the streams of a CVerbStreams in
+		blocks of a few samples and checks that every stream gives exactly
+		the output of the block engine on that signal alone. Stream counts
+		that are not a multiple of a register cover the scalar edges.
+*/
+static void verify_streams(void)
+{
+	enum { RATE = 22050, FRAMES = 12000, MOST = 16 };
+	static const int counts[] = { 1, 3, 8, MOST };
+	static float in[MOST][FRAMES], out[MOST][FRAMES], alone[FRAMES];
+	float *out_rows[MOST];
+	const float *in_rows[MOST];
+	CVerbConfig config;
+
+	config_init(&config);
+	srand(3);
+	for (int s = 0; s < MOST; s++)
+	{
+		random_fill(in[s], FRAMES);
+		for (size_t j = 0; j < FRAMES; j++)
+		{
+			in[s][j] *= SIGNAL_AMPLITUDE;
+		}
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		int num_streams = counts[c];
+		CVerbStreams *streams = cverb_streams_create(&config, RATE, num_streams);
+
+		for (size_t done = 0, block = 1; done < FRAMES; done += block, block = block * 5 % 600 + 1)
+		{
+			block = done + block < FRAMES ? block : FRAMES - done;
+			for (int s = 0; s < num_streams; s++)
+			{
+				in_rows[s] = in[s] + done;
+				out_rows[s] = out[s] + done;
+			}
+			cverb_streams_process(streams, in_rows, out_rows, block);
+		}
+		cverb_streams_free(streams);
+
+		int ok = 1;
+		for (int s = 0; s < num_streams; s++)
+		{
+			CVerbState *state = cverb_state_create(&config, RATE);
+			cverb_process_block(state, in[s], alone, FRAMES);
+			cverb_state_free(state);
+			ok &= memcmp(out[s], alone, sizeof(alone)) == 0;
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "%d stream%s", num_streams, num_streams == 1 ? "" : "s");
+		printf("%-10s %-28s %s\n", "streams", name, ok ? "ok" : "FAIL");
+		failures += !ok;
+	}
+}
+
+/*
+		Runs bursts of noise with long pauses through the block engine, once
+		with the silence bypass and once without. Once the tail has died
+		away the bypass must skip stages and give exact silence, and
+		everywhere else it may only differ by about the silence level. Then
+		lets an impulse decay for half a minute without the bypass: the tail
+		must never hold subnormals, which are flushed to zero wherever the
+		kernels are vectorized.
+*/
+static void verify_silence(void)
+{
+	enum { RATE = 22050, BLOCK = 512, BURST = 20 * BLOCK, PAUSE = 200 * BLOCK, FRAMES = 3 * (BURST + PAUSE) };
+	static float in[FRAMES], bypassed[FRAMES], exact[FRAMES];
+	CVerbConfig config, never;
+
+	config_init(&config);
+	config.silence = SILENCE_LEVEL;
+	never = config;
+	never.silence = -1;
+	srand(5);
+	memset(in, 0, sizeof(in));
+	for (size_t start = 0; start < FRAMES; start += BURST + PAUSE)
+	{
+		random_fill(in + start, BURST);
+		for (size_t j = start; j < start + BURST; j++)
+		{
+			in[j] *= SIGNAL_AMPLITUDE;
+		}
+	}
+
+	CVerbState *state = cverb_state_create(&config, RATE);
+	CVerbState *reference = cverb_state_create(&never, RATE);
+	for (size_t done = 0; done < FRAMES; done += BLOCK)
+	{
+		cverb_process_block(state, in + done, bypassed + done, BLOCK);
+		cverb_process_block(reference, in + done, exact + done, BLOCK);
+	}
+
+	float largest = 0;
+	size_t silent = 0;
+	for (size_t j = 0; j < FRAMES; j++)
+	{
+		float error = fabsf(bypassed[j] - exact[j]);
+		largest = error > largest ? error : largest;
+		silent += bypassed[j] == 0;
+	}
+
+	// The tail takes about three seconds to die away, the last quarter of every pause is silent
+	int ok = state->bypassed > 0 && reference->bypassed == 0 && largest < 100 * config.silence &&
+	         silent >= 3 * (size_t) PAUSE / 4 && bypassed[FRAMES - 1] == 0;
+	printf("%-10s %-28s %zu silent, error %.1e  %s\n", "silence", "bypass", silent, largest, ok ? "ok" : "FAIL");
+	failures += !ok;
+	cverb_state_free(state);
+	cverb_state_free(reference);
+
+	// An impulse takes about 25 seconds to decay into subnormals
+	enum { TAIL_RATE = 8000, TAIL = 30 * TAIL_RATE / BLOCK * BLOCK };
+	size_t subnormals = 0;
+	reference = cverb_state_create(&never, TAIL_RATE);
+	memset(in, 0, BLOCK * sizeof(float));
+	in[0] = SIGNAL_AMPLITUDE;
+	for (size_t done = 0; done < TAIL; done += BLOCK)
+	{
+		cverb_process_block(reference, in, exact, BLOCK);
+		in[0] = 0;
+		for (size_t j = 0; j < BLOCK; j++)
+		{
+			subnormals += fpclassify(exact[j]) == FP_SUBNORMAL;
+		}
+	}
+	cverb_state_free(reference);
+#if defined(__SSE2__)
+	ok = subnormals == 0 && exact[BLOCK - 1] == 0;
+#else
+	ok = 1;
+#endif
+	printf("%-10s %-28s %zu subnormals  %s\n", "silence", "30 s tail", subnormals, ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/*
+		Renders a short test signal with the tail flushed after the input
+		and checks that the output is longer than the input but not by more
+		than the tail can take, and that it ends quiet.
+*/
+static void verify_tail(void)
+{
+	enum { RATE = 22050 };
+	char *in_path = test_temp_file();
+	char *out_path = test_temp_file();
+	size_t frames = RATE / 2;
+	TestSignal signal;
+	RenderOptions options;
+
+	test_signal_init(&signal, 1, RATE, frames, SIGNAL_AMPLITUDE);
+	test_signal_write(&signal, in_path);
+	render_options_init(&options);
+	options.tail_db = 60;
+	int ok = render_file(in_path, out_path, &options) == 0;
+
+	FILE *file;
+	WaveHeader header;
+	WavReader *reader = open_samples(out_path, &file, &header);
+	size_t length = 0;
+	int16_t last = 0;
+	if (reader != NULL)
+	{
+		int16_t block[BLOCK_FRAMES];
+		size_t count;
+		while ((count = read_s16(reader, SAMPLE_S16, block, BLOCK_FRAMES)) > 0)
+		{
+			length += count;
+			last = block[count - 1];
+		}
+		wav_reader_close(reader);
+		fclose(file);
+	}
+	ok &= reader != NULL && header.data_size == length * sizeof(int16_t) && length > frames &&
+	      length <= frames + IR_MAX_SECONDS * RATE && abs(last) < SIGNAL_AMPLITUDE / 1000;
+
+	printf("%-10s %-28s %zu frames after %zu  %s\n", "tail", "-60 dB", length, frames, ok ? "ok" : "FAIL");
+	failures += !ok;
+	unlink(in_path);
+	unlink(out_path);
+	free(in_path);
+	free(out_path);
+}
+
+/*
+		Returns 1 if the two files have the same bytes.
+*/
+static int same_files(const char *path_a, const char *path_b)
+{
+	FILE *a = fopen(path_a, "rb");
+	FILE *b = fopen(path_b, "rb");
+	int same = a != NULL && b != NULL;
+
+	while (same)
+	{
+		unsigned char block_a[4096], block_b[4096];
+		size_t count_a = fread(block_a, 1, sizeof(block_a), a);
+		size_t count_b = fread(block_b, 1, sizeof(block_b), b);
+
+		same = count_a == count_b && memcmp(block_a, block_b, count_a) == 0;
+		if (count_a == 0)
+		{
+			break;
+		}
+	}
+
+	if (a != NULL)
+	{
+		fclose(a);
+	}
+	if (b != NULL)
+	{
+		fclose(b);
+	}
+	return same;
+}
+
+/*
+		Renders a stereo signal long enough to send every block of the
+		pipeline round more than once, serially and pipelined, and checks
+		that both write the same file. Covers converted output, float
+		passthrough and a flushed tail.
+*/
+static void verify_pipeline(void)
+{
+	enum { RATE = 22050 };
+	char *in_path = test_temp_file();
+	char *float_path = test_temp_file();
+	char *serial_path = test_temp_file();
+	char *pipelined_path = test_temp_file();
+	size_t frames = 2 * PIPELINE_BLOCKS * BLOCK_FRAMES + 123;
+	TestSignal signal;
+
+	test_signal_init(&signal, 2, RATE, frames, SIGNAL_AMPLITUDE);
+	test_signal_write(&signal, in_path);
+
+	RenderOptions options;
+	render_options_init(&options);
+	options.out_format = SAMPLE_F32;
+	int prepared = render_fresh(in_path, float_path, &options);
+
+	const struct
+	{
+		const char *name;
+		const char *input;
+		int out_format;
+		double tail_db;
+	} cases[] = {
+		{ "16-bit", in_path, -1, 0 },
+		{ "24-bit out", in_path, SAMPLE_S24, 0 },
+		{ "float passthrough", float_path, -1, 0 },
+		{ "16-bit -60 dB tail", in_path, -1, 60 }
+	};
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		PipelineStats stats = {0};
+
+		render_options_init(&options);
+		options.out_format = cases[i].out_format;
+		options.tail_db = cases[i].tail_db;
+		int ok = (cases[i].input != float_path || prepared) && render_file(cases[i].input, serial_path, &options) == 0;
+		options.pipelined = 1;
+		options.stats = &stats;
+		ok &= render_file(cases[i].input, pipelined_path, &options) == 0;
+		ok &= same_files(serial_path, pipelined_path) && stats.blocks > PIPELINE_BLOCKS;
+
+		printf("%-10s %-28s %zu blocks  %s\n", "pipeline", cases[i].name, stats.blocks, ok ? "ok" : "FAIL");
+		failures += !ok;
+	}
+
+	unlink(in_path);
+	unlink(float_path);
+	unlink(serial_path);
+	unlink(pipelined_path);
+	free(in_path);
+	free(float_path);
+	free(serial_path);
+	free(pipelined_path);
+}
+
+/* A control thread that keeps retuning a live engine, see verify_live */
+typedef struct
+{
+	CVerbLive *live;
+	const CVerbConfig *configs;
+	int num_configs;
+	int rounds;
+	atomic_int finished;
+} Retuner;
+
+static void *retune_thread(void *arg)
+{
+	Retuner *retuner = arg;
+
+	for (int r = 0; r < retuner->rounds; r++)
+	{
+		cverb_live_publish(retuner->live, &retuner->configs[r % retuner->num_configs]);
+		usleep(100);
+	}
+	atomic_store(&retuner->finished, 1);
+
+	return NULL;
+}
+
+/* Largest change of slope between neighbouring samples of out[start, end) */
+static float largest_step(const float *out, size_t start, size_t end)
+{
+	float largest = 0;
+
+	for (size_t j = start; j < end; j++)
+	{
+		float step = fabsf(out[j] - 2 * out[j - 1] + out[j - 2]);
+		largest = step > largest ? step : largest;
+	}
+
+	return largest;
+}
+
+/*
+		Checks live retuning. A live engine that is handed its own config
+		again must give exactly the output of a plain block engine. A sine
+		through a retune of every gain and the delay must not step further
+		between samples than it does before or after the ramp, and the
+		state must end up on the new delays. Configs that change the
+		structure or do not fit must be rejected, and configs published
+		from another thread while the audio thread runs must all land.
+*/
+static void verify_live(void)
+{
+	enum { RATE = 44100, FRAMES = 3 * RATE, BLOCK = 64, CHANGE = 1024 * BLOCK, SETTLE = 4096, WINDOW = RATE / 4 };
+	static float in[FRAMES], out[FRAMES], alone[FRAMES];
+	CVerbConfig config, retuned, rejected;
+
+	config_init(&config);
+	config.max_delay_ms = 2 * config.delay_ms;
+	srand(4);
+	random_fill(in, FRAMES);
+	for (size_t j = 0; j < FRAMES; j++)
+	{
+		in[j] *= SIGNAL_AMPLITUDE;
+	}
+
+	CVerbLive *live = cverb_live_create(&config, RATE);
+	for (size_t done = 0, block = 1; done < FRAMES; done += block, block = block * 7 % 500 + 1)
+	{
+		block = done + block < FRAMES ? block : FRAMES - done;
+		if (done > CHANGE)
+		{
+			cverb_live_publish(live, &config);
+		}
+		cverb_live_process(live, in + done, out + done, block);
+	}
+	int ok = atomic_load(&live->applied) > 0;
+	cverb_live_free(live);
+
+	CVerbState *state = cverb_state_create(&config, RATE);
+	cverb_process_block(state, in, alone, FRAMES);
+	cverb_state_free(state);
+	ok &= memcmp(out, alone, sizeof(alone)) == 0;
+	printf("%-10s %-28s %s\n", "live", "same config", ok ? "ok" : "FAIL");
+	failures += !ok;
+
+	// The slope of a sine changes slowly, so a click shows up as one sudden change of slope
+	for (size_t j = 0; j < FRAMES; j++)
+	{
+		in[j] = SIGNAL_AMPLITUDE * sinf(2 * (float) M_PI * 440 * j / RATE);
+	}
+	retuned = config;
+	retuned.delay_ms = 1.5 * config.delay_ms;
+	retuned.comb_fb = 0.4f;
+	retuned.all_pass_ff = 0.3f;
+	retuned.all_pass_fb = 0.05f;
+	live = cverb_live_create(&config, RATE);
+	for (size_t done = 0; done < FRAMES; done += BLOCK)
+	{
+		if (done == CHANGE)
+		{
+			cverb_live_publish(live, &retuned);
+		}
+		cverb_live_process(live, in + done, out + done, done + BLOCK < FRAMES ? BLOCK : FRAMES - done);
+	}
+	float before = largest_step(out, CHANGE - WINDOW, CHANGE);
+	float during = largest_step(out, CHANGE, CHANGE + SETTLE);
+	float after = largest_step(out, CHANGE + SETTLE, CHANGE + SETTLE + WINDOW);
+	ok = during <= 2 * before && after <= 2 * before &&
+	     live->state->all_pass_delay == (int) (retuned.delay_ms * RATE / 1000) && live->state->comb_fb == retuned.comb_fb;
+
+	// Neither a different network nor a delay past the lines may get through
+	rejected = retuned;
+	rejected.num_combs--;
+	ok &= cverb_live_publish(live, &rejected) == -1;
+	rejected = retuned;
+	rejected.delay_ms = 4 * config.delay_ms;
+	ok &= cverb_live_publish(live, &rejected) == -1;
+	cverb_live_free(live);
+	printf("%-10s %-28s slope steps %.0f, %.0f, %.0f  %s\n", "live", "retune", before, during, after, ok ? "ok" : "FAIL");
+	failures += !ok;
+
+	// Publish from another thread as fast as it goes, then let the last config land
+	CVerbConfig configs[2] = { config, retuned };
+	Retuner retuner = { cverb_live_create(&config, RATE), configs, 2, 500, 0 };
+	pthread_t control;
+	pthread_create(&control, NULL, retune_thread, &retuner);
+	for (size_t done = 0; !atomic_load(&retuner.finished); done = (done + BLOCK) % (FRAMES - BLOCK))
+	{
+		cverb_live_process(retuner.live, in + done, out + done, BLOCK);
+	}
+	pthread_join(control, NULL);
+	for (size_t done = 0; done < 4 * RAMP_FRAMES; done += BLOCK)
+	{
+		cverb_live_process(retuner.live, in + done, out + done, BLOCK);
+	}
+	const CVerbConfig *last = &configs[(retuner.rounds - 1) % 2];
+	ok = retuner.live->state->ramp_length == 0 && retuner.live->state->comb_fb == last->comb_fb &&
+	     retuner.live->state->all_pass_delay == (int) (last->delay_ms * RATE / 1000);
+	char name[64];
+	snprintf(name, sizeof(name), "%u of %d picked up", atomic_load(&retuner.live->applied), retuner.rounds);
+	printf("%-10s %-28s %s\n", "live", name, ok ? "ok" : "FAIL");
+	failures += !ok;
+	cverb_live_free(retuner.live);
+}
+
+/*
+		Checks the range calls of the circular buffer. Runs of every length
+		up to the capacity are put and got back from every start slot, so
+		they wrap at the end of the storage, and must land in the slots the
+		wrap leads to. A full ring must reject what does not fit, while an
+		empty one hands out nothing.
+*/
+static int check_circular_ranges(void)
+{
+	enum { CAPACITY = 8 };
+	int16_t storage[CAPACITY], in[CAPACITY + 2], out[CAPACITY + 2];
+	cbuf_handle_t ring = circular_buf_init(storage, CAPACITY);
+	int ok = circular_buf_get_range(ring, out, 1) == 0 && circular_buf_empty(ring);
+
+	for (int16_t start = 0; start < CAPACITY; start++)
+	{
+		for (int16_t run = 1; run <= CAPACITY; run++)
+		{
+			// Single puts and gets move the start to the slot under test
+			circular_buf_reset(ring);
+			for (int16_t i = 0; i < start; i++)
+			{
+				circular_buf_put2(ring, 0);
+				circular_buf_get(ring, out);
+			}
+			// A second run starts where the first one left the ring, such as right at the end
+			for (int16_t slot = start; slot < start + 2 * run; slot += run)
+			{
+				for (int16_t i = 0; i < run; i++)
+				{
+					in[i] = 100 * slot + run + i;
+				}
+				ok &= circular_buf_put_range(ring, in, run) == (size_t) run && circular_buf_size(ring) == (size_t) run;
+				for (int16_t i = 0; i < run; i++)
+				{
+					ok &= storage[(slot + i) % CAPACITY] == in[i];
+				}
+				ok &= circular_buf_get_range(ring, out, CAPACITY) == (size_t) run && memcmp(in, out, run * sizeof(int16_t)) == 0;
+				ok &= circular_buf_empty(ring);
+			}
+		}
+	}
+
+	for (int16_t i = 0; i < CAPACITY + 2; i++)
+	{
+		in[i] = i;
+	}
+	circular_buf_reset(ring);
+	circular_buf_put2(ring, 0);
+	circular_buf_get(ring, out);
+	ok &= circular_buf_put_range(ring, in, CAPACITY + 2) == CAPACITY && circular_buf_full(ring);
+	ok &= circular_buf_put_range(ring, in, 1) == 0 && circular_buf_put2(ring, 0) == -1;
+	ok &= circular_buf_get_range(ring, out, CAPACITY + 2) == CAPACITY && memcmp(in, out, CAPACITY * sizeof(int16_t)) == 0;
+	ok &= circular_buf_get_range(ring, out, 1) == 0 && circular_buf_get(ring, out) == -1;
+	circular_buf_free(ring);
+
+	return ok;
+}
+
+/* Same as check_circular_ranges, for the lock-free ring */
+static int check_spsc_ranges(void)
+{
+	enum { CAPACITY = 8 };
+	uint32_t storage[CAPACITY], in[CAPACITY + 2], out[CAPACITY + 2];
+	spsc_handle_t ring = spsc_buf_init(storage, sizeof(uint32_t), CAPACITY);
+	int ok = spsc_buf_get_range(ring, out, 1) == 0 && spsc_buf_empty(ring);
+
+	for (uint32_t start = 0; start < CAPACITY; start++)
+	{
+		for (uint32_t run = 1; run <= CAPACITY; run++)
+		{
+			spsc_buf_reset(ring);
+			for (uint32_t i = 0; i < start; i++)
+			{
+				spsc_buf_put_range(ring, in, 1);
+				spsc_buf_get_range(ring, out, 1);
+			}
+			for (uint32_t slot = start; slot < start + 2 * run; slot += run)
+			{
+				for (uint32_t i = 0; i < run; i++)
+				{
+					in[i] = 100 * slot + run + i;
+				}
+				ok &= spsc_buf_put_range(ring, in, run) == run && spsc_buf_size(ring) == run;
+				for (uint32_t i = 0; i < run; i++)
+				{
+					ok &= storage[(slot + i) % CAPACITY] == in[i];
+				}
+				ok &= spsc_buf_get_range(ring, out, CAPACITY) == run && memcmp(in, out, run * sizeof(uint32_t)) == 0;
+				ok &= spsc_buf_empty(ring);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < CAPACITY + 2; i++)
+	{
+		in[i] = i;
+	}
+	spsc_buf_reset(ring);
+	spsc_buf_put_range(ring, in, 1);
+	spsc_buf_get_range(ring, out, 1);
+	ok &= spsc_buf_put_range(ring, in, CAPACITY + 2) == CAPACITY && spsc_buf_full(ring);
+	ok &= spsc_buf_put_range(ring, in, 1) == 0;
+	ok &= spsc_buf_get_range(ring, out, CAPACITY + 2) == CAPACITY && memcmp(in, out, CAPACITY * sizeof(uint32_t)) == 0;
+	ok &= spsc_buf_get_range(ring, out, 1) == 0;
+	spsc_buf_free(ring);
+
+	return ok;
+}
+
+/* The producer thread of verify_rings, which puts 1 to count in runs of varying length */
+typedef struct
+{
+	spsc_handle_t ring;
+	uint32_t count;
+} RingProducer;
+
+static void *produce_ring(void *arg)
+{
+	RingProducer *producer = arg;
+	uint32_t run[13];
+	uint32_t next = 1;
+
+	for (size_t length = 1; next <= producer->count; length = length % 13 + 1)
+	{
+		size_t wanted = producer->count - next + 1 < length ? producer->count - next + 1 : length;
+		for (size_t i = 0; i < wanted; i++)
+		{
+			run[i] = next + i;
+		}
+
+		size_t put = spsc_buf_put_range(producer->ring, run, wanted);
+		next += put;
+		if (put == 0)
+		{
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+/*
+		Checks the circular buffer and the lock-free ring: wrap around at
+		the end of the storage, full and empty rings, and a producer and a
+		consumer thread passing a counting sequence through a small ring,
+		which must arrive complete and in order.
+*/
+static void verify_rings(void)
+{
+	enum { CAPACITY = 64, COUNT = 1 << 20 };
+	int ok = check_circular_ranges();
+	printf("%-10s %-28s %s\n", "ring", "circular wrap, full, empty", ok ? "ok" : "FAIL");
+	failures += !ok;
+
+	ok = check_spsc_ranges();
+	printf("%-10s %-28s %s\n", "ring", "spsc wrap, full, empty", ok ? "ok" : "FAIL");
+	failures += !ok;
+
+	static uint32_t storage[CAPACITY];
+	RingProducer producer = { spsc_buf_init(storage, sizeof(uint32_t), CAPACITY), COUNT };
+	pthread_t thread;
+	pthread_create(&thread, NULL, produce_ring, &producer);
+
+	uint32_t run[11];
+	uint32_t expected = 1;
+	uint64_t sum = 0;
+	ok = 1;
+	for (size_t length = 1; expected <= COUNT; length = length % 11 + 1)
+	{
+		size_t got = spsc_buf_get_range(producer.ring, run, length);
+		for (size_t i = 0; i < got; i++)
+		{
+			ok &= run[i] == expected++;
+			sum += run[i];
+		}
+		if (got == 0)
+		{
+			sched_yield();
+		}
+	}
+	pthread_join(thread, NULL);
+	ok &= sum == (uint64_t) COUNT * (COUNT + 1) / 2 && spsc_buf_empty(producer.ring);
+	spsc_buf_free(producer.ring);
+	printf("%-10s %-28s %s\n", "ring", "spsc two threads", ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/* A task of verify_pool, which records the worker that ran it and when */
+typedef struct
+{
+	atomic_int *next;
+	pthread_t worker;
+	int order;
+} PoolJob;
+
+/* Holds every worker of a pool until the test has queued its jobs */
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	int waiting;
+	int open;
+} PoolGate;
+
+static void run_pool_job(void *arg)
+{
+	PoolJob *job = arg;
+
+	job->worker = pthread_self();
+	job->order = atomic_fetch_add(job->next, 1);
+}
+
+static void hold_worker(void *arg)
+{
+	PoolGate *gate = arg;
+
+	pthread_mutex_lock(&gate->lock);
+	gate->waiting++;
+	pthread_cond_broadcast(&gate->changed);
+	while (!gate->open)
+	{
+		pthread_cond_wait(&gate->changed, &gate->lock);
+	}
+	pthread_mutex_unlock(&gate->lock);
+}
+
+/*
+		Checks that every worker of the pool starts on the largest job dealt
+		to its queue when jobs are submitted largest first, as render_batch
+		does. The workers are held until all jobs are queued, and a worker
+		only steals once its own queue is empty, so its first job is always
+		one of its own. Later it may steal any job.
+*/
+static void verify_pool(void)
+{
+	enum { THREADS = 3, JOBS = 20 };
+	PoolGate gate = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 };
+	PoolJob jobs[JOBS];
+	atomic_int next = 0;
+
+	ThreadPool *pool = pool_create(THREADS);
+	for (int i = 0; i < THREADS; i++)
+	{
+		pool_submit(pool, hold_worker, &gate);
+	}
+	pthread_mutex_lock(&gate.lock);
+	while (gate.waiting < THREADS)
+	{
+		pthread_cond_wait(&gate.changed, &gate.lock);
+	}
+	pthread_mutex_unlock(&gate.lock);
+
+	for (int i = 0; i < JOBS; i++)
+	{
+		jobs[i].next = &next;
+		pool_submit(pool, run_pool_job, &jobs[i]);
+	}
+	pthread_mutex_lock(&gate.lock);
+	gate.open = 1;
+	pthread_cond_broadcast(&gate.changed);
+	pthread_mutex_unlock(&gate.lock);
+	pool_free(pool);
+
+	int ok = 1;
+	for (int i = 0; i < JOBS; i++)
+	{
+		int first = 1;
+		for (int j = 0; j < JOBS; j++)
+		{
+			first &= !pthread_equal(jobs[i].worker, jobs[j].worker) || jobs[j].order >= jobs[i].order;
+		}
+		// The jobs stand for files sorted largest first, dealt round robin, so
+		// the largest of every queue is among the first THREADS jobs
+		ok &= !first || i < THREADS;
+	}
+	printf("%-10s %-28s %s\n", "pool", "largest job first", ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/*
+		Writes a header with write_wav_header, reads it back with parse_wav and
+		checks every field, the position of the sample data and that parse_wav
+		copies the header verbatim. Headers past 4 GB must come out as RF64,
+		and the overall size counts the padding after odd data.
+*/
+static void verify_header(const char *name, unsigned int channels, unsigned int sample_rate, uint64_t data_size, SampleFormat format, WavContainer container)
+{
+	WaveHeader written, parsed;
+	SampleFormat parsed_format;
+	unsigned char original[128], copied[128];
+	int ok = 1;
+
+	test_signal_header(&written, sample_rate, 0);
+	written.channels = channels;
+	written.container = container;
+	wav_set_sample_format(&written, format);
+
+	// Length of the header, container and overall size it should be read back with
+	int unknown = data_size == WAV_UNKNOWN_SIZE;
+	long length = 44;
+	const char *riff = "RIFF";
+	WavContainer parsed_container = WAV_CONTAINER_RIFF;
+	uint64_t padding = data_size & 1;
+	uint64_t overall_size = unknown ? WAV_UNKNOWN_SIZE : data_size + padding + 36;
+	if (container == WAV_CONTAINER_W64)
+	{
+		length = 104;
+		riff = "riff";
+		parsed_container = WAV_CONTAINER_W64;
+		padding = (8 - data_size % 8) % 8;
+		overall_size = unknown ? WAV_UNKNOWN_SIZE : data_size + padding + 104;
+	}
+	else if (unknown)
+	{
+		length = 80;
+	}
+	else if (data_size + 36 >= 0xFFFFFFFF)
+	{
+		length = 80;
+		riff = "RF64";
+		parsed_container = WAV_CONTAINER_RF64;
+		overall_size = data_size + padding + 72;
+	}
+
+	FILE *file = tmpfile();
+	FILE *copy = tmpfile();
+	write_wav_header(file, &written, data_size);
+	ok &= ftell(file) == length;
+	rewind(file);
+	ok &= fread(original, 1, length, file) == (size_t) length;
+
+	rewind(file);
+	memset(&parsed, 0, sizeof(parsed));
+	parse_wav(file, copy, &parsed);
+	ok &= ftell(file) == length;
+	ok &= memcmp(parsed.riff, riff, 4) == 0 && parsed.container == parsed_container;
+	ok &= memcmp(parsed.fmt_chunk_marker, "fmt ", 4) == 0 && memcmp(parsed.data_chunk_header, "data", 4) == 0;
+	ok &= parsed.length_of_fmt == 16 && parsed.format_type == written.format_type;
+	ok &= wav_sample_format(&parsed, &parsed_format) == 0 && parsed_format == format;
+	ok &= parsed.channels == channels && parsed.sample_rate == sample_rate;
+	ok &= parsed.bits_per_sample == written.bits_per_sample && parsed.block_align == written.block_align;
+	ok &= parsed.byterate == written.byterate;
+	ok &= parsed.data_size == data_size;
+	ok &= parsed.overall_size == overall_size;
+
+	// The header claims more data than the file has, only what is there may be read
+	ok &= wav_sample_count(file, &parsed) == 0;
+
+	rewind(copy);
+	ok &= fread(copied, 1, length, copy) == (size_t) length && memcmp(original, copied, length) == 0;
+
+	fclose(file);
+	fclose(copy);
+
+	printf("%-10s %-28s %s\n", "header", name, ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/*
+		Streams samples of unknown length through a WavWriter and checks that
+		closing it fills in the header, then grows the same header past 4 GB
+		and checks that it turns into RF64 in place.
+*/
+static void verify_header_finish(void)
+{
+	int16_t samples[1000] = { 0 };
+	WaveHeader written, parsed;
+	int ok = 1;
+
+	test_signal_header(&written, 48000, 0);
+	FILE *file = tmpfile();
+	WavWriter *writer = wav_writer_open(file, &written, WAV_UNKNOWN_SIZE);
+	ok &= writer != NULL && wav_writer_write(writer, samples, 1000) == 0 && wav_writer_close(writer) == 0;
+	ok &= ftell(file) == 80 + sizeof(samples);
+
+	rewind(file);
+	parse_wav(file, NULL, &parsed);
+	ok &= memcmp(parsed.riff, "RIFF", 4) == 0 && parsed.container == WAV_CONTAINER_RIFF;
+	ok &= ftell(file) == 80 && parsed.data_size == sizeof(samples) && parsed.overall_size == 72 + sizeof(samples);
+	ok &= wav_sample_count(file, &parsed) == 1000;
+
+	uint64_t large = 5000000000ull;
+	ok &= wav_finish_header(file, &written, WAV_UNKNOWN_SIZE, large) == 0 && ftell(file) == 80 + sizeof(samples);
+	rewind(file);
+	parse_wav(file, NULL, &parsed);
+	ok &= memcmp(parsed.riff, "RF64", 4) == 0 && parsed.container == WAV_CONTAINER_RF64;
+	ok &= ftell(file) == 80 && parsed.data_size == large && parsed.overall_size == 72 + large;
+
+	// Only what the file holds may be read
+	ok &= wav_sample_count(file, &parsed) == 1000;
+
+	fclose(file);
+
+	printf("%-10s %-28s %s\n", "header", "finished after streaming", ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/*
+		Writes an odd amount of 8-bit samples through a WavWriter and checks
+		that the data is followed by zero padding, which the overall size of
+		the header counts but the size of the data chunk does not.
+*/
+static void verify_header_padding(const char *name, WavContainer container, uint64_t announced)
+{
+	enum { SAMPLES = 1001 };
+	unsigned char samples[SAMPLES], padding[8];
+	WaveHeader written, parsed;
+
+	memset(samples, 0x80, sizeof(samples));
+	test_signal_header(&written, 8000, 0);
+	written.container = container;
+	wav_set_sample_format(&written, SAMPLE_U8);
+
+	// A RIFF size leaves out the first 8 bytes, a Wave64 size does not
+	long length = 44;
+	size_t pad = 1;
+	uint64_t overall_size = SAMPLES + pad + 36;
+	if (container == WAV_CONTAINER_W64)
+	{
+		length = 104;
+		pad = 7;
+		overall_size = SAMPLES + pad + 104;
+	}
+	else if (announced == WAV_UNKNOWN_SIZE)
+	{
+		length = 80;
+		overall_size = SAMPLES + pad + 72;
+	}
+
+	FILE *file = tmpfile();
+	WavWriter *writer = wav_writer_open(file, &written, announced);
+	int ok = writer != NULL && wav_writer_write(writer, samples, SAMPLES) == 0 && wav_writer_close(writer) == 0;
+	ok &= ftell(file) == length + SAMPLES + (long) pad;
+
+	fseek(file, length + SAMPLES, SEEK_SET);
+	ok &= fread(padding, 1, pad, file) == pad;
+	for (size_t i = 0; i < pad; i++)
+	{
+		ok &= padding[i] == 0;
+	}
+
+	rewind(file);
+	parse_wav(file, NULL, &parsed);
+	ok &= parsed.data_size == SAMPLES && parsed.overall_size == overall_size;
+	ok &= wav_sample_count(file, &parsed) == SAMPLES;
+	fclose(file);
+
+	printf("%-10s %-28s %s\n", "header", name, ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+/*
+		Appends a chunk with the given id and body to a header being built.
+		Returns the new length of the header.
+*/
+static size_t put_chunk(unsigned char *bytes, size_t length, const char *id, const unsigned char *body, size_t size)
+{
+	memcpy(bytes + length, id, 4);
+	for (int i = 0; i < 4; i++)
+	{
+		bytes[length + 4 + i] = (size >> (8 * i)) & 0xff;
+	}
+	memcpy(bytes + length + 8, body, size);
+	length += 8 + size;
+
+	// Odd chunks are padded
+	if (size & 1)
+	{
+		bytes[length++] = 0;
+	}
+	return length;
+}
+
+/*
+		Parses a header the way recording software writes them: metadata
+		chunks before and after an extensible fmt chunk of 24-bit stereo.
+		Checks the fields, that the file is left at the samples and that
+		every byte before them is copied.
+*/
+static void verify_header_chunks(void)
+{
+	static const unsigned char junk[28] = { 0 };
+	static const unsigned char fmt[40] = {
+		0xfe, 0xff, 2, 0, 0x80, 0xbb, 0, 0, 0x00, 0x65, 0x04, 0, 6, 0, 24, 0,	// Extensible, 2 channels, 48000 Hz, 24-bit
+		22, 0, 24, 0, 3, 0, 0, 0,																				// Extension size, valid bits, channel mask
+		1, 0, 0, 0, 0, 0, 0x10, 0, 0x80, 0, 0, 0xaa, 0, 0x38, 0x9b, 0x71			// PCM sub format GUID
+	};
+	static const unsigned char list[5] = { 'I', 'N', 'F', 'O', 0 };
+	static const unsigned char fact[4] = { 4, 0, 0, 0 };
+	unsigned char bytes[256], copied[256];
+	WaveHeader parsed;
+	SampleFormat format;
+	int ok = 1;
+
+	size_t length = 12;
+	length = put_chunk(bytes, length, "JUNK", junk, sizeof(junk));
+	length = put_chunk(bytes, length, "fmt ", fmt, sizeof(fmt));
+	length = put_chunk(bytes, length, "LIST", list, sizeof(list));
+	length = put_chunk(bytes, length, "fact", fact, sizeof(fact));
+	memcpy(bytes, "RIFF", 4);
+	memcpy(bytes + 8, "WAVE", 4);
+	unsigned char data[12] = { 0 };
+	size_t data_offset = put_chunk(bytes, length, "data", data, sizeof(data)) - sizeof(data);
+	size_t riff_size = data_offset + sizeof(data) - 8;
+	for (int i = 0; i < 4; i++)
+	{
+		bytes[4 + i] = (riff_size >> (8 * i)) & 0xff;
+	}
+
+	FILE *file = tmpfile();
+	FILE *copy = tmpfile();
+	fwrite(bytes, 1, data_offset + sizeof(data), file);
+	rewind(file);
+	parse_wav(file, copy, &parsed);
+
+	ok &= (size_t) ftell(file) == data_offset;
+	ok &= memcmp(parsed.data_chunk_header, "data", 4) == 0 && parsed.data_size == sizeof(data);
+	ok &= parsed.length_of_fmt == sizeof(fmt) && parsed.format_type == WAVE_FORMAT_PCM;
+	ok &= parsed.channels == 2 && parsed.sample_rate == 48000 && parsed.bits_per_sample == 24;
+	ok &= wav_sample_format(&parsed, &format) == 0 && format == SAMPLE_S24;
+	ok &= wav_sample_count(file, &parsed) == sizeof(data) / 3;
+
+	rewind(copy);
+	ok &= fread(copied, 1, data_offset, copy) == data_offset && memcmp(bytes, copied, data_offset) == 0;
+
+	fclose(file);
+	fclose(copy);
+
+	printf("%-10s %-28s %s\n", "header", "extensible with metadata", ok ? "ok" : "FAIL");
+	failures += !ok;
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = 3;
+	const char *isa = "auto";
+	int ch;
+
+	while ((ch = getopt(argc, argv, "l:I:")) != EOF)
+	{
+		switch (ch)
+		{
+			case 'l':
+				seconds = atof(optarg);
+				break;
+			case 'I':
+				// Run every engine on the kernels of one instruction set
+				isa = optarg;
+				if (kernel_use_isa(isa) != 0)
+				{
+					fprintf(stderr, "instruction set '%s' is unknown or not supported here\n", isa);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: cverb-verify [-l seconds] [-I isa] [input.wav ...]\n");
+				return 1;
+		}
+	}
+
+	printf("%-10s %-28s %8s %10s %6s %8s  %s\n", "engine", "input", "max_err", "snr_db", "exact", "clipped", "result");
+
+	verify_kernels(isa);
+	verify_fdn();
+	verify_library();
+	verify_streams();
+	verify_live();
+	verify_silence();
+	verify_tail();
+	verify_pipeline();
+	verify_pool();
+	verify_rings();
+	verify_header("mono 22050 Hz", 1, 22050, 1000, SAMPLE_S16, WAV_CONTAINER_RIFF);
+	verify_header("stereo 192000 Hz", 2, 192000, 0, SAMPLE_S16, WAV_CONTAINER_RIFF);
+	verify_header("streaming", 2, 44100, WAV_UNKNOWN_SIZE, SAMPLE_S16, WAV_CONTAINER_RIFF);
+	verify_header("float 48000 Hz", 2, 48000, 4000, SAMPLE_F32, WAV_CONTAINER_RIFF);
+	verify_header("24-bit 96000 Hz", 6, 96000, 1800, SAMPLE_S24, WAV_CONTAINER_RIFF);
+	verify_header("rf64 6 GB", 2, 48000, 6000000000ull, SAMPLE_S24, WAV_CONTAINER_RIFF);
+	verify_header("w64 mono 44100 Hz", 1, 44100, 2000, SAMPLE_S16, WAV_CONTAINER_W64);
+	verify_header("w64 streaming", 2, 48000, WAV_UNKNOWN_SIZE, SAMPLE_F32, WAV_CONTAINER_W64);
+	verify_header("u8 mono odd", 1, 8000, 999, SAMPLE_U8, WAV_CONTAINER_RIFF);
+	verify_header("w64 s24 mono odd", 1, 44100, 999, SAMPLE_S24, WAV_CONTAINER_W64);
+	verify_header_finish();
+	verify_header_padding("padded after odd data", WAV_CONTAINER_RIFF, 1001);
+	verify_header_padding("padded after odd stream", WAV_CONTAINER_RIFF, WAV_UNKNOWN_SIZE);
+	verify_header_padding("w64 padded to 8 bytes", WAV_CONTAINER_W64, 1001);
+	verify_header_chunks();
+
+	for (int s = 0; s < NUM_TEST_SIGNALS; s++)
+	{
+		for (int r = 0; r < NUM_TEST_RATES; r++)
+		{
+			char *path = test_temp_file();
+			char name[64];
+			TestSignal signal;
+
+			test_signal_init(&signal, s, test_rates[r], (size_t) (seconds * test_rates[r]), SIGNAL_AMPLITUDE);
+			test_signal_write(&signal, path);
+			snprintf(name, sizeof(name), "%s@%u", test_signal_names[s], test_rates[r]);
+			verify_input(path, name);
+
+			unlink(path);
+			free(path);
+		}
+	}
+
+	for (int i = optind; i < argc; i++)
+	{
+		verify_input(argv[i], argv[i]);
+	}
+
+	printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+	return failures == 0 ? 0 : 1;
+}
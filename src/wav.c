@@ -9,180 +9,539 @@
 
 /* Libraries */
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 
 /* Header files*/
 #include "wav.h"
 
+/* Writes size bytes of a header field to out_file, or nothing if
+   out_file is NULL. Returns the amount of fields written like fwrite. */
+static int copy_to_output(const void *field, size_t size, FILE *out_file)
+{
+	 if (out_file == NULL)
+	 {
+		 return 1;
+	 }
+	 return fwrite(field, size, 1, out_file);
+}
+
+#define RIFF_STREAM_SIZE 0xFFFFFFFF		// 32-bit size of streams, and of RF64 chunks whose size is in ds64
+#define RIFF_MAX_SIZE 0xFFFFFFFEull		// Largest 32-bit size which is not RIFF_STREAM_SIZE
+#define MAX_HEADER_SIZE 104						// Size of a Wave64 header, the longest one written
+
+/* Wave64 identifies chunks by GUIDs. Apart from the riff GUID
+   they are a four character code followed by these 12 bytes. */
+static const unsigned char w64_riff[16] = { 'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00 };
+static const unsigned char w64_suffix[12] = { 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+
+/* Layouts of the headers write_wav_header writes */
+typedef enum
+{
+	 LAYOUT_CANONICAL,		// 44 byte RIFF header
+	 LAYOUT_RESERVED,			// RIFF header with a JUNK chunk the size of a ds64 chunk
+	 LAYOUT_RF64,					// RF64 header, as long as LAYOUT_RESERVED
+	 LAYOUT_W64						// Wave64 header
+} HeaderLayout;
+
+/* Stores value as a little endian integer of the given amount of bytes */
+static void put_le(unsigned char *bytes, uint64_t value, int count)
+{
+	 for (int i = 0; i < count; i++)
+	 {
+		 bytes[i] = (value >> (8 * i)) & 0xff;
+	 }
+}
+
+/* Reads a little endian integer of the given amount of bytes */
+static uint64_t get_le(const unsigned char *bytes, int count)
+{
+	 uint64_t value = 0;
+
+	 for (int i = count - 1; i >= 0; i--)
+	 {
+		 value = (value << 8) | bytes[i];
+	 }
+	 return value;
+}
+
+/* Stores the Wave64 GUID of the chunk with the given four character code */
+static void put_guid(unsigned char *bytes, const char *id)
+{
+	 memcpy(bytes, id, 4);
+	 memcpy(bytes + 4, w64_suffix, sizeof(w64_suffix));
+}
+
+/* Reads size bytes of the header and copies them to out_file.
+   Returns 0 on success, -1 if the file ended first. */
+static int read_field(unsigned char *bytes, size_t size, FILE *in_file, FILE *out_file)
+{
+	 if (fread(bytes, size, 1, in_file) != 1)
+	 {
+		 return -1;
+	 }
+	 copy_to_output(bytes, size, out_file);
+	 return 0;
+}
+
+/* Reads past size bytes of a chunk that is not needed. It is read
+   rather than seeked over so that pipes can be parsed as well. */
+static int skip_field(unsigned long long size, FILE *in_file, FILE *out_file)
+{
+	 unsigned char bytes[4096];
+
+	 while (size > 0)
+	 {
+		 size_t count = size < sizeof(bytes) ? size : sizeof(bytes);
+
+		 if (read_field(bytes, count, in_file, out_file) != 0)
+		 {
+			 return -1;
+		 }
+		 size -= count;
+	 }
+	 return 0;
+}
+
+/* Reads the header of the next chunk. Wave64 chunks whose GUID is
+   not built from a four character code get an id of zeros. The size
+   is that of the chunk's body. Returns 0 on success, -1 if the file
+   ended first or the header is broken. */
+static int read_chunk(unsigned char id[4], uint64_t *size, WavContainer container, FILE *in_file, FILE *out_file)
+{
+	 unsigned char bytes[24];
+
+	 if (container != WAV_CONTAINER_W64)
+	 {
+		 if (read_field(bytes, 8, in_file, out_file) != 0)
+		 {
+			 return -1;
+		 }
+		 memcpy(id, bytes, 4);
+		 *size = get_le(bytes + 4, 4);
+		 return 0;
+	 }
+
+	 // Wave64 sizes count the 24 byte chunk header as well
+	 if (read_field(bytes, 24, in_file, out_file) != 0)
+	 {
+		 return -1;
+	 }
+	 memset(id, 0, 4);
+	 if (memcmp(bytes + 4, w64_suffix, sizeof(w64_suffix)) == 0)
+	 {
+		 memcpy(id, bytes, 4);
+	 }
+	 *size = get_le(bytes + 16, 8);
+	 if (*size == WAV_UNKNOWN_SIZE)
+	 {
+		 return 0;
+	 }
+	 if (*size < 24)
+	 {
+		 return -1;
+	 }
+	 *size -= 24;
+	 return 0;
+}
+
 /* Function which reads through a wav file header
 
 	 Reads wav file header and populates waveheader struct
 	 and writes the header to a new wave file which will
 	 contain the filtered signal.
 
+	 Walks the chunks of the file up to the data chunk, so
+	 LIST, fact, JUNK and any other chunks before the samples
+	 are skipped (and copied to out_file like the rest of the
+	 header). A WAVE_FORMAT_EXTENSIBLE format is reported as
+	 its sub format. If there is no data chunk the data chunk
+	 header is left zeroed.
+
 	 in_file: wav file to be filtered
-	 out_file: wav file to contain filtered data
+	 out_file: wav file to contain filtered data, or NULL to
+	           only read the header
 */
 void parse_wav (FILE *in_file, FILE *out_file, WaveHeader *header)
 {
-	 int read = 0;
-	 int write = 0;
-
-	 // read header parts
-	 unsigned char buffer4[4];
-	 unsigned char buffer2[2];
-
-	 read = fread(header->riff, sizeof(header->riff), 1, in_file);
-	 write = fwrite(header->riff, sizeof(header->riff), 1, out_file);
+	 unsigned char bytes[40];		// Large enough for an extensible fmt chunk
+	 unsigned char chunk[4];
+	 uint64_t size;
+	 uint64_t ds64_data_size = WAV_UNKNOWN_SIZE;
+
+	 memset(header, 0, sizeof(WaveHeader));
+
+	 if (read_field(bytes, 12, in_file, out_file) != 0)
+	 {
+		 return;
+	 }
+	 memcpy(header->riff, bytes, 4);
+	 header->overall_size = get_le(bytes + 4, 4);
+	 memcpy(header->wave, bytes + 8, 4);
+
+	 // Wave64 starts with the riff GUID, a 64-bit size and the wave GUID
+	 if (memcmp(bytes, w64_riff, 12) == 0)
+	 {
+		 if (read_field(bytes + 12, 28, in_file, out_file) != 0 || memcmp(bytes, w64_riff, 16) != 0 ||
+		     memcmp(bytes + 28, w64_suffix, sizeof(w64_suffix)) != 0)
+		 {
+			 return;
+		 }
+		 header->container = WAV_CONTAINER_W64;
+		 header->overall_size = get_le(bytes + 16, 8);
+		 memcpy(header->wave, bytes + 24, 4);
+	 }
+	 else if (memcmp(header->riff, "RF64", 4) == 0)
+	 {
+		 header->container = WAV_CONTAINER_RF64;
+	 }
+	 else if (header->overall_size == RIFF_STREAM_SIZE)
+	 {
+		 header->overall_size = WAV_UNKNOWN_SIZE;
+	 }
 
 	 #ifdef DEBUG
-	 printf("(1-4): %s \n", header->riff);
+	 printf("(1-4): %.4s \n", header->riff);
+	 printf("(5-8) Overall size: bytes:%llu, Kb:%llu \n", (unsigned long long) header->overall_size, (unsigned long long) header->overall_size/1024);
+	 printf("(9-12) Wave marker: %.4s\n", header->wave);
 	 #endif
 
-	 read = fread(buffer4, sizeof(buffer4), 1, in_file);
-	 write = fwrite(buffer4, sizeof(buffer4), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u %u %u\n", buffer4[0], buffer4[1], buffer4[2], buffer4[3]);
-	 #endif
+	 if (header->container == WAV_CONTAINER_W64 ? memcmp(header->wave, "wave", 4) != 0 :
+	     (memcmp(header->riff, "RIFF", 4) != 0 && memcmp(header->riff, "RF64", 4) != 0) || memcmp(header->wave, "WAVE", 4) != 0)
+	 {
+		 return;
+	 }
+
+	 while (read_chunk(chunk, &size, header->container, in_file, out_file) == 0)
+	 {
+		 #ifdef DEBUG
+		 printf("Chunk %.4s: %llu bytes\n", chunk, (unsigned long long) size);
+		 #endif
+
+		 // The samples follow right after this, so the file is left here
+		 if (memcmp(chunk, "data", 4) == 0)
+		 {
+			 memcpy(header->data_chunk_header, chunk, 4);
+			 header->data_size = size;
+
+			 // RF64 keeps the real size in the ds64 chunk, plain RIFF marks streams this way
+			 if (header->container != WAV_CONTAINER_W64 && size == RIFF_STREAM_SIZE)
+			 {
+				 header->data_size = header->container == WAV_CONTAINER_RF64 ? ds64_data_size : WAV_UNKNOWN_SIZE;
+			 }
+			 return;
+		 }
+
+		 if (memcmp(chunk, "ds64", 4) == 0 && header->container == WAV_CONTAINER_RF64 && size >= 16)
+		 {
+			 if (read_field(bytes, 16, in_file, out_file) != 0)
+			 {
+				 return;
+			 }
+			 size -= 16;
+			 header->overall_size = get_le(bytes, 8);
+			 ds64_data_size = get_le(bytes + 8, 8);
+		 }
+
+		 if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+		 {
+			 size_t length = size < sizeof(bytes) ? size : sizeof(bytes);
+
+			 if (read_field(bytes, length, in_file, out_file) != 0)
+			 {
+				 return;
+			 }
+			 size -= length;
+
+			 memcpy(header->fmt_chunk_marker, chunk, 4);
+			 header->length_of_fmt = length + size;
+			 header->format_type = get_le(bytes, 2);
+			 header->channels = get_le(bytes + 2, 2);
+			 header->sample_rate = get_le(bytes + 4, 4);
+			 header->byterate = get_le(bytes + 8, 4);
+			 header->block_align = get_le(bytes + 12, 2);
+			 header->bits_per_sample = get_le(bytes + 14, 2);
+
+			 // The first two bytes of the sub format GUID hold the actual format type
+			 if (header->format_type == WAVE_FORMAT_EXTENSIBLE && length >= 26)
+			 {
+				 header->format_type = get_le(bytes + 24, 2);
+			 }
+
+			 #ifdef DEBUG
+			 printf("Format type: %u, Channels: %u, Sample rate: %u\n", header->format_type, header->channels, header->sample_rate);
+			 printf("Byte Rate: %u, Block Alignment: %u, Bits per sample: %u\n", header->byterate, header->block_align, header->bits_per_sample);
+			 #endif
+		 }
+
+		 if (size == WAV_UNKNOWN_SIZE || skip_field(size + wav_padding(header, size), in_file, out_file) != 0)
+		 {
+			 return;
+		 }
+	 }
+}
 
-	 // convert little endian to big endian 4 byte int
-	 header->overall_size  = buffer4[0] |
-							(buffer4[1]<<8) |
-							(buffer4[2]<<16) |
-							(buffer4[3]<<24);
+/* Picks the layout of a header for data_size bytes of samples */
+static HeaderLayout header_layout(const WaveHeader *header, uint64_t data_size)
+{
+	 if (header->container == WAV_CONTAINER_W64)
+	 {
+		 return LAYOUT_W64;
+	 }
+	 if (data_size == WAV_UNKNOWN_SIZE)
+	 {
+		 return LAYOUT_RESERVED;
+	 }
+	 return data_size + wav_padding(header, data_size) + 36 <= RIFF_MAX_SIZE ? LAYOUT_CANONICAL : LAYOUT_RF64;
+}
 
-	 #ifdef DEBUG
-	 printf("(5-8) Overall size: bytes:%u, Kb:%u \n", header->overall_size, header->overall_size/1024);
-	 #endif
+/* Builds a header of the given layout in bytes, which must hold
+   MAX_HEADER_SIZE bytes. Returns the length of the header. */
+static size_t build_header(unsigned char *bytes, const WaveHeader *header, HeaderLayout layout, uint64_t data_size)
+{
+	 unsigned char fmt[16];
+	 unsigned int block_align = header->channels * (header->bits_per_sample / 8);
+	 uint64_t padding = data_size == WAV_UNKNOWN_SIZE ? 0 : wav_padding(header, data_size);
+	 size_t length;
+
+	 put_le(fmt, header->format_type == WAVE_FORMAT_IEEE_FLOAT ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM, 2);
+	 put_le(fmt + 2, header->channels, 2);
+	 put_le(fmt + 4, header->sample_rate, 4);
+	 put_le(fmt + 8, header->sample_rate * block_align, 4);
+	 put_le(fmt + 12, block_align, 2);
+	 put_le(fmt + 14, header->bits_per_sample, 2);
+
+	 // Every Wave64 size counts the 24 byte chunk header. The file size also counts the padding after the data
+	 if (layout == LAYOUT_W64)
+	 {
+		 int unknown = data_size == WAV_UNKNOWN_SIZE;
+
+		 memcpy(bytes, w64_riff, sizeof(w64_riff));
+		 put_le(bytes + 16, unknown ? WAV_UNKNOWN_SIZE : MAX_HEADER_SIZE + data_size + padding, 8);
+		 put_guid(bytes + 24, "wave");
+		 put_guid(bytes + 40, "fmt ");
+		 put_le(bytes + 56, 24 + sizeof(fmt), 8);
+		 memcpy(bytes + 64, fmt, sizeof(fmt));
+		 put_guid(bytes + 80, "data");
+		 put_le(bytes + 96, unknown ? WAV_UNKNOWN_SIZE : 24 + data_size, 8);
+		 return MAX_HEADER_SIZE;
+	 }
+
+	 memcpy(bytes, layout == LAYOUT_RF64 ? "RF64" : "RIFF", 4);
+	 memcpy(bytes + 8, "WAVE", 4);
+	 length = 12;
+
+	 // RF64 has a ds64 chunk with the 64-bit sizes, a JUNK chunk holds its place until the size is known
+	 if (layout == LAYOUT_RF64 || layout == LAYOUT_RESERVED)
+	 {
+		 memcpy(bytes + 12, layout == LAYOUT_RF64 ? "ds64" : "JUNK", 4);
+		 put_le(bytes + 16, 28, 4);
+		 memset(bytes + 20, 0, 28);
+		 if (layout == LAYOUT_RF64)
+		 {
+			 put_le(bytes + 20, 72 + data_size + padding, 8);
+			 put_le(bytes + 28, data_size, 8);
+			 put_le(bytes + 36, block_align > 0 ? data_size / block_align : 0, 8);
+		 }
+		 length = 48;
+	 }
+
+	 memcpy(bytes + length, "fmt ", 4);
+	 put_le(bytes + length + 4, sizeof(fmt), 4);
+	 memcpy(bytes + length + 8, fmt, sizeof(fmt));
+	 length += 8 + sizeof(fmt);
+
+	 memcpy(bytes + length, "data", 4);
+	 if (layout == LAYOUT_RF64 || data_size == WAV_UNKNOWN_SIZE)
+	 {
+		 put_le(bytes + 4, RIFF_STREAM_SIZE, 4);
+		 put_le(bytes + length + 4, RIFF_STREAM_SIZE, 4);
+	 }
+	 else
+	 {
+		 put_le(bytes + 4, length + data_size + padding, 4);
+		 put_le(bytes + length + 4, data_size, 4);
+	 }
+
+	 return length + 8;
+}
 
-	 read = fread(header->wave, sizeof(header->wave), 1, in_file);
-	 write = fwrite(header->wave, sizeof(header->wave), 1, out_file);
-	 #ifdef DEBUG
-	 printf("(9-12) Wave marker: %s\n", header->wave);
-	 #endif
+/* Function which writes a wav header
 
-	 read = fread(header->fmt_chunk_marker, sizeof(header->fmt_chunk_marker), 1, in_file);
-	 write = fwrite(header->fmt_chunk_marker, sizeof(header->fmt_chunk_marker), 1, out_file);
-	 #ifdef DEBUG
-	 printf("(13-16) Fmt marker: %s\n", header->fmt_chunk_marker);
-	 #endif
+	 Uses the format fields of header (format type, channels,
+	 sample rate and bits per sample). The size fields are taken from data_size
+	 instead of header, since the output does not have to be as
+	 long as the input.
 
-	 read = fread(buffer4, sizeof(buffer4), 1, in_file);
-	 write = fwrite(buffer4, sizeof(buffer4), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u %u %u\n", buffer4[0], buffer4[1], buffer4[2], buffer4[3]);
-	 #endif
-	 // convert little endian to big endian 4 byte integer
-	 header->length_of_fmt = buffer4[0] |
-								(buffer4[1] << 8) |
-								(buffer4[2] << 16) |
-								(buffer4[3] << 24);
-	 #ifdef DEBUG
-	 printf("(17-20) Length of Fmt header: %u \n", header->length_of_fmt);
-	 #endif
+	 A Wave64 header is written if header->container is
+	 WAV_CONTAINER_W64. Otherwise the canonical 44 byte header is
+	 written if the data fits in 4 GB, and an RF64 header if it
+	 does not. WAV_UNKNOWN_SIZE writes a RIFF header with sizes of
+	 0xFFFFFFFF, which is how streaming tools write wav to a pipe,
+	 followed by a JUNK chunk that leaves room to turn it into
+	 RF64 once wav_finish_header knows the size.
 
-	 read = fread(buffer2, sizeof(buffer2), 1, in_file);
-	 write = fwrite(buffer2, sizeof(buffer2), 1, out_file);
+	 out_file: wav file to write the header to
+	 header: header whose format should be written
+	 data_size: size of the sample data in bytes
 
-	 #ifdef DEBUG
-	 printf("%u %u \n", buffer2[0], buffer2[1]);
-	 #endif
+	 returns: 0 on success, -1 if writing failed
+*/
+int write_wav_header (FILE *out_file, WaveHeader *header, uint64_t data_size)
+{
+	 unsigned char bytes[MAX_HEADER_SIZE];
+	 size_t length = build_header(bytes, header, header_layout(header, data_size), data_size);
 
-	 header->format_type = buffer2[0] | (buffer2[1] << 8);
-	 #ifdef DEBUG
-	 char format_name[10] = "";
-	 if (header->format_type == 1)
-	   strcpy(format_name,"PCM");
-	 else if (header->format_type == 6)
-	  strcpy(format_name, "A-law");
-	 else if (header->format_type == 7)
-	  strcpy(format_name, "Mu-law");
-
-	 printf("(21-22) Format type: %u %s \n", header->format_type, format_name);
-	 #endif
+	 return fwrite(bytes, length, 1, out_file) == 1 ? 0 : -1;
+}
 
-	 read = fread(buffer2, sizeof(buffer2), 1, in_file);
-	 write = fwrite(buffer2, sizeof(buffer2), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u \n", buffer2[0], buffer2[1]);
-	 #endif
+/* Function which fills in the sizes of a header once all
+	 samples are written
 
-	 header->channels = buffer2[0] | (buffer2[1] << 8);
-	 #ifdef DEBUG
-	 printf("(23-24) Channels: %u \n", header->channels);
-	 #endif
+	 Rewrites the header at the start of out_file in the space
+	 the first write_wav_header call took, then returns to the end
+	 of the file. A header written for an unknown size becomes RF64
+	 if the data has grown past 4 GB. A 44 byte header can not grow,
+	 so data which no longer fits it is marked as a stream.
 
-	 read = fread(buffer4, sizeof(buffer4), 1, in_file);
-	 write = fwrite(buffer4, sizeof(buffer4), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u %u %u\n", buffer4[0], buffer4[1], buffer4[2], buffer4[3]);
-	 #endif
+	 out_file: seekable wav file the header was written to
+	 header: header passed to write_wav_header
+	 announced: data_size passed to write_wav_header
+	 data_size: size of the sample data actually written in bytes
 
-	 header->sample_rate = buffer4[0] |
-							(buffer4[1] << 8) |
-							(buffer4[2] << 16) |
-							(buffer4[3] << 24);
+	 returns: 0 on success, -1 if seeking or writing failed
+*/
+int wav_finish_header (FILE *out_file, WaveHeader *header, uint64_t announced, uint64_t data_size)
+{
+	 unsigned char bytes[MAX_HEADER_SIZE];
+	 HeaderLayout layout = header_layout(header, announced);
+
+	 // The reserved and RF64 layouts are as long as each other
+	 if (layout == LAYOUT_RESERVED || layout == LAYOUT_RF64)
+	 {
+		 layout = data_size + wav_padding(header, data_size) + 72 <= RIFF_MAX_SIZE ? LAYOUT_RESERVED : LAYOUT_RF64;
+	 }
+	 else if (layout == LAYOUT_CANONICAL && data_size + wav_padding(header, data_size) + 36 > RIFF_MAX_SIZE)
+	 {
+		 data_size = WAV_UNKNOWN_SIZE;
+	 }
+
+	 size_t length = build_header(bytes, header, layout, data_size);
+	 if (fseek(out_file, 0, SEEK_SET) != 0)
+	 {
+		 return -1;
+	 }
+	 int r = fwrite(bytes, length, 1, out_file) == 1 ? 0 : -1;
+	 if (fseek(out_file, 0, SEEK_END) != 0)
+	 {
+		 r = -1;
+	 }
+	 return r;
+}
 
-	 #ifdef DEBUG
-	 printf("(25-28) Sample rate: %u\n", header->sample_rate);
-	 #endif
+/* Function which finds the padding that follows a chunk
 
-	 read = fread(buffer4, sizeof(buffer4), 1, in_file);
-	 write = fwrite(buffer4, sizeof(buffer4), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u %u %u\n", buffer4[0], buffer4[1], buffer4[2], buffer4[3]);
-	 #endif
+	 RIFF and RF64 chunks are padded to an even length, Wave64
+	 chunks to a multiple of 8 bytes. The size of a chunk does
+	 not count its padding, the size of the file around it does.
 
-	 header->byterate  = buffer4[0] |
-							(buffer4[1] << 8) |
-							(buffer4[2] << 16) |
-							(buffer4[3] << 24);
-	 #ifdef DEBUG
-	 printf("(29-32) Byte Rate: %u , Bit Rate:%u\n", header->byterate, header->byterate*8);
-	 #endif
+	 header: header whose container sets the alignment
+	 size: size of the chunk body in bytes
 
-	 read = fread(buffer2, sizeof(buffer2), 1, in_file);
-	 write = fwrite(buffer2, sizeof(buffer2), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u \n", buffer2[0], buffer2[1]);
-	 #endif
+	 returns: amount of zero bytes that follow the chunk
+*/
+uint64_t wav_padding (const WaveHeader *header, uint64_t size)
+{
+	 return header->container == WAV_CONTAINER_W64 ? (8 - size % 8) % 8 : size & 1;
+}
 
-	 header->block_align = buffer2[0] |
-						(buffer2[1] << 8);
-	 #ifdef DEBUG
-	 printf("(33-34) Block Alignment: %u \n", header->block_align);
-	 #endif
+const char *const sample_format_names[NUM_SAMPLE_FORMATS] = { "u8", "s16", "s24", "s32", "f32" };
 
-	 read = fread(buffer2, sizeof(buffer2), 1, in_file);
-	 write = fwrite(buffer2, sizeof(buffer2), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u \n", buffer2[0], buffer2[1]);
-	 #endif
+/* Function which finds the sample encoding of a wav file
 
-	 header->bits_per_sample = buffer2[0] |
-						(buffer2[1] << 8);
-	 #ifdef DEBUG
-	 printf("(35-36) Bits per sample: %u \n", header->bits_per_sample);
-	 #endif
+	 header: header filled in by parse_wav
+	 format: set to the encoding of the samples
 
-	 read = fread(header->data_chunk_header, sizeof(header->data_chunk_header), 1, in_file);
-	 write = fwrite(header->data_chunk_header, sizeof(header->data_chunk_header), 1, out_file);
-	 #ifdef DEBUG
-	 printf("(37-40) Data Marker: %s \n", header->data_chunk_header);
-	 #endif
+	 returns: 0 on success, -1 if the samples are in an
+	          encoding C-Verb does not read
+*/
+int wav_sample_format (const WaveHeader *header, SampleFormat *format)
+{
+	 // Samples are stored in whole bytes, a 20-bit file sits in 24-bit containers
+	 unsigned int bytes = wav_sample_bytes(header);
+
+	 if (header->format_type == WAVE_FORMAT_IEEE_FLOAT && bytes == 4)
+	 {
+		 *format = SAMPLE_F32;
+		 return 0;
+	 }
+	 if (header->format_type != WAVE_FORMAT_PCM)
+	 {
+		 return -1;
+	 }
+
+	 switch (bytes)
+	 {
+		 case 1: *format = SAMPLE_U8; return 0;
+		 case 2: *format = SAMPLE_S16; return 0;
+		 case 3: *format = SAMPLE_S24; return 0;
+		 case 4: *format = SAMPLE_S32; return 0;
+		 default: return -1;
+	 }
+}
 
-	 read = fread(buffer4, sizeof(buffer4), 1, in_file);
-	 write = fwrite(buffer4, sizeof(buffer4), 1, out_file);
-	 #ifdef DEBUG
-	 printf("%u %u %u %u\n", buffer4[0], buffer4[1], buffer4[2], buffer4[3]);
-	 #endif
+/* Function which sets the format fields of a header
 
-	 header->data_size = buffer4[0] |
-					(buffer4[1] << 8) |
-					(buffer4[2] << 16) |
-					(buffer4[3] << 24 );
+	 Fills in format type, bits per sample, block align and
+	 byte rate for samples of the given encoding. Channels and
+	 sample rate must already be set.
 
-	 #ifdef DEBUG
-	 printf("(41-44) Size of data chunk: %u \n", header->data_size);
-	 #endif
+	 header: header to change
+	 format: encoding of the samples
+*/
+void wav_set_sample_format (WaveHeader *header, SampleFormat format)
+{
+	 header->format_type = format == SAMPLE_F32 ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+	 header->bits_per_sample = 8 * sample_format_bytes(format);
+	 header->block_align = header->channels * sample_format_bytes(format);
+	 header->byterate = header->sample_rate * header->block_align;
+}
+
+/* Function which looks up a sample encoding by its name
+
+	 name: one of sample_format_names (u8, s16, s24, s32, f32)
+	 format: set to the encoding
+
+	 returns: 0 on success, -1 if the name is unknown
+*/
+int sample_format_from_name (const char *name, SampleFormat *format)
+{
+	 for (int f = 0; f < NUM_SAMPLE_FORMATS; f++)
+	 {
+		 if (strcmp(name, sample_format_names[f]) == 0)
+		 {
+			 *format = f;
+			 return 0;
+		 }
+	 }
+	 return -1;
+}
+
+/* Returns the size of one sample of the given encoding in bytes */
+unsigned int sample_format_bytes (SampleFormat format)
+{
+	 static const unsigned int bytes[NUM_SAMPLE_FORMATS] = { 1, 2, 3, 4, 4 };
+
+	 return bytes[format];
+}
+
+/* Returns the size of one sample of a wav file in bytes
+
+	 header: header filled in by parse_wav
+*/
+unsigned int wav_sample_bytes (const WaveHeader *header)
+{
+	 unsigned int bytes = (header->bits_per_sample + 7) / 8;
+
+	 return bytes > 0 ? bytes : 1;
 }
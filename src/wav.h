@@ -4,22 +4,50 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#define WAV_UNKNOWN_SIZE UINT64_MAX // data_size of streams of unknown length
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+/* Encodings of the samples in a data chunk */
+typedef enum
+{
+	SAMPLE_U8,			// 8-bit unsigned PCM
+	SAMPLE_S16,			// 16-bit signed PCM
+	SAMPLE_S24,			// 24-bit signed PCM, packed in 3 bytes
+	SAMPLE_S32,			// 32-bit signed PCM
+	SAMPLE_F32,			// 32-bit IEEE float
+	NUM_SAMPLE_FORMATS
+} SampleFormat;
+
+extern const char *const sample_format_names[NUM_SAMPLE_FORMATS];
+
+/* Containers the samples of a wav file can come in */
+typedef enum
+{
+	WAV_CONTAINER_RIFF,			// Plain RIFF, sizes are 32 bits so it ends at 4 GB
+	WAV_CONTAINER_RF64,			// EBU RF64, RIFF whose 64-bit sizes live in a ds64 chunk
+	WAV_CONTAINER_W64				// Sony Wave64, GUID chunk ids and 64-bit sizes
+} WavContainer;
+
 /* Struct which stores the data read from the header of a .wav file */
 typedef struct
 {
-	unsigned char riff[4];									// RIFF string
-	unsigned int overall_size;							// overall size of file in bytes
+	unsigned char riff[4];									// RIFF string (RF64, or riff for Wave64)
+	uint64_t overall_size;									// overall size of file in bytes
 	unsigned char wave[4];									// WAVE string
 	unsigned char fmt_chunk_marker[4];			// fmt string with trailing null char
 	unsigned int length_of_fmt;							// length of the format data
-	unsigned int format_type;								// format type. 1-PCM, 3- IEEE float, 6 - 8bit A law, 7 - 8bit mu law
+	unsigned int format_type;								// format type. 1-PCM, 3- IEEE float, 6 - 8bit A law, 7 - 8bit mu law (the sub format of WAVE_FORMAT_EXTENSIBLE)
 	unsigned int channels;									// no.of channels
 	unsigned int sample_rate;								// sampling rate (blocks per second)
 	unsigned int byterate;									// SampleRate * NumChannels * BitsPerSample/8
 	unsigned int block_align;								// NumChannels * BitsPerSample/8
 	unsigned int bits_per_sample;						// bits per sample, 8- 8bits, 16- 16 bits etc
 	unsigned char data_chunk_header[4];		  // DATA string or FLLR string
-	unsigned int data_size;									// NumSamples * NumChannels * BitsPerSample/8 - size of the next chunk that will be read
+	uint64_t data_size;											// NumSamples * NumChannels * BitsPerSample/8 - size of the next chunk that will be read
+	WavContainer container;									// Container the file came in
 } WaveHeader;
 
 /* Function which reads through a wav file header
@@ -28,8 +56,114 @@ typedef struct
 	 and writes the header to a new wave file which will
 	 contain the filtered signal.
 
+	 Walks the chunks of the file up to the data chunk, so
+	 LIST, fact, JUNK and any other chunks before the samples
+	 are skipped (and copied to out_file like the rest of the
+	 header). A WAVE_FORMAT_EXTENSIBLE format is reported as
+	 its sub format. If there is no data chunk the data chunk
+	 header is left zeroed.
+
+	 RF64 and Wave64 files are read as well, their 64-bit sizes
+	 end up in overall_size and data_size. A size of 0xFFFFFFFF
+	 in a plain RIFF file (which streaming tools write) becomes
+	 WAV_UNKNOWN_SIZE.
+
 	 in_file: wav file to be filtered
-	 out_file: wav file to contain filtered data
+	 out_file: wav file to contain filtered data, or NULL to
+	           only read the header
 */
 void parse_wav (FILE *in_file, FILE *out_file, WaveHeader *header);
+
+/* Function which writes a wav header
+
+	 Uses the format fields of header (format type, channels,
+	 sample rate and bits per sample). The size fields are taken from data_size
+	 instead of header, since the output does not have to be as
+	 long as the input.
+
+	 A Wave64 header is written if header->container is
+	 WAV_CONTAINER_W64. Otherwise the canonical 44 byte header is
+	 written if the data fits in 4 GB, and an RF64 header if it
+	 does not. WAV_UNKNOWN_SIZE writes a RIFF header with sizes of
+	 0xFFFFFFFF, which is how streaming tools write wav to a pipe,
+	 followed by a JUNK chunk that leaves room to turn it into
+	 RF64 once wav_finish_header knows the size.
+
+	 out_file: wav file to write the header to
+	 header: header whose format should be written
+	 data_size: size of the sample data in bytes
+
+	 returns: 0 on success, -1 if writing failed
+*/
+int write_wav_header (FILE *out_file, WaveHeader *header, uint64_t data_size);
+
+/* Function which fills in the sizes of a header once all
+	 samples are written
+
+	 Rewrites the header at the start of out_file in the space
+	 the first write_wav_header call took, then returns to the end
+	 of the file. A header written for an unknown size becomes RF64
+	 if the data has grown past 4 GB. A 44 byte header can not grow,
+	 so data which no longer fits it is marked as a stream.
+
+	 out_file: seekable wav file the header was written to
+	 header: header passed to write_wav_header
+	 announced: data_size passed to write_wav_header
+	 data_size: size of the sample data actually written in bytes
+
+	 returns: 0 on success, -1 if seeking or writing failed
+*/
+int wav_finish_header (FILE *out_file, WaveHeader *header, uint64_t announced, uint64_t data_size);
+
+/* Function which finds the padding that follows a chunk
+
+	 RIFF and RF64 chunks are padded to an even length, Wave64
+	 chunks to a multiple of 8 bytes. The size of a chunk does
+	 not count its padding, the size of the file around it does.
+
+	 header: header whose container sets the alignment
+	 size: size of the chunk body in bytes
+
+	 returns: amount of zero bytes that follow the chunk
+*/
+uint64_t wav_padding (const WaveHeader *header, uint64_t size);
+
+/* Function which finds the sample encoding of a wav file
+
+	 header: header filled in by parse_wav
+	 format: set to the encoding of the samples
+
+	 returns: 0 on success, -1 if the samples are in an
+	          encoding C-Verb does not read
+*/
+int wav_sample_format (const WaveHeader *header, SampleFormat *format);
+
+/* Function which sets the format fields of a header
+
+	 Fills in format type, bits per sample, block align and
+	 byte rate for samples of the given encoding. Channels and
+	 sample rate must already be set.
+
+	 header: header to change
+	 format: encoding of the samples
+*/
+void wav_set_sample_format (WaveHeader *header, SampleFormat format);
+
+/* Function which looks up a sample encoding by its name
+
+	 name: one of sample_format_names (u8, s16, s24, s32, f32)
+	 format: set to the encoding
+
+	 returns: 0 on success, -1 if the name is unknown
+*/
+int sample_format_from_name (const char *name, SampleFormat *format);
+
+/* Returns the size of one sample of the given encoding in bytes */
+unsigned int sample_format_bytes (SampleFormat format);
+
+/* Returns the size of one sample of a wav file in bytes
+
+	 header: header filled in by parse_wav
+*/
+unsigned int wav_sample_bytes (const WaveHeader *header);
 #endif
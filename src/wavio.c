@@ -0,0 +1,329 @@
+/*
+	Authors: Mark Goldwater, Nathaniel Tan
+
+	Bulk reading and writing of .wav sample data. The input data chunk
+	is memory mapped when possible so that samples never have to be
+	copied out of the page cache, and output is collected in a large
+	buffer so that the file is written in a few big chunks instead of
+	one call per sample.
+*/
+
+/* Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Header files */
+#include "wavio.h"
+
+/*
+		Returns the amount of bytes between the current position of file and
+		its end, or -1 if the file is not a regular file.
+*/
+static long long bytes_left(FILE *file)
+{
+	struct stat info;
+
+	if (fstat(fileno(file), &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		return -1;
+	}
+
+	long position = ftell(file);
+	if (position < 0 || position > info.st_size)
+	{
+		return -1;
+	}
+
+	return info.st_size - position;
+}
+
+/*
+		Returns the amount of samples in the data chunk of in_file which are
+		actually present in the file. parse_wav() must have been called on in_file.
+		For a stream of unknown length this is SIZE_MAX.
+
+		in_file: File object for the input .wav file.
+		header: Header filled in by parse_wav().
+*/
+size_t wav_sample_count(FILE *in_file, WaveHeader *header)
+{
+	uint64_t size = header->data_size;
+	long long left = bytes_left(in_file);
+
+	// Streams of unknown length are read until they end
+	if (left < 0 && (size == 0 || size == WAV_UNKNOWN_SIZE))
+	{
+		return SIZE_MAX;
+	}
+
+	// The header may claim more data than the file holds
+	if (left >= 0 && (uint64_t) left < size)
+	{
+		size = (uint64_t) left;
+	}
+
+	size /= wav_sample_bytes(header);
+	return size < SIZE_MAX ? (size_t) size : SIZE_MAX - 1;
+}
+
+/*
+		Creates a reader for the sample data of in_file. parse_wav() must have
+		been called on in_file so that it is positioned at the data chunk.
+
+		in_file: File object for the input .wav file.
+		header: Header filled in by parse_wav().
+
+		returns: Pointer to the new WavReader.
+*/
+WavReader *wav_reader_open(FILE *in_file, WaveHeader *header)
+{
+	WavReader *reader = malloc(sizeof(WavReader));
+	reader->file = in_file;
+	reader->map = NULL;
+	reader->map_length = 0;
+	reader->data = NULL;
+	reader->buffer = NULL;
+	reader->sample_bytes = wav_sample_bytes(header);
+	reader->channels = header->channels > 0 ? header->channels : 1;
+	reader->remaining = wav_sample_count(in_file, header);
+	if (reader->remaining != SIZE_MAX)
+	{
+		reader->remaining *= reader->sample_bytes;
+	}
+
+	long long left = bytes_left(in_file);
+	if (left > 0)
+	{
+		// mmap offsets have to be page aligned, so map from the start of the file
+		size_t offset = (size_t) ftell(in_file);
+		size_t length = offset + (size_t) left;
+		void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(in_file), 0);
+
+		if (map != MAP_FAILED)
+		{
+			madvise(map, length, MADV_SEQUENTIAL);
+			reader->map = map;
+			reader->map_length = length;
+			reader->data = reader->map + offset;
+			return reader;
+		}
+	}
+
+	// Fall back to large buffered reads
+	reader->buffer = malloc(WAVIO_BUFFER_BYTES);
+	return reader;
+}
+
+/*
+		Hands out the next run of samples, encoded as they are in the file.
+		The returned pointer stays valid until the next call on the reader.
+		It is not necessarily aligned to the size of a sample. Runs hold
+		whole frames unless the data itself ends in a partial frame.
+
+		reader: Reader created by wav_reader_open.
+		samples: Set to the first sample of the run.
+		max_samples: Largest amount of samples the caller wants.
+
+		returns: Amount of samples in the run, 0 at the end of the data.
+*/
+size_t wav_reader_read(WavReader *reader, const void **samples, size_t max_samples)
+{
+	size_t count = reader->remaining / reader->sample_bytes;
+	if (count > max_samples)
+	{
+		count = max_samples;
+	}
+
+	if (reader->map != NULL)
+	{
+		*samples = reader->data;
+		reader->data += count * reader->sample_bytes;
+	}
+	else
+	{
+		// Whole frames, or the caller would drop a partial frame in the middle of the stream
+		size_t most = WAVIO_BUFFER_BYTES / (reader->sample_bytes * reader->channels) * reader->channels;
+		if (count > most)
+		{
+			count = most;
+		}
+		count = fread(reader->buffer, reader->sample_bytes, count, reader->file);
+		*samples = reader->buffer;
+
+		// A short read means the stream ended before the header said it would
+		if (count == 0)
+		{
+			reader->remaining = 0;
+		}
+	}
+
+	reader->remaining -= count * reader->sample_bytes;
+	return count;
+}
+
+/*
+		Unmaps the file and frees the reader. Does not close the file.
+
+		reader: Reader created by wav_reader_open.
+*/
+void wav_reader_close(WavReader *reader)
+{
+	if (reader->map != NULL)
+	{
+		munmap(reader->map, reader->map_length);
+	}
+	free(reader->buffer);
+	free(reader);
+}
+
+/*
+		Writes a header to out_file and creates a writer which appends
+		samples after it.
+
+		out_file: File object for the output .wav file.
+		header: Format of the output, which gives the sample size.
+		data_size: Expected size of the sample data in bytes, or
+		           WAV_UNKNOWN_SIZE if it is not known.
+
+		returns: Pointer to the new WavWriter, or NULL if writing the header failed.
+*/
+WavWriter *wav_writer_open(FILE *out_file, const WaveHeader *header, uint64_t data_size)
+{
+	struct stat info;
+	WavWriter *writer = malloc(sizeof(WavWriter));
+	writer->file = out_file;
+	writer->header = *header;
+	writer->announced = data_size;
+	writer->written = 0;
+	writer->seekable = fstat(fileno(out_file), &info) == 0 && S_ISREG(info.st_mode);
+
+	if (write_wav_header(out_file, &writer->header, data_size) != 0)
+	{
+		free(writer);
+		return NULL;
+	}
+
+	writer->buffer = malloc(WAVIO_BUFFER_BYTES);
+	writer->used = 0;
+	writer->sample_bytes = wav_sample_bytes(header);
+
+	return writer;
+}
+
+/*
+		Writes the queued samples to the file.
+*/
+static int flush_writer(WavWriter *writer)
+{
+	int r = 0;
+
+	if (writer->used > 0)
+	{
+		size_t count = fwrite(writer->buffer, 1, writer->used, writer->file);
+
+		writer->written += count;
+		if (count != writer->used)
+		{
+			r = -1;
+		}
+	}
+	writer->used = 0;
+
+	return r;
+}
+
+/*
+		Queues samples for writing. They reach the file once the writer's
+		buffer fills up or the writer is closed.
+
+		writer: Writer created by wav_writer_open.
+		samples: Samples to write, encoded as they are stored in the file.
+		count: Amount of samples.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_write(WavWriter *writer, const void *samples, size_t count)
+{
+	const unsigned char *bytes = samples;
+	size_t size = count * writer->sample_bytes;
+	int r = 0;
+
+	while (size > 0)
+	{
+		size_t room = WAVIO_BUFFER_BYTES - writer->used;
+		size_t chunk = size < room ? size : room;
+
+		memcpy(writer->buffer + writer->used, bytes, chunk);
+		writer->used += chunk;
+		bytes += chunk;
+		size -= chunk;
+
+		if (writer->used == WAVIO_BUFFER_BYTES && flush_writer(writer) != 0)
+		{
+			r = -1;
+		}
+	}
+
+	return r;
+}
+
+/*
+		Writes out any queued samples right away. Used by streams, where
+		holding on to output would add latency.
+
+		writer: Writer created by wav_writer_open.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_flush(WavWriter *writer)
+{
+	int r = flush_writer(writer);
+
+	if (fflush(writer->file) != 0)
+	{
+		r = -1;
+	}
+
+	return r;
+}
+
+/*
+		Writes out any queued samples and the padding after them, fills in
+		the sizes of the header if they changed and frees the writer. Does
+		not close the file.
+
+		writer: Writer created by wav_writer_open.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_close(WavWriter *writer)
+{
+	static const unsigned char zeros[8] = { 0 };
+	int r = flush_writer(writer);
+
+	// A stream is read up to its end, so only data whose size the header states is padded
+	uint64_t padding = 0;
+	if (writer->seekable || writer->written == writer->announced)
+	{
+		padding = wav_padding(&writer->header, writer->written);
+	}
+	if ((padding > 0 && fwrite(zeros, padding, 1, writer->file) != 1) || fflush(writer->file) != 0)
+	{
+		r = -1;
+	}
+
+	// Only regular files can go back to the header
+	if (writer->seekable && writer->written != writer->announced &&
+	    (wav_finish_header(writer->file, &writer->header, writer->announced, writer->written) != 0 || fflush(writer->file) != 0))
+	{
+		r = -1;
+	}
+
+	free(writer->buffer);
+	free(writer);
+
+	return r;
+}
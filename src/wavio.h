@@ -0,0 +1,137 @@
+#ifndef WAVIO
+#define WAVIO
+/* Libraries */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Header files */
+#include "wav.h"
+
+#define WAVIO_BUFFER_BYTES (1 << 20) // Size of the staging buffers used when a file can not be mapped
+
+/* Struct which reads the sample data of a .wav file.
+
+	 Regular files are memory mapped and samples are handed out straight
+	 from the mapping. Anything that can not be mapped (pipes, sockets)
+	 is read through stdio in WAVIO_BUFFER_BYTES sized chunks.
+*/
+typedef struct
+{
+	FILE *file;
+	unsigned char *map;				// Start of the mapping, NULL when reading through stdio
+	size_t map_length;				// Amount of bytes mapped
+	const unsigned char *data;	// Start of the sample data inside the mapping
+	unsigned char *buffer;		// Staging buffer when reading through stdio
+	size_t remaining;					// Bytes of sample data not handed out yet
+	size_t sample_bytes;			// Size of one sample
+	size_t channels;					// Samples per frame, reads through stdio end on whole frames
+} WavReader;
+
+/* Struct which collects output samples and writes them in large chunks.
+
+	 The writer starts the file with a header for the size the caller
+	 expects. If the output is a regular file and a different amount of
+	 samples was written (or the size was not known up front), the header
+	 is rewritten with the actual size when the writer is closed.
+*/
+typedef struct
+{
+	FILE *file;
+	unsigned char *buffer;
+	size_t used;							// Bytes waiting in the buffer
+	size_t sample_bytes;			// Size of one sample
+	WaveHeader header;				// Header the file was started with
+	uint64_t announced;				// Data size written to the header
+	uint64_t written;					// Bytes of sample data written to the file
+	int seekable;							// Whether the header can be rewritten
+} WavWriter;
+
+/*
+		Returns the amount of samples in the data chunk of in_file which are
+		actually present in the file. parse_wav() must have been called on in_file.
+		For a stream of unknown length this is SIZE_MAX.
+
+		in_file: File object for the input .wav file.
+		header: Header filled in by parse_wav().
+*/
+size_t wav_sample_count(FILE *in_file, WaveHeader *header);
+
+/*
+		Creates a reader for the sample data of in_file. parse_wav() must have
+		been called on in_file so that it is positioned at the data chunk.
+
+		in_file: File object for the input .wav file.
+		header: Header filled in by parse_wav().
+
+		returns: Pointer to the new WavReader.
+*/
+WavReader *wav_reader_open(FILE *in_file, WaveHeader *header);
+
+/*
+		Hands out the next run of samples, encoded as they are in the file.
+		The returned pointer stays valid until the next call on the reader.
+		It is not necessarily aligned to the size of a sample. Runs hold
+		whole frames unless the data itself ends in a partial frame.
+
+		reader: Reader created by wav_reader_open.
+		samples: Set to the first sample of the run.
+		max_samples: Largest amount of samples the caller wants.
+
+		returns: Amount of samples in the run, 0 at the end of the data.
+*/
+size_t wav_reader_read(WavReader *reader, const void **samples, size_t max_samples);
+
+/*
+		Unmaps the file and frees the reader. Does not close the file.
+
+		reader: Reader created by wav_reader_open.
+*/
+void wav_reader_close(WavReader *reader);
+
+/*
+		Writes a header to out_file and creates a writer which appends
+		samples after it.
+
+		out_file: File object for the output .wav file.
+		header: Format of the output, which gives the sample size.
+		data_size: Expected size of the sample data in bytes, or
+		           WAV_UNKNOWN_SIZE if it is not known.
+
+		returns: Pointer to the new WavWriter, or NULL if writing the header failed.
+*/
+WavWriter *wav_writer_open(FILE *out_file, const WaveHeader *header, uint64_t data_size);
+
+/*
+		Queues samples for writing. They reach the file once the writer's
+		buffer fills up or the writer is closed.
+
+		writer: Writer created by wav_writer_open.
+		samples: Samples to write, encoded as they are stored in the file.
+		count: Amount of samples.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_write(WavWriter *writer, const void *samples, size_t count);
+
+/*
+		Writes out any queued samples right away. Used by streams, where
+		holding on to output would add latency.
+
+		writer: Writer created by wav_writer_open.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_flush(WavWriter *writer);
+
+/*
+		Writes out any queued samples and the padding after them, fills in
+		the sizes of the header if they changed and frees the writer. Does
+		not close the file.
+
+		writer: Writer created by wav_writer_open.
+
+		returns: 0 on success, -1 if writing to the file failed.
+*/
+int wav_writer_close(WavWriter *writer);
+#endif